@@ -71,6 +71,8 @@ HEADERS += src/activemasternode.h \
            src/bip38.h \
            src/bip39.h \
            src/bip39_english.h \
+           src/blockencodings.h \
+           src/blockfilemap.h \
            src/blocksignature.h \
            src/bloom.h \
            src/chain.h \
@@ -85,6 +87,7 @@ HEADERS += src/activemasternode.h \
            src/compat.h \
            src/compressor.h \
            src/core_io.h \
+           src/core_memusage.h \
            src/cuckoocache.h \
            src/crypter.h \
            src/eccryptoverify.h \
@@ -123,6 +126,7 @@ HEADERS += src/activemasternode.h \
            src/reverselock.h \
            src/reverse_iterate.h \
            src/scheduler.h \
+           src/sendcache.h \
            src/serialize.h \
            src/stakeinput.h \
            src/streams.h \
@@ -134,6 +138,11 @@ HEADERS += src/activemasternode.h \
            src/torcontrol.h \
            src/txdb.h \
            src/txmempool.h \
+           src/txvalidationqueue.h \
+           src/peerqueue.h \
+           src/msgverifyqueue.h \
+           src/seencache.h \
+           src/cachejournal.h \
            src/uint256.h \
            src/uint512.h \
            src/blob_uint256.h \
@@ -402,6 +411,8 @@ SOURCES += src/activemasternode.cpp \
            src/base58.cpp \
            src/bip38.cpp \
            src/bip39.cpp \
+           src/blockencodings.cpp \
+           src/blockfilemap.cpp \
            src/blocksignature.cpp \
            src/bloom.cpp \
            src/chain.cpp \
@@ -456,6 +467,10 @@ SOURCES += src/activemasternode.cpp \
            src/torcontrol.cpp \
            src/txdb.cpp \
            src/txmempool.cpp \
+           src/sendcache.cpp \
+           src/txvalidationqueue.cpp \
+           src/msgverifyqueue.cpp \
+           src/cachejournal.cpp \
            src/uint256.cpp \
            src/util.cpp \
            src/utilmoneystr.cpp \
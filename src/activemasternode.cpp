@@ -138,13 +138,21 @@ bool CActiveMasternode::SendMasternodePing(std::string& errorMessage)
             return false;
         }
 
-        pmn->lastPing = mnp;
-        mnodeman.mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
-
-        //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
-        CMasternodeBroadcast mnb(*pmn);
-        uint256 hash = mnb.GetHash();
-        if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = mnp;
+        {
+            LOCK(mnodeman.cs);
+            pmn->lastPing = mnp;
+            mnodeman.journal.Append(CMasternodeMan::JOURNAL_PING, mnp);
+
+            //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
+            CMasternodeBroadcast mnb(*pmn);
+            uint256 hash = mnb.GetHash();
+            LOCK(mnodeman.cs_seen);
+            mnodeman.mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+            if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
+                mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = mnp;
+                mnodeman.mapSeenMasternodeBroadcast.Touch(hash);
+            }
+        }
 
         mnp.Relay();
 
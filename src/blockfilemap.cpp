@@ -0,0 +1,118 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "clientversion.h"
+#include "main.h"
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockFileMap blockFileMap;
+
+CBlockFileRegion::~CBlockFileRegion()
+{
+#ifndef WIN32
+    if (pdata)
+        munmap(const_cast<char*>(pdata), nLength);
+#endif
+}
+
+CBlockFileMap::CBlockFileMap(unsigned int nWindowSizeIn, unsigned int nMaxWindowsIn) : nWindowSize(nWindowSizeIn), nMaxWindows(nMaxWindowsIn)
+{
+}
+
+std::shared_ptr<const CBlockFileRegion> CBlockFileMap::GetWindow(int nFile, unsigned int nWindowStart, size_t nMinLength)
+{
+    AssertLockHeld(cs);
+    const WindowKey key = std::make_pair(nFile, nWindowStart);
+    std::map<WindowKey, WindowList::iterator>::iterator it = mapWindows.find(key);
+    if (it != mapWindows.end()) {
+        // The last block file keeps growing, so a window mapped earlier may be too short
+        if (it->second->second->nLength >= nMinLength) {
+            lruWindows.splice(lruWindows.begin(), lruWindows, it->second);
+            return lruWindows.front().second;
+        }
+        lruWindows.erase(it->second);
+        mapWindows.erase(it);
+    }
+
+#ifdef WIN32
+    return nullptr;
+#else
+    fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= (off_t)nWindowStart) {
+        close(fd);
+        return nullptr;
+    }
+    size_t nLength = std::min<uint64_t>(nWindowSize, st.st_size - nWindowStart);
+    if (nLength < nMinLength) {
+        close(fd);
+        return nullptr;
+    }
+    void* pmap = mmap(NULL, nLength, PROT_READ, MAP_SHARED, fd, nWindowStart);
+    close(fd);
+    if (pmap == MAP_FAILED) {
+        LogPrintf("%s: mmap of %s at %u failed\n", __func__, path.string(), nWindowStart);
+        return nullptr;
+    }
+
+    std::shared_ptr<const CBlockFileRegion> region = std::make_shared<const CBlockFileRegion>((const char*)pmap, nLength);
+    lruWindows.emplace_front(key, region);
+    mapWindows[key] = lruWindows.begin();
+    while (lruWindows.size() > nMaxWindows) {
+        // Readers still holding the region keep it mapped until they are done
+        mapWindows.erase(lruWindows.back().first);
+        lruWindows.pop_back();
+    }
+    return region;
+#endif
+}
+
+bool CBlockFileMap::MapBlock(const CDiskBlockPos& pos, CBlockFileSpan& span)
+{
+    // Every block is preceded by the network magic and its serialized size
+    if (pos.IsNull() || pos.nPos < 8)
+        return false;
+
+    LOCK(cs);
+    const unsigned int nSizePos = pos.nPos - 4;
+    const unsigned int nWindowStart = nSizePos - nSizePos % nWindowSize;
+    std::shared_ptr<const CBlockFileRegion> region = GetWindow(pos.nFile, nWindowStart, pos.nPos - nWindowStart);
+    if (!region)
+        return false;
+
+    unsigned int nSize = 0;
+    CSpanReader(region->pdata + nSizePos - nWindowStart, 4, SER_DISK, CLIENT_VERSION) >> nSize;
+    const uint64_t nEnd = (uint64_t)pos.nPos + nSize - nWindowStart;
+    if (nSize == 0 || nEnd > nWindowSize)
+        return false;
+    if (nEnd > region->nLength) {
+        region = GetWindow(pos.nFile, nWindowStart, nEnd);
+        if (!region)
+            return false;
+    }
+
+    span.region = region;
+    span.pdata = region->pdata + pos.nPos - nWindowStart;
+    span.nSize = nSize;
+    return true;
+}
+
+void CBlockFileMap::Clear()
+{
+    LOCK(cs);
+    mapWindows.clear();
+    lruWindows.clear();
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRCY_BLOCKFILEMAP_H
+#define PRCY_BLOCKFILEMAP_H
+
+#include "chain.h"
+#include "streams.h"
+#include "sync.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+
+//! Size of one mapping window over a blk?????.dat file
+static const unsigned int BLOCKFILE_MAP_WINDOW_SIZE = 0x1000000; // 16 MiB
+//! Maximum number of windows kept mapped at the same time
+static const unsigned int MAX_BLOCKFILE_MAP_WINDOWS = sizeof(void*) > 4 ? 64 : 8;
+
+/** One read-only mapped window of a block file. Unmapped when the last reference goes away. */
+class CBlockFileRegion
+{
+public:
+    const char* pdata;
+    size_t nLength;
+
+    CBlockFileRegion(const char* pdataIn, size_t nLengthIn) : pdata(pdataIn), nLength(nLengthIn) {}
+    ~CBlockFileRegion();
+
+private:
+    CBlockFileRegion(const CBlockFileRegion&);
+    CBlockFileRegion& operator=(const CBlockFileRegion&);
+};
+
+/** A serialized block inside a mapped window, kept alive for as long as the span exists */
+class CBlockFileSpan
+{
+public:
+    std::shared_ptr<const CBlockFileRegion> region;
+    const char* pdata;
+    unsigned int nSize;
+
+    CBlockFileSpan() : pdata(NULL), nSize(0) {}
+
+    CSpanReader GetReader(int nType, int nVersion) const
+    {
+        return CSpanReader(pdata, nSize, nType, nVersion);
+    }
+};
+
+/**
+ * Read-only memory mapping of the block files, used to serve block and
+ * transaction reads without a file open, seek and copy per call.
+ *
+ * Files are mapped in fixed, aligned windows which are evicted least recently
+ * used first. Blocks that straddle two windows are not served from the map;
+ * callers fall back to regular file I/O for them.
+ */
+class CBlockFileMap
+{
+private:
+    typedef std::pair<int, unsigned int> WindowKey;
+    typedef std::list<std::pair<WindowKey, std::shared_ptr<const CBlockFileRegion> > > WindowList;
+
+    Mutex cs;
+    const unsigned int nWindowSize;
+    const unsigned int nMaxWindows;
+    //! Most recently used window first
+    WindowList lruWindows;
+    std::map<WindowKey, WindowList::iterator> mapWindows;
+
+    std::shared_ptr<const CBlockFileRegion> GetWindow(int nFile, unsigned int nWindowStart, size_t nMinLength);
+
+public:
+    CBlockFileMap(unsigned int nWindowSizeIn = BLOCKFILE_MAP_WINDOW_SIZE, unsigned int nMaxWindowsIn = MAX_BLOCKFILE_MAP_WINDOWS);
+
+    /** Map the block stored at pos (as returned by FindBlockPos) */
+    bool MapBlock(const CDiskBlockPos& pos, CBlockFileSpan& span);
+
+    /** Drop all mappings, e.g. when the block index is unloaded */
+    void Clear();
+};
+
+extern CBlockFileMap blockFileMap;
+
+#endif // PRCY_BLOCKFILEMAP_H
@@ -0,0 +1,207 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cachejournal.h"
+
+#include "chainparams.h"
+#include "hash.h"
+#include "util.h"
+
+CCacheJournal::CCacheJournal(const std::string& strFilenameIn, const std::string& strMagicMessageIn) : strFilename(strFilenameIn),
+                                                                                                      strMagicMessage(strMagicMessageIn),
+                                                                                                      file(NULL),
+                                                                                                      nSize(0)
+{
+}
+
+CCacheJournal::~CCacheJournal()
+{
+    Close();
+}
+
+bool CCacheJournal::Open(const ReplayFn& fn)
+{
+    // Records are replayed while closed, so whatever fn appends is not written back
+    Close();
+
+    // Records rotated by a checkpoint that did not complete come first
+    long nHeaderSize = 0;
+    long nValidSize = 0;
+    int nRecords = 0;
+    if (fs::exists(GetRotatedPath()))
+        Replay(GetRotatedPath(), fn, nHeaderSize, nValidSize, nRecords);
+
+    const fs::path path = GetPath();
+    nHeaderSize = nValidSize = 0;
+    Replay(path, fn, nHeaderSize, nValidSize, nRecords);
+
+    LOCK(cs);
+    if (nValidSize > 0) {
+        // Append after the last intact record
+        try {
+            fs::resize_file(path, nValidSize);
+        } catch (const fs::filesystem_error& e) {
+            return error("%s : Failed to truncate %s - %s", __func__, path.string(), e.what());
+        }
+        file = fsbridge::fopen(path, "ab");
+        nSize = nValidSize - nHeaderSize;
+    } else {
+        file = fsbridge::fopen(path, "wb");
+        if (file && !WriteHeader()) {
+            fclose(file);
+            file = NULL;
+        }
+    }
+    if (!file)
+        return error("%s : Failed to open file %s", __func__, path.string());
+
+    LogPrintf("Replayed %d records from %s\n", nRecords, strFilename);
+    return true;
+}
+
+bool CCacheJournal::Replay(const fs::path& path, const ReplayFn& fn, long& nHeaderSize, long& nValidSize, int& nRecords)
+{
+    CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+
+    try {
+        std::string strMagicMessageTmp;
+        unsigned char pchMsgTmp[4];
+        filein >> strMagicMessageTmp;
+        filein >> FLATDATA(pchMsgTmp);
+        if (strMagicMessageTmp != strMagicMessage || memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
+            LogPrintf("%s : %s is not a %s journal, starting over\n", __func__, path.filename().string(), strMagicMessage);
+            return false;
+        }
+        nHeaderSize = nValidSize = ftell(filein.Get());
+        while (true) {
+            uint32_t nLength;
+            filein >> nLength;
+            if (nLength > MAX_SIZE)
+                break;
+            std::vector<unsigned char> vchRecord(nLength);
+            if (nLength)
+                filein.read((char*)&vchRecord[0], nLength);
+            uint256 hashIn;
+            filein >> hashIn;
+            if (hashIn != Hash(vchRecord.begin(), vchRecord.end()))
+                break;
+
+            try {
+                CDataStream ssRecord(vchRecord, SER_DISK, CLIENT_VERSION);
+                unsigned char nType;
+                ssRecord >> nType;
+                fn(nType, ssRecord);
+            } catch (const std::exception& e) {
+                LogPrintf("%s : Skipping %s record - %s\n", __func__, path.filename().string(), e.what());
+            }
+            nRecords++;
+            nValidSize = ftell(filein.Get());
+        }
+    } catch (const std::exception&) {
+        // End of the journal, or a record torn by a crash
+    }
+    return true;
+}
+
+void CCacheJournal::Close()
+{
+    LOCK(cs);
+    if (file) {
+        fclose(file);
+        file = NULL;
+    }
+    nSize = 0;
+}
+
+bool CCacheJournal::IsOpen() const
+{
+    LOCK(cs);
+    return file != NULL;
+}
+
+bool CCacheJournal::Rotate()
+{
+    LOCK(cs);
+    if (!file || fs::exists(GetRotatedPath()))
+        return true;
+
+    const fs::path path = GetPath();
+    fclose(file);
+    file = NULL;
+    if (!RenameOver(path, GetRotatedPath())) {
+        // Keep appending to it, the next checkpoint tries again
+        file = fsbridge::fopen(path, "ab");
+        return error("%s : Failed to rotate %s", __func__, path.string());
+    }
+    file = fsbridge::fopen(path, "wb");
+    if (!file || !WriteHeader()) {
+        if (file) {
+            fclose(file);
+            file = NULL;
+        }
+        return error("%s : Failed to reopen %s", __func__, path.string());
+    }
+    return true;
+}
+
+void CCacheJournal::RemoveRotated()
+{
+    LOCK(cs);
+    try {
+        fs::remove(GetRotatedPath());
+    } catch (const fs::filesystem_error& e) {
+        error("%s : Failed to remove %s - %s", __func__, GetRotatedPath().string(), e.what());
+    }
+}
+
+size_t CCacheJournal::GetSize() const
+{
+    LOCK(cs);
+    return nSize;
+}
+
+fs::path CCacheJournal::GetPath() const
+{
+    return GetDataDir() / strFilename;
+}
+
+fs::path CCacheJournal::GetRotatedPath() const
+{
+    return GetDataDir() / (strFilename + ".old");
+}
+
+bool CCacheJournal::WriteHeader()
+{
+    AssertLockHeld(cs);
+
+    CDataStream ssHeader(SER_DISK, CLIENT_VERSION);
+    ssHeader << strMagicMessage;                   // cache file specific magic message
+    ssHeader << FLATDATA(Params().MessageStart()); // network specific magic number
+    if (fwrite(&ssHeader[0], 1, ssHeader.size(), file) != ssHeader.size() || fflush(file) != 0)
+        return false;
+    nSize = 0;
+    return true;
+}
+
+void CCacheJournal::Write(const CDataStream& ssRecord)
+{
+    LOCK(cs);
+    if (!file)
+        return;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << (uint32_t)ssRecord.size();
+    ss.write(&ssRecord[0], ssRecord.size());
+    ss << Hash(ssRecord.begin(), ssRecord.end());
+    if (fwrite(&ss[0], 1, ss.size(), file) != ss.size() || fflush(file) != 0) {
+        // Stop appending, the cache is still written whole at the next checkpoint
+        error("%s : Failed to append to %s, closing it", __func__, strFilename);
+        fclose(file);
+        file = NULL;
+        return;
+    }
+    nSize += ss.size();
+}
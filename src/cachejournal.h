@@ -0,0 +1,82 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRCY_CACHEJOURNAL_H
+#define PRCY_CACHEJOURNAL_H
+
+#include "clientversion.h"
+#include "fs.h"
+#include "streams.h"
+#include "sync.h"
+
+#include <functional>
+#include <string>
+
+/** Journal size at which its cache file is written whole again */
+static const size_t CACHE_JOURNAL_MAX_BYTES = 16 * 1024 * 1024;
+
+/**
+ * Append-only log of what a cache (mncache.dat, mnpayments.dat, budget.dat)
+ * gained since its file was last written whole, so the cache survives a crash
+ * without being rewritten on every change. Writing the file whole again is
+ * the checkpoint: the journal is rotated when the cache is serialized, and the
+ * rotated records are deleted once the file is renamed into place.
+ *
+ * Every record carries its own checksum. Replay stops at the first torn or
+ * corrupted record, losing only what was appended after it. Records may
+ * repeat what the cache file already holds, so replaying one has to be
+ * harmless the second time.
+ */
+class CCacheJournal
+{
+public:
+    typedef std::function<void(unsigned char nType, CDataStream& ssRecord)> ReplayFn;
+
+    CCacheJournal(const std::string& strFilenameIn, const std::string& strMagicMessageIn);
+    ~CCacheJournal();
+
+    /** Replay the records of the journal in the data directory through fn, then append to it */
+    bool Open(const ReplayFn& fn);
+    void Close();
+    bool IsOpen() const;
+
+    /** Append a record, flushed so it survives the process. Does nothing unless open. */
+    template <typename T>
+    void Append(unsigned char nType, const T& obj)
+    {
+        if (!IsOpen())
+            return;
+        CDataStream ssRecord(SER_DISK, CLIENT_VERSION);
+        ssRecord << nType << obj;
+        Write(ssRecord);
+    }
+
+    /**
+     * Move the records aside and append to an empty journal, under the cache lock the
+     * cache is serialized with. Records moved aside by a checkpoint that failed are
+     * kept, the current journal then goes on collecting the new ones.
+     */
+    bool Rotate();
+
+    /** Delete the records moved aside, once the cache file serialized with them is in place */
+    void RemoveRotated();
+
+    /** Bytes of records appended since the last reset */
+    size_t GetSize() const;
+
+private:
+    const std::string strFilename;
+    const std::string strMagicMessage;
+    mutable Mutex cs;
+    FILE* file;
+    size_t nSize;
+
+    fs::path GetPath() const;
+    fs::path GetRotatedPath() const;
+    bool Replay(const fs::path& path, const ReplayFn& fn, long& nHeaderSize, long& nValidSize, int& nRecords);
+    void Write(const CDataStream& ssRecord);
+    bool WriteHeader();
+};
+
+#endif // PRCY_CACHEJOURNAL_H
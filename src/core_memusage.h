@@ -0,0 +1,46 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CORE_MEMUSAGE_H
+#define BITCOIN_CORE_MEMUSAGE_H
+
+#include "memusage.h"
+#include "primitives/transaction.h"
+
+static inline size_t RecursiveDynamicUsage(const CScript& script)
+{
+    return memusage::DynamicUsage(*static_cast<const CScriptBase*>(&script));
+}
+
+static inline size_t RecursiveDynamicUsage(const CTxIn& in)
+{
+    return RecursiveDynamicUsage(in.scriptSig) + RecursiveDynamicUsage(in.prevPubKey) +
+           memusage::DynamicUsage(in.s) + memusage::DynamicUsage(in.R) +
+           memusage::DynamicUsage(in.encryptionKey) + memusage::DynamicUsage(in.decoys) +
+           memusage::DynamicUsage(in.masternodeStealthAddress);
+}
+
+static inline size_t RecursiveDynamicUsage(const CTxOut& out)
+{
+    return RecursiveDynamicUsage(out.scriptPubKey) + memusage::DynamicUsage(out.txPriv) +
+           memusage::DynamicUsage(out.txPub) + memusage::DynamicUsage(out.masternodeStealthAddress) +
+           memusage::DynamicUsage(out.commitment);
+}
+
+static inline size_t RecursiveDynamicUsage(const CTransaction& tx)
+{
+    size_t mem = memusage::DynamicUsage(tx.vin) + memusage::DynamicUsage(tx.vout) +
+                 memusage::DynamicUsage(tx.bulletproofs) + memusage::DynamicUsage(tx.S);
+    for (const CTxIn& in : tx.vin)
+        mem += RecursiveDynamicUsage(in);
+    for (const CTxOut& out : tx.vout)
+        mem += RecursiveDynamicUsage(out);
+    // Ring signature matrix, one row per ring member
+    for (const std::vector<uint256>& row : tx.S)
+        mem += memusage::DynamicUsage(row);
+    return mem;
+}
+
+#endif // BITCOIN_CORE_MEMUSAGE_H
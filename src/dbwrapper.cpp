@@ -8,6 +8,8 @@
 
 #include <boost/scoped_ptr.hpp>
 
+#include <atomic>
+
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
 #include <leveldb/filter_policy.h>
@@ -39,12 +41,63 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+namespace
+{
+/** LRU block cache that counts lookup hits and misses */
+class CCountingCache : public leveldb::Cache
+{
+private:
+    leveldb::Cache* base;
+
+public:
+    std::atomic<uint64_t> nHits;
+    std::atomic<uint64_t> nMisses;
+
+    explicit CCountingCache(size_t capacity) : base(leveldb::NewLRUCache(capacity)), nHits(0), nMisses(0) {}
+    ~CCountingCache() { delete base; }
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge, void (*deleter)(const leveldb::Slice& key, void* value)) override
+    {
+        return base->Insert(key, value, charge, deleter);
+    }
+
+    Handle* Lookup(const leveldb::Slice& key) override
+    {
+        Handle* handle = base->Lookup(key);
+        if (handle)
+            nHits++;
+        else
+            nMisses++;
+        return handle;
+    }
+
+    void Release(Handle* handle) override { base->Release(handle); }
+    void* Value(Handle* handle) override { return base->Value(handle); }
+    void Erase(const leveldb::Slice& key) override { base->Erase(key); }
+    uint64_t NewId() override { return base->NewId(); }
+    void Prune() override { base->Prune(); }
+    size_t TotalCharge() const override { return base->TotalCharge(); }
+};
+} // namespace
+
+static size_t GetBlockCacheSize(size_t nCacheSize, DBProfile profile)
+{
+    // Point lookups are served from the block cache, not from the write buffers
+    return profile == DB_PROFILE_POINT_READS ? nCacheSize / 4 * 3 : nCacheSize / 2;
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, DBProfile profile)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.block_cache = new CCountingCache(GetBlockCacheSize(nCacheSize, profile));
+    if (profile == DB_PROFILE_POINT_READS) {
+        options.write_buffer_size = nCacheSize / 8; // up to two write buffers may be held in memory simultaneously
+        // More bits per key cut down disk reads for keys that are not there, the common case for lookups
+        options.filter_policy = leveldb::NewBloomFilterPolicy(16);
+    } else {
+        options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+        options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    }
     options.compression = leveldb::kNoCompression;
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -55,14 +108,15 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe)
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, DBProfile profile)
 {
     penv = NULL;
+    nBlockCacheSize = GetBlockCacheSize(nCacheSize, profile);
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, profile);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -107,6 +161,17 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+CDBCacheStats CDBWrapper::GetCacheStats() const
+{
+    CDBCacheStats stats;
+    const CCountingCache* cache = static_cast<const CCountingCache*>(options.block_cache);
+    stats.nCacheSize = nBlockCacheSize;
+    stats.nCacheUsage = cache->TotalCharge();
+    stats.nHits = cache->nHits;
+    stats.nMisses = cache->nMisses;
+    return stats;
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
@@ -16,6 +16,10 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+namespace leveldb {
+class Cache;
+}
+
 class dbwrapper_error : public std::runtime_error
 {
 public:
@@ -24,6 +28,22 @@ public:
 
 class CDBWrapper;
 
+/** How a database is mostly accessed, used to pick its LevelDB tuning */
+enum DBProfile {
+    DB_PROFILE_DEFAULT,     //!< mixed reads, writes and iteration
+    DB_PROFILE_POINT_READS, //!< random lookups of single keys, most of them misses
+};
+
+/** Block cache statistics of one database */
+struct CDBCacheStats {
+    size_t nCacheSize;
+    size_t nCacheUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    CDBCacheStats() : nCacheSize(0), nCacheUsage(0), nHits(0), nMisses(0) {}
+};
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -155,14 +175,18 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! size of the block cache in options
+    size_t nBlockCacheSize;
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
      * @param[in] nCacheSize  Configures various leveldb cache settings.
      * @param[in] fMemory     If true, use leveldb's memory environment.
      * @param[in] fWipe       If true, remove all existing data.
+     * @param[in] profile     Access pattern the leveldb options are tuned for.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, DBProfile profile = DB_PROFILE_DEFAULT);
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -250,6 +274,27 @@ public:
      */
      bool IsEmpty();
 
+    /**
+     * Compact the key range [begin, end], e.g. after a large part of it was erased.
+     */
+    template <typename K>
+    void CompactRange(const K& key_begin, const K& key_end) const
+    {
+        CDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
+        ssKey1.reserve(ssKey1.GetSerializeSize(key_begin));
+        ssKey2.reserve(ssKey2.GetSerializeSize(key_end));
+        ssKey1 << key_begin;
+        ssKey2 << key_end;
+        leveldb::Slice slKey1(&ssKey1[0], ssKey1.size());
+        leveldb::Slice slKey2(&ssKey2[0], ssKey2.size());
+        pdb->CompactRange(&slKey1, &slKey2);
+    }
+
+    /**
+     * Return hit and miss counts of the block cache since the database was opened.
+     */
+    CDBCacheStats GetCacheStats() const;
+
 };
 
 #endif // BITCOIN_DBWRAPPER_H
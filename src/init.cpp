@@ -29,6 +29,7 @@
 #include "masternodeman.h"
 #include "messagesigner.h"
 #include "miner.h"
+#include "msgverifyqueue.h"
 #include "netbase.h"
 #include "net.h"
 #include "rpc/server.h"
@@ -37,6 +38,7 @@
 #include "scheduler.h"
 #include "txdb.h"
 #include "torcontrol.h"
+#include "txvalidationqueue.h"
 #include "guiinterface.h"
 #include "guiinterfaceutil.h"
 #include "util.h"
@@ -373,7 +375,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-maxreorg=<n>", strprintf(_("Set the Maximum reorg depth (default: %u)"), Params(CBaseChainParams::MAIN).MaxReorganizationDepth()));
+    strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-msgverifythreads=<n>", strprintf(_("Set the number of threads verifying masternode, budget and SwiftTX messages ahead of processing (0 to %d, 0 = disabled, default: %d)"), MAX_MSGVERIFY_THREADS, DEFAULT_MSGVERIFY_THREADS));
+    strUsage += HelpMessageOpt("-txverifythreads=<n>", strprintf(_("Set the number of threads verifying relayed transactions (0 to %d, 0 = verify on the message handler thread, default: %d)"), MAX_TXVERIFY_THREADS, DEFAULT_TXVERIFY_THREADS));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), "prcycoind.pid"));
@@ -411,6 +416,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), 1));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Socket events mode, which must be one of: select, epoll (default: %s)"), DEFAULT_SOCKETEVENTS));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
@@ -933,7 +939,18 @@ bool AppInit2(bool isDaemon)
     // Make sure enough file descriptors are available
     int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    std::string strSocketEvents = GetArg("-socketevents", DEFAULT_SOCKETEVENTS);
+    if (strSocketEvents != "select" && strSocketEvents != "epoll")
+        return UIError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: select, epoll"), strSocketEvents));
+#ifndef HAVE_SYS_EPOLL_H
+    if (strSocketEvents == "epoll")
+        return UIError(_("-socketevents=epoll is not supported on this platform"));
+#endif
+    // select() can't watch descriptors >= FD_SETSIZE
+    if (strSocketEvents == "select")
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    else
+        nMaxConnections = std::max(nMaxConnections, 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return UIError(_("Not enough file descriptors available."));
@@ -998,6 +1015,9 @@ bool AppInit2(bool isDaemon)
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    nTxVerifyThreads = std::max(0, std::min((int)GetArg("-txverifythreads", DEFAULT_TXVERIFY_THREADS), MAX_TXVERIFY_THREADS));
+    nMsgVerifyThreads = std::max(0, std::min((int)GetArg("-msgverifythreads", DEFAULT_MSGVERIFY_THREADS), MAX_MSGVERIFY_THREADS));
+
     setvbuf(stdout, NULL, _IOLBF, 0); /// ***TODO*** do we still need this after -printtoconsole is gone?
 
     // Staking needs a CWallet instance, so make sure wallet is enabled
@@ -1096,6 +1116,14 @@ bool AppInit2(bool isDaemon)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    LogPrintf("Using %u threads for relayed transaction verification\n", nTxVerifyThreads);
+    for (int i = 0; i < nTxVerifyThreads; i++)
+        threadGroup.create_thread(&ThreadTxVerify);
+
+    LogPrintf("Using %u threads for masternode, budget and SwiftTX message verification\n", nMsgVerifyThreads);
+    for (int i = 0; i < nMsgVerifyThreads; i++)
+        threadGroup.create_thread(&ThreadMessageVerify);
+
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
@@ -1403,11 +1431,14 @@ bool AppInit2(bool isDaemon)
     if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", true))
         nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nKeyImageDBCache = std::min(nTotalCache / 8, (int64_t)1 << 26); // key images are checked for every input, give them up to 64 MiB
+    nTotalCache -= nKeyImageDBCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for key image database\n", nKeyImageDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
 
@@ -1428,7 +1459,7 @@ bool AppInit2(bool isDaemon)
                 delete pcoinscatcher;
                 delete pblocktree;
 
-                pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
+                pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex, nKeyImageDBCache);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
@@ -1813,6 +1844,7 @@ bool AppInit2(bool isDaemon)
         else
             LogPrintf("file format is unknown or invalid, please fix it manually\n");
     }
+    mnodeman.OpenJournal();
 
     uiInterface.InitMessage(_("Loading budget cache..."));
 
@@ -1828,6 +1860,7 @@ bool AppInit2(bool isDaemon)
         else
             LogPrintf("file format is unknown or invalid, please fix it manually\n");
     }
+    budget.OpenJournal();
 
     //flag our cached items so we send them to our peers
     budget.ResetSync();
@@ -1848,6 +1881,7 @@ bool AppInit2(bool isDaemon)
         else
             LogPrintf("file format is unknown or invalid, please fix it manually\n");
     }
+    masternodePayments.OpenJournal();
 
     fMasterNode = GetBoolArg("-masternode", false);
 
@@ -10,6 +10,8 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "blockencodings.h"
+#include "blockfilemap.h"
 #include "blocksignature.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -26,11 +28,15 @@
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "merkleblock.h"
+#include "messagesigner.h"
+#include "msgverifyqueue.h"
 #include "net.h"
 #include "poa.h"
+#include "sendcache.h"
 #include "swifttx.h"
 #include "txdb.h"
 #include "txmempool.h"
+#include "txvalidationqueue.h"
 #include "guiinterface.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -77,9 +83,13 @@ std::condition_variable g_best_block_cv;
 uint256 g_best_block;
 
 int nScriptCheckThreads = 0;
+int nTxVerifyThreads = 0;
+int nMsgVerifyThreads = 0;
 std::atomic<bool> fImporting{false};
 std::atomic<bool> fReindex{false};
 bool fTxIndex = true;
+/** Whether the key image table may still hold entries of disconnected blocks (databases created before they were undone) */
+static bool fLegacyKeyImageIndex = true;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
@@ -104,12 +114,19 @@ CTxMemPool mempool(::minRelayTxFee);
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
+    int64_t nTimeExpire;
+    //! Ring member txids that are not in a block yet
+    std::set<uint256> setMissing;
 };
 std::map<uint256, COrphanTx> mapOrphanTransactions;
+//! Orphan transactions by the txid of a missing ring member (decoy or real input)
 std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
+//! Orphan transactions whose ring members all arrived, waiting to be validated again
+std::set<uint256> setOrphanTransactionsReady;
 std::map<uint256, int64_t> mapRejectedBlocks;
 
 void EraseOrphansFor(NodeId peer);
+static void ProcessReadyOrphans();
 
 static void CheckBlockIndex();
 
@@ -205,6 +222,26 @@ struct QueuedBlock {
 };
 std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
+/** Compact blocks that were requested, or are waiting for their missing transactions. Protected by cs_main. */
+struct CCompactBlockInFlight {
+    NodeId nodeid;
+    int64_t nTime;                                          //! Time of "getdata" request in seconds.
+    std::unique_ptr<PartiallyDownloadedBlock> partialBlock; //! Set once the cmpctblock arrived and a getblocktxn is pending.
+};
+std::map<uint256, CCompactBlockInFlight> mapCompactBlocksInFlight;
+
+/** A requested block that arrived before its parent. */
+struct BlockAwaitingParent {
+    std::shared_ptr<const CBlock> pblock;
+    NodeId nodeid;      //! Peer the block came from, to be punished if it turns out invalid.
+    unsigned int nSize; //! Serialized size.
+    int64_t nTime;      //! Time of arrival in seconds.
+};
+/** Blocks downloaded ahead of their parent, processed in chain order once the parent is accepted. Protected by cs_main. */
+std::map<uint256, BlockAwaitingParent> mapBlocksAwaitingParent;
+std::multimap<uint256, uint256> mapBlocksAwaitingParentByPrev;
+size_t nBlocksAwaitingParentSize = 0;
+
 /** Number of blocks in flight with validated headers. */
 int nQueuedValidatedHeaders = 0;
 
@@ -280,11 +317,23 @@ double GetPriority(const CTransaction& tx, int nHeight)
     return 1000000000 + tx.ComputePriority(dResult);
 }
 
+/** Read the block(s) recorded as spending a key image. Only legacy databases can hold more than one. */
+static bool ReadKeyImageBlocks(const std::string& kiHex, std::vector<uint256>& bhs)
+{
+    if (fLegacyKeyImageIndex)
+        return pblocktree->ReadKeyImages(kiHex, bhs);
+    uint256 bh;
+    if (!pblocktree->ReadKeyImage(kiHex, bh))
+        return false;
+    bhs.push_back(bh);
+    return true;
+}
+
 bool IsSpentKeyImage(const std::string& kiHex, const uint256& againsHash)
 {
     if (kiHex.empty()) return false;
     std::vector<uint256> bhs;
-    if (!pblocktree->ReadKeyImages(kiHex, bhs)) {
+    if (!ReadKeyImageBlocks(kiHex, bhs)) {
         //not spent yet because not found in database
         return false;
     }
@@ -322,7 +371,7 @@ bool CheckKeyImageSpendInMainChain(const std::string& kiHex, int& confirmations)
     confirmations = 0;
     if (kiHex.empty()) return false;
     std::vector<uint256> bhs;
-    if (!pblocktree->ReadKeyImages(kiHex, bhs)) {
+    if (!ReadKeyImageBlocks(kiHex, bhs)) {
         //not spent yet because not found in database
         return false;
     }
@@ -373,9 +422,9 @@ void DestroyContext()
     secp256k1_context_destroy(GetContext());
 }
 
-bool VerifyBulletProofAggregate(const CTransaction& tx)
+/** Verify the bulletproof of tx, also during initial download */
+static bool VerifyBulletProof(const CTransaction& tx, secp256k1_scratch_space2* scratch)
 {
-    if (IsInitialBlockDownload()) return true;
     size_t len = tx.bulletproofs.size();
     if (tx.vout.size() >= 5) return false;
 
@@ -387,16 +436,27 @@ bool VerifyBulletProofAggregate(const CTransaction& tx)
         if (!secp256k1_pedersen_commitment_parse(GetContext(), &commitments[i], &(tx.vout[i].commitment[0])))
             throw std::runtime_error("Failed to parse pedersen commitment");
     }
-    return secp256k1_bulletproof_rangeproof_verify(GetContext(), GetScratch(), GetGenerator(), &(tx.bulletproofs[0]), len, NULL, commitments, tx.vout.size(), 64, &secp256k1_generator_const_h, NULL, 0);
+    if (!scratch)
+        scratch = GetScratch();
+    return secp256k1_bulletproof_rangeproof_verify(GetContext(), scratch, GetGenerator(), &(tx.bulletproofs[0]), len, NULL, commitments, tx.vout.size(), 64, &secp256k1_generator_const_h, NULL, 0);
 }
 
-bool VerifyRingSignatureWithTxFee(const CTransaction& tx, CBlockIndex* pindex)
+bool VerifyBulletProofAggregate(const CTransaction& tx, secp256k1_scratch_space2* scratch)
 {
-    if (tx.nTxFee < 0) return false;
     if (IsInitialBlockDownload()) return true;
+    return VerifyBulletProof(tx, scratch);
+}
+
+/**
+ * Verify the ring signature of tx with its ring members on the chain of pindex,
+ * under the given ring size rules. Leaves the MIN_RING_SIZE/MAX_RING_SIZE
+ * globals alone, so it is safe on the verification threads.
+ */
+static bool VerifyRingSignature(const CTransaction& tx, CBlockIndex* pindex, int nMinRingSize, int nMaxRingSize)
+{
+    if (tx.nTxFee < 0) return false;
     const size_t MAX_VIN = MAX_TX_INPUTS;
-    SetRingSize(pindex->nHeight);
-    const size_t MAX_DECOYS = MAX_RING_SIZE; //padding 1 for safety reasons
+    const size_t MAX_DECOYS = nMaxRingSize; //padding 1 for safety reasons
     const size_t MAX_VOUT = 5;
 
     if (tx.vin.size() > MAX_VIN) {
@@ -414,8 +474,8 @@ bool VerifyRingSignatureWithTxFee(const CTransaction& tx, CBlockIndex* pindex)
         return false;
     }
 
-    if (tx.vin[0].decoys.size() > MAX_DECOYS || tx.vin[0].decoys.size() < MIN_RING_SIZE) {
-        LogPrintf("The number of decoys RingSize %d not within range [%d, %d]\n", tx.vin[0].decoys.size(), MIN_RING_SIZE, MAX_RING_SIZE);
+    if (tx.vin[0].decoys.size() > MAX_DECOYS || tx.vin[0].decoys.size() < (size_t)nMinRingSize) {
+        LogPrintf("The number of decoys RingSize %d not within range [%d, %d]\n", tx.vin[0].decoys.size(), nMinRingSize, nMaxRingSize);
         return false; //maximum decoys = 15
     }
 
@@ -449,20 +509,24 @@ bool VerifyRingSignatureWithTxFee(const CTransaction& tx, CBlockIndex* pindex)
                 LogPrintf("Failed to find transaction %s\n", decoysForIn[j].hash.GetHex());
                 return false;
             }
-            CBlockIndex* tip = chainActive.Tip();
-            if (!pindex) tip = pindex;
+            {
+                // The block index is only read under cs_main, also on the verification threads
+                LOCK(cs_main);
+                CBlockIndex* tip = chainActive.Tip();
+                if (pindex) tip = pindex;
 
-            uint256 hashTip = tip->GetBlockHash();
-            //verify that tip and hashBlock must be in the same fork
-            CBlockIndex* atTheblock = mapBlockIndex[hashBlock];
-            if (!atTheblock) {
-                LogPrintf("%s: Decoy for transaction %s not in the same chain as block height=%s hash=%s\n", __func__, decoysForIn[j].hash.GetHex(), tip->nHeight, tip->GetBlockHash().GetHex());
-                return false;
-            } else {
-                CBlockIndex* ancestor = tip->GetAncestor(atTheblock->nHeight);
-                if (ancestor != atTheblock) {
+                //verify that tip and hashBlock must be in the same fork
+                BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+                CBlockIndex* atTheblock = mi == mapBlockIndex.end() ? NULL : mi->second;
+                if (!atTheblock) {
                     LogPrintf("%s: Decoy for transaction %s not in the same chain as block height=%s hash=%s\n", __func__, decoysForIn[j].hash.GetHex(), tip->nHeight, tip->GetBlockHash().GetHex());
                     return false;
+                } else {
+                    CBlockIndex* ancestor = tip->GetAncestor(atTheblock->nHeight);
+                    if (ancestor != atTheblock) {
+                        LogPrintf("%s: Decoy for transaction %s not in the same chain as block height=%s hash=%s\n", __func__, decoysForIn[j].hash.GetHex(), tip->nHeight, tip->GetBlockHash().GetHex());
+                        return false;
+                    }
                 }
             }
 
@@ -618,6 +682,14 @@ bool VerifyRingSignatureWithTxFee(const CTransaction& tx, CBlockIndex* pindex)
     return HexStr(tx.c.begin(), tx.c.end()) == HexStr(C, C + 32);
 }
 
+bool VerifyRingSignatureWithTxFee(const CTransaction& tx, CBlockIndex* pindex)
+{
+    if (IsInitialBlockDownload()) return tx.nTxFee >= 0;
+    int nMinRingSize, nMaxRingSize;
+    GetRingSizeBounds(pindex->nHeight, nMinRingSize, nMaxRingSize);
+    return VerifyRingSignature(tx, pindex, nMinRingSize, nMaxRingSize);
+}
+
 bool ReVerifyPoSBlock(CBlockIndex* pindex)
 {
     LOCK(cs_main);
@@ -811,6 +883,16 @@ struct CNodeState {
     int64_t nStallingSince;
     std::list<QueuedBlock> vBlocksInFlight;
     int nBlocksInFlight;
+    //! Number of blocks that may be in flight from this peer at the same time.
+    int nBlockWindow;
+    //! Moving average of the rate blocks arrive at when requested back to back, in bytes per second (0 = unknown).
+    int64_t nBlockBytesPerSec;
+    //! Moving average of the size of the blocks received from this peer.
+    int64_t nBlockSizeAvg;
+    //! Time the last requested block from this peer arrived (in microseconds), or 0.
+    int64_t nLastBlockReceived;
+    //! Blocks this peer announced during initial download, waiting for room in its download window.
+    std::deque<uint256> vBlocksToDownload;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
 
@@ -827,6 +909,10 @@ struct CNodeState {
         fSyncStarted = false;
         nStallingSince = 0;
         nBlocksInFlight = 0;
+        nBlockWindow = DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER;
+        nBlockBytesPerSec = 0;
+        nBlockSizeAvg = 0;
+        nLastBlockReceived = 0;
         fPreferredDownload = false;
     }
 };
@@ -875,6 +961,9 @@ void InitializeNode(NodeId nodeid, const CNode* pnode)
 
 void FinalizeNode(NodeId nodeid)
 {
+    txValidationQueue.RemovePeer(nodeid);
+    msgVerifyQueue.RemovePeer(nodeid);
+
     LOCK(cs_main);
     CNodeState* state = State(nodeid);
 
@@ -890,6 +979,12 @@ void FinalizeNode(NodeId nodeid)
 
     for (const QueuedBlock& entry : state->vBlocksInFlight)
         mapBlocksInFlight.erase(entry.hash);
+    for (std::map<uint256, CCompactBlockInFlight>::iterator it = mapCompactBlocksInFlight.begin(); it != mapCompactBlocksInFlight.end();) {
+        if (it->second.nodeid == nodeid)
+            mapCompactBlocksInFlight.erase(it++);
+        else
+            ++it;
+    }
     EraseOrphansFor(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
 
@@ -926,6 +1021,162 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, CBlockIndex* pindex
     mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
 }
 
+// Requires cs_main.
+/** Update the download rate estimate of nodeid with a block it sent us, if we asked it for that block. */
+void UpdateBlockDownloadStats(NodeId nodeid, const uint256& hash, unsigned int nSize, int64_t nTimeReceived)
+{
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return;
+    CNodeState* state = State(nodeid);
+    assert(state != NULL);
+
+    state->nBlockSizeAvg = state->nBlockSizeAvg == 0 ? nSize : (7 * state->nBlockSizeAvg + nSize) / 8;
+    // Only a block that was already requested when the previous one arrived measures the link,
+    // otherwise the interval includes the time we had nothing in flight.
+    if (state->nLastBlockReceived != 0 && itInFlight->second.second->nTime <= state->nLastBlockReceived) {
+        const int64_t nInterval = std::max<int64_t>(nTimeReceived - state->nLastBlockReceived, 1);
+        const int64_t nRate = (int64_t)nSize * 1000000 / nInterval;
+        state->nBlockBytesPerSec = state->nBlockBytesPerSec == 0 ? nRate : (7 * state->nBlockBytesPerSec + nRate) / 8;
+    }
+    state->nLastBlockReceived = nTimeReceived;
+}
+
+/**
+ * Number of blocks to keep in flight from a peer: twice its bandwidth-delay
+ * product in blocks, so the link stays busy while our requests travel. Fast,
+ * distant peers get a large window; slow peers a small one, so they don't hold
+ * up blocks other peers could deliver sooner.
+ */
+int GetBlockDownloadWindow(const CNodeState& state, int64_t nRoundTripUsec)
+{
+    if (state.nBlockBytesPerSec == 0 || nRoundTripUsec <= 0 || nRoundTripUsec == std::numeric_limits<int64_t>::max())
+        return DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER;
+    const int64_t nWindow = 2 * state.nBlockBytesPerSec * nRoundTripUsec / 1000000 / std::max<int64_t>(state.nBlockSizeAvg, 1) + 1;
+    return std::max<int64_t>(MIN_BLOCKS_IN_TRANSIT_PER_PEER, std::min<int64_t>(nWindow, MAX_BLOCKS_IN_TRANSIT_PER_PEER));
+}
+
+// Requires cs_main.
+/**
+ * Keep a block we requested from nodeid whose parent hasn't arrived yet, if its
+ * parent is on its way too. Returns false if the block should be handled as an
+ * unconnected block instead.
+ */
+bool AddBlockAwaitingParent(NodeId nodeid, const CBlock& block, unsigned int nSize)
+{
+    const uint256 hash = block.GetHash();
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return false;
+    if (!mapBlocksInFlight.count(block.hashPrevBlock) && !mapBlocksAwaitingParent.count(block.hashPrevBlock))
+        return false;
+
+    // Forget blocks whose parent never showed up
+    const int64_t nNow = GetTime();
+    for (std::map<uint256, BlockAwaitingParent>::iterator it = mapBlocksAwaitingParent.begin(); it != mapBlocksAwaitingParent.end();) {
+        if (it->second.nTime < nNow - BLOCK_AWAITING_PARENT_EXPIRE_TIME) {
+            std::pair<std::multimap<uint256, uint256>::iterator, std::multimap<uint256, uint256>::iterator> range =
+                mapBlocksAwaitingParentByPrev.equal_range(it->second.pblock->hashPrevBlock);
+            for (std::multimap<uint256, uint256>::iterator itPrev = range.first; itPrev != range.second; ++itPrev) {
+                if (itPrev->second == it->first) {
+                    mapBlocksAwaitingParentByPrev.erase(itPrev);
+                    break;
+                }
+            }
+            nBlocksAwaitingParentSize -= it->second.nSize;
+            mapBlocksAwaitingParent.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    if (mapBlocksAwaitingParent.count(hash) || nBlocksAwaitingParentSize + nSize > MAX_BLOCKS_AWAITING_PARENT_SIZE)
+        return false;
+
+    MarkBlockAsReceived(hash);
+    BlockAwaitingParent& entry = mapBlocksAwaitingParent[hash];
+    entry.pblock = std::make_shared<const CBlock>(block);
+    entry.nodeid = nodeid;
+    entry.nSize = nSize;
+    entry.nTime = nNow;
+    mapBlocksAwaitingParentByPrev.insert(std::make_pair(block.hashPrevBlock, hash));
+    nBlocksAwaitingParentSize += nSize;
+    return true;
+}
+
+/**
+ * Process the downloaded blocks that were waiting for hashParent, and their own
+ * children after them. Going in chain order means a PoA block only gets
+ * validated once the PoS blocks it audits are in the block index.
+ */
+void ProcessBlocksAwaitingParent(const uint256& hashParent)
+{
+    AssertLockNotHeld(cs_main);
+    std::deque<uint256> vParents(1, hashParent);
+    while (!vParents.empty()) {
+        std::vector<BlockAwaitingParent> vChildren;
+        {
+            LOCK(cs_main);
+            const bool fParentAccepted = mapBlockIndex.count(vParents.front()) > 0;
+            std::pair<std::multimap<uint256, uint256>::iterator, std::multimap<uint256, uint256>::iterator> range =
+                mapBlocksAwaitingParentByPrev.equal_range(vParents.front());
+            for (std::multimap<uint256, uint256>::iterator it = range.first; it != range.second; ++it) {
+                std::map<uint256, BlockAwaitingParent>::iterator itBlock = mapBlocksAwaitingParent.find(it->second);
+                if (fParentAccepted)
+                    vChildren.push_back(itBlock->second);
+                nBlocksAwaitingParentSize -= itBlock->second.nSize;
+                mapBlocksAwaitingParent.erase(itBlock);
+            }
+            mapBlocksAwaitingParentByPrev.erase(range.first, range.second);
+        }
+        vParents.pop_front();
+
+        for (const BlockAwaitingParent& child : vChildren) {
+            CBlock block(*child.pblock);
+            CValidationState state;
+            ProcessNewBlock(state, NULL, &block);
+            int nDoS;
+            if (state.IsInvalid(nDoS) && nDoS > 0) {
+                LOCK(cs_main);
+                Misbehaving(child.nodeid, nDoS);
+            }
+            vParents.push_back(block.GetHash());
+        }
+    }
+}
+
+// Requires cs_main.
+/** Whether hash should be asked from pnode as a compact block. Records the request if so. */
+bool MarkCompactBlockAsInFlight(const CNode* pnode, const uint256& hash)
+{
+    if (pnode->nVersion < COMPACT_BLOCKS_VERSION || IsInitialBlockDownload())
+        return false;
+
+    // Forget requests that were answered by a full block or never answered at all
+    const int64_t nNow = GetTime();
+    for (std::map<uint256, CCompactBlockInFlight>::iterator it = mapCompactBlocksInFlight.begin(); it != mapCompactBlocksInFlight.end();) {
+        if (it->second.nTime < nNow - CMPCTBLOCK_TIMEOUT || mapBlockIndex.count(it->first))
+            mapCompactBlocksInFlight.erase(it++);
+        else
+            ++it;
+    }
+    if (mapCompactBlocksInFlight.count(hash) || mapCompactBlocksInFlight.size() >= MAX_CMPCTBLOCKS_IN_FLIGHT)
+        return false;
+
+    CCompactBlockInFlight& entry = mapCompactBlocksInFlight[hash];
+    entry.nodeid = pnode->GetId();
+    entry.nTime = nNow;
+    return true;
+}
+
+// Requires cs_main.
+/** Give up on reconstructing a compact block and ask pnode for the full block instead */
+void RequestFullBlock(CNode* pnode, const uint256& hash)
+{
+    mapCompactBlocksInFlight.erase(hash);
+    std::vector<CInv> vGetData(1, CInv(MSG_BLOCK, hash));
+    pnode->PushMessage(NetMsgType::GETDATA, vGetData);
+}
+
 /** Check whether the last unknown block a peer advertiszed is not yet known. */
 void ProcessBlockAvailability(NodeId nodeid)
 {
@@ -1091,6 +1342,8 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats)
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlockWindow = state->nBlockWindow;
+    stats.nBlockBytesPerSec = state->nBlockBytesPerSec;
     return true;
 }
 
@@ -1143,24 +1396,29 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer)
 
     // Ignore big transactions, to avoid a
     // send-big-orphans memory exhaustion attack. If a peer has a legitimate
-    // large transaction with a missing parent then we assume
-    // it will rebroadcast it later, after the parent transaction(s)
-    // have been mined or received.
-    // 10,000 orphans, each of which is at most 5,000 bytes big is
-    // at most 500 megabytes of orphans:
+    // large transaction with a missing ring member then we assume
+    // it will rebroadcast it later, after the ring member(s)
+    // have been mined.
     unsigned int sz = tx.GetSerializeSize(SER_NETWORK, CTransaction::CURRENT_VERSION);
-    if (sz > 5000) {
+    if (sz > MAX_ORPHAN_TX_SIZE) {
         LogPrint(BCLog::MEMPOOL, "ignoring large orphan tx (size: %u, hash: %s)\n", sz, hash.ToString());
         return false;
     }
 
-    mapOrphanTransactions[hash].tx = tx;
-    mapOrphanTransactions[hash].fromPeer = peer;
-    for (const CTxIn& txin : tx.vin)
-        mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
+    std::set<uint256> setMissing;
+    if (!GetMissingRingMembers(tx, setMissing))
+        return false;
+
+    COrphanTx& orphan = mapOrphanTransactions[hash];
+    orphan.tx = tx;
+    orphan.fromPeer = peer;
+    orphan.nTimeExpire = GetTime() + ORPHAN_TX_EXPIRE_TIME;
+    orphan.setMissing.swap(setMissing);
+    for (const uint256& missing : orphan.setMissing)
+        mapOrphanTransactionsByPrev[missing].insert(hash);
 
-    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u prevsz %u)\n", hash.ToString(),
-        mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
+    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s missing %u ring members (mapsz %u prevsz %u)\n", hash.ToString(),
+        orphan.setMissing.size(), mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
     return true;
 }
 
@@ -1169,14 +1427,15 @@ void static EraseOrphanTx(uint256 hash)
     std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
     if (it == mapOrphanTransactions.end())
         return;
-    for (const CTxIn& txin : it->second.tx.vin) {
-        std::map<uint256, std::set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
+    for (const uint256& missing : it->second.setMissing) {
+        std::map<uint256, std::set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(missing);
         if (itPrev == mapOrphanTransactionsByPrev.end())
             continue;
         itPrev->second.erase(hash);
         if (itPrev->second.empty())
             mapOrphanTransactionsByPrev.erase(itPrev);
     }
+    setOrphanTransactionsReady.erase(hash);
     mapOrphanTransactions.erase(it);
 }
 
@@ -1198,6 +1457,26 @@ void EraseOrphansFor(NodeId peer)
 unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
 {
     unsigned int nEvicted = 0;
+    static int64_t nNextSweep;
+    int64_t nNow = GetTime();
+    if (nNextSweep <= nNow) {
+        // Sweep out expired orphan pool entries:
+        int nErased = 0;
+        int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
+        std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
+        while (iter != mapOrphanTransactions.end()) {
+            std::map<uint256, COrphanTx>::iterator maybeErase = iter++;
+            if (maybeErase->second.nTimeExpire <= nNow) {
+                EraseOrphanTx(maybeErase->first);
+                ++nErased;
+            } else {
+                nMinExpTime = std::min(maybeErase->second.nTimeExpire, nMinExpTime);
+            }
+        }
+        // Sweep again 5 minutes after the next entry that expires in order to batch the linear scan.
+        nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
+        if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx due to expiration\n", nErased);
+    }
     while (mapOrphanTransactions.size() > nMaxOrphans) {
         // Evict a random orphan:
         uint256 randomhash = GetRandHash();
@@ -1210,6 +1489,28 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
     return nEvicted;
 }
 
+/** Mark the ring members confirmed by a connected block, orphans left without missing members become ready */
+void static OrphanRingMembersConfirmed(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    if (mapOrphanTransactionsByPrev.empty())
+        return;
+    for (const CTransaction& tx : block.vtx) {
+        std::map<uint256, std::set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(tx.GetHash());
+        if (itPrev == mapOrphanTransactionsByPrev.end())
+            continue;
+        for (const uint256& orphanHash : itPrev->second) {
+            std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(orphanHash);
+            if (it == mapOrphanTransactions.end())
+                continue;
+            it->second.setMissing.erase(tx.GetHash());
+            if (it->second.setMissing.empty())
+                setOrphanTransactionsReady.insert(orphanHash);
+        }
+        mapOrphanTransactionsByPrev.erase(itPrev);
+    }
+}
+
 bool IsStandardTx(const CTransaction& tx, std::string& reason)
 {
     AssertLockHeld(cs_main);
@@ -1575,8 +1876,123 @@ bool CheckHaveInputs(const CCoinsViewCache& view, const CTransaction& tx)
     return true;
 }
 
+/** Maximum number of relayed transactions remembered with verified proofs for block connection */
+static const size_t MAX_RELAY_VERIFIED_PROOFS = 20000;
+
+/** Ring signature and bulletproof of a relayed transaction that were found valid */
+struct CRelayVerifiedProofs {
+    uint256 hashTip;  //! Tip the ring members were checked against
+    int nMinRingSize; //! Ring size rules the signature was checked against
+    int nMaxRingSize;
+};
+
+static Mutex cs_relayVerifiedProofs;
+//! Relayed transactions whose proofs don't need to be verified again when a block including them is connected
+static std::map<uint256, CRelayVerifiedProofs> mapRelayVerifiedProofs;
+
+static void AddRelayVerifiedProofs(const CTransaction& tx, const CBlockIndex* pindexTip, int nMinRingSize, int nMaxRingSize)
+{
+    LOCK(cs_relayVerifiedProofs);
+    if (mapRelayVerifiedProofs.size() >= MAX_RELAY_VERIFIED_PROOFS) {
+        // Evict a random entry
+        std::map<uint256, CRelayVerifiedProofs>::iterator it = mapRelayVerifiedProofs.lower_bound(GetRandHash());
+        if (it == mapRelayVerifiedProofs.end())
+            it = mapRelayVerifiedProofs.begin();
+        mapRelayVerifiedProofs.erase(it);
+    }
+    CRelayVerifiedProofs& entry = mapRelayVerifiedProofs[tx.GetHash()];
+    entry.hashTip = pindexTip->GetBlockHash();
+    entry.nMinRingSize = nMinRingSize;
+    entry.nMaxRingSize = nMaxRingSize;
+}
+
+/**
+ * Whether the proofs of tx were verified on relay in a way that still holds for
+ * connecting it in the block at pindex: the ring members were found on the chain
+ * pindex builds on, under the ring size rules of pindex. Requires cs_main.
+ */
+static bool HaveRelayVerifiedProofs(const CTransaction& tx, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    CRelayVerifiedProofs entry;
+    {
+        LOCK(cs_relayVerifiedProofs);
+        std::map<uint256, CRelayVerifiedProofs>::const_iterator it = mapRelayVerifiedProofs.find(tx.GetHash());
+        if (it == mapRelayVerifiedProofs.end())
+            return false;
+        entry = it->second;
+    }
+    int nMinRingSize, nMaxRingSize;
+    GetRingSizeBounds(pindex->nHeight, nMinRingSize, nMaxRingSize);
+    if (entry.nMinRingSize != nMinRingSize || entry.nMaxRingSize != nMaxRingSize || !pindex->pprev)
+        return false;
+    BlockMap::const_iterator mi = mapBlockIndex.find(entry.hashTip);
+    return mi != mapBlockIndex.end() && pindex->pprev->GetAncestor(mi->second->nHeight) == mi->second;
+}
+
+bool CheckTransactionProofs(const CTransaction& tx, CValidationState& state, CBlockIndex* pindexTip, secp256k1_scratch_space2* scratch, bool* pfVerified)
+{
+    if (pfVerified)
+        *pfVerified = tx.IsCoinStake() || tx.IsCoinBase() || tx.IsCoinAudit();
+    if (tx.IsCoinStake() || tx.IsCoinBase() || tx.IsCoinAudit())
+        return true;
+    int banscore;
+    if (masternodeSync.IsBlockchainSynced()) {
+        banscore = 100;
+    } else {
+        banscore = 1;
+    }
+    // Proofs are not verified during initial download. That is decided once,
+    // so nothing gets recorded as verified that was not.
+    const bool fInitialDownload = IsInitialBlockDownload();
+    int nMinRingSize, nMaxRingSize;
+    GetRingSizeBounds(pindexTip->nHeight, nMinRingSize, nMaxRingSize);
+    if (fInitialDownload ? tx.nTxFee < 0 : !VerifyRingSignature(tx, pindexTip, nMinRingSize, nMaxRingSize)) {
+        return state.DoS(banscore, error("AcceptToMemoryPool() : Ring Signature check for transaction %s failed", tx.GetHash().ToString()),
+            REJECT_INVALID, "bad-ring-signature");
+    }
+    if (fInitialDownload)
+        return true;
+    if (!VerifyBulletProof(tx, scratch))
+        return state.DoS(100, error("AcceptToMemoryPool() : Bulletproof check for transaction %s failed", tx.GetHash().ToString()),
+            REJECT_INVALID, "bad-bulletproof");
+    AddRelayVerifiedProofs(tx, pindexTip, nMinRingSize, nMaxRingSize);
+    if (pfVerified)
+        *pfVerified = true;
+    return true;
+}
+
+bool GetMissingRingMembers(const CTransaction& tx, std::set<uint256>& setMissing)
+{
+    AssertLockHeld(cs_main);
+    setMissing.clear();
+    if (tx.IsCoinBase())
+        return false;
+    std::set<uint256> setFound;
+    for (const CTxIn& txin : tx.vin) {
+        std::vector<COutPoint> ring = txin.decoys;
+        ring.push_back(txin.prevout);
+        for (const COutPoint& member : ring) {
+            if (setFound.count(member.hash) || setMissing.count(member.hash))
+                continue;
+            // Ring members have to be confirmed, one that is only in the mempool is still missing
+            bool fFound;
+            if (fTxIndex) {
+                CDiskTxPos postx;
+                fFound = pblocktree->ReadTxIndex(member.hash, postx);
+            } else {
+                fFound = pcoinsTip->HaveCoins(member.hash);
+            }
+            if (fFound)
+                setFound.insert(member.hash);
+            else
+                setMissing.insert(member.hash);
+        }
+    }
+    return !setMissing.empty();
+}
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees, bool fProofsVerified)
 {
     AssertLockHeld(cs_main);
     if (pfMissingInputs)
@@ -1628,24 +2044,17 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                 return false;
             }
 
-            int banscore;
-            if (!tx.IsCoinStake() && !tx.IsCoinBase() && !tx.IsCoinAudit()) {
-                if (!tx.IsCoinAudit()) {
-                    if (masternodeSync.IsBlockchainSynced()) {
-                        banscore = 100;
-                    } else {
-                        banscore = 1;
-                    }
-                    if (!VerifyRingSignatureWithTxFee(tx, chainActive.Tip())) {
-                        return state.DoS(banscore, error("AcceptToMemoryPool() : Ring Signature check for transaction %s failed", tx.GetHash().ToString()),
-                            REJECT_INVALID, "bad-ring-signature");
-                    }
-                    if (!VerifyBulletProofAggregate(tx))
-                        return state.DoS(100, error("AcceptToMemoryPool() : Bulletproof check for transaction %s failed", tx.GetHash().ToString()),
-                            REJECT_INVALID, "bad-bulletproof");
-                }
+            // A ring member we have not seen in a block yet makes this an orphan, not an invalid ring signature
+            std::set<uint256> setMissing;
+            if (!fProofsVerified && GetMissingRingMembers(tx, setMissing)) {
+                if (pfMissingInputs)
+                    *pfMissingInputs = true;
+                return false;
             }
 
+            if (!fProofsVerified && !CheckTransactionProofs(tx, state, chainActive.Tip()))
+                return false;
+
             // Check key images not duplicated with what in db
             for (const CTxIn& txin : tx.vin) {
                 const CKeyImage& keyImage = txin.keyImage;
@@ -1659,6 +2068,12 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                                                 tx.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-inputs");
                 }
             }
+            // Check key images not already spent by another pool transaction
+            uint256 hashConflict;
+            if (pool.HasKeyImageConflict(tx, &hashConflict)) {
+                return state.Invalid(error("AcceptToMemoryPool : key image of %s already spent by mempool tx %s", hash.GetHex(), hashConflict.GetHex()),
+                    REJECT_DUPLICATE, "txn-mempool-conflict");
+            }
             // check for invalid/fraudulent decoys
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 if (tx.IsCoinBase()) continue;
@@ -1667,12 +2082,15 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
                 alldecoys.push_back(tx.vin[i].prevout);
                 for (size_t j = 0; j < alldecoys.size(); j++) {
-                    CTransaction prev;
-                    uint256 bh;
-                    if (!GetTransaction(alldecoys[j].hash, prev, bh, true)) {
-                        return false;
+                    // Verifying the ring signature already resolved every ring member on the active chain
+                    if (!fProofsVerified) {
+                        CTransaction prev;
+                        uint256 bh;
+                        if (!GetTransaction(alldecoys[j].hash, prev, bh, true)) {
+                            return false;
+                        }
+                        if (mapBlockIndex.count(bh) < 1) return false;
                     }
-                    if (mapBlockIndex.count(bh) < 1) return false;
                     if (!ValidOutPoint(alldecoys[j])) {
                         return state.DoS(100, error("%s : tried to spend invalid decoy %s in tx %s", __func__, alldecoys[j].ToString(),
                                                     tx.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-inputs");
@@ -1719,6 +2137,12 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                 return state.DoS(0, error("AcceptToMemoryPool : not enough fees %s, %d < %d", hash.ToString(), nFees, txMinFee),
                     REJECT_INSUFFICIENTFEE, "insufficient fee");
 
+            // Once the pool has been full, require the rolling minimum fee of the evicted transactions
+            CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+            if (fLimitFree && mempoolRejectFee > 0 && nFees < mempoolRejectFee)
+                return state.DoS(0, error("AcceptToMemoryPool : mempool min fee not met %s, %d < %d", hash.ToString(), nFees, mempoolRejectFee),
+                    REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+
             // Continuously rate-limit free (really, very-low-fee) transactions
             // This mitigates 'penny-flooding' -- sending thousands of free transactions just to
             // be annoying or make others' transactions take longer to confirm.
@@ -1773,6 +2197,12 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
         }
         // Store transaction in memory
         pool.addUnchecked(hash, entry);
+
+        // Evict the lowest fee rate transactions if the pool went over its budget
+        pool.TrimToSize(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+        if (!pool.exists(hash))
+            return state.DoS(0, error("AcceptToMemoryPool : mempool full, %s evicted", hash.ToString()),
+                REJECT_INSUFFICIENTFEE, "mempool full");
     }
     SyncWithWallets(tx, nullptr);
 
@@ -1827,12 +2257,11 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
     // ----------- swiftTX transaction scanning -----------
 
     for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
-            }
+        std::map<CKeyImage, uint256>::const_iterator it = mapLockedKeyImages.find(in.keyImage);
+        if (it != mapLockedKeyImages.end() && it->second != tx.GetHash()) {
+            return state.DoS(0,
+                error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
+                REJECT_INVALID, "tx-lock-conflict");
         }
     }
 
@@ -2006,6 +2435,36 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
     return true;
 }
 
+/** Read the transaction stored at postx, and the hash of the block it is stored in */
+static bool ReadTransactionFromDisk(const CDiskTxPos& postx, CTransaction& txOut, uint256& hashBlock)
+{
+    CBlockHeader header;
+    CBlockFileSpan span;
+    if (blockFileMap.MapBlock(postx, span)) {
+        try {
+            CSpanReader reader = span.GetReader(SER_DISK, CLIENT_VERSION);
+            reader >> header;
+            reader.ignore(postx.nTxOffset);
+            reader >> txOut;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    } else {
+        CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull())
+            return error("%s: OpenBlockFile failed", __func__);
+        try {
+            file >> header;
+            fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+            file >> txOut;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    hashBlock = header.GetHash();
+    return true;
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock, bool fAllowSlow, CBlockIndex* blockIndex)
 {
@@ -2021,18 +2480,8 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
         if (fTxIndex) {
             CDiskTxPos postx;
             if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
-                CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (const std::exception& e) {
-                    return error("%s : Deserialize or I/O error - %s", __func__, e.what());
-                }
-                hashBlock = header.GetHash();
+                if (!ReadTransactionFromDisk(postx, txOut, hashBlock))
+                    return false;
                 if (txOut.GetHash() != hash)
                     return error("%s : txid mismatch, %s, %s", __func__, txOut.GetHash().GetHex(), hash.GetHex());
                 return true;
@@ -2056,6 +2505,20 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
     }
 
     if (pindexSlow) {
+        // Blocks connected with their transaction offsets recorded only need the one transaction read
+        CBlockTxOffsets offsets;
+        unsigned int nTxOffset;
+        if ((pindexSlow->nStatus & BLOCK_HAVE_DATA) && pblocktree->ReadBlockTxOffsets(pindexSlow->GetBlockHash(), offsets)) {
+            if (!offsets.Find(hash, nTxOffset))
+                return false;
+            uint256 hashBlockRead;
+            if (ReadTransactionFromDisk(CDiskTxPos(pindexSlow->GetBlockPos(), nTxOffset), txOut, hashBlockRead) &&
+                hashBlockRead == pindexSlow->GetBlockHash() && txOut.GetHash() == hash) {
+                hashBlock = hashBlockRead;
+                return true;
+            }
+        }
+
         CBlock block;
         if (ReadBlockFromDisk(block, pindexSlow)) {
             for (const CTransaction& tx : block.vtx) {
@@ -2102,16 +2565,26 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk : OpenBlockFile failed");
+    // Read block, straight from the mapped block file when possible
+    CBlockFileSpan span;
+    if (blockFileMap.MapBlock(pos, span)) {
+        try {
+            CSpanReader reader = span.GetReader(SER_DISK, CLIENT_VERSION);
+            reader >> block;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk : OpenBlockFile failed");
 
-    // Read block
-    try {
-        filein >> block;
-    } catch (const std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        try {
+            filein >> block;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Check the header
@@ -2123,6 +2596,29 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<char>& vData, const CDiskBlockPos& pos)
+{
+    // The serialized size is stored right before the block
+    if (pos.nPos < 4)
+        return error("%s : invalid block position", __func__);
+    CDiskBlockPos sizePos(pos.nFile, pos.nPos - 4);
+    CAutoFile filein(OpenBlockFile(sizePos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
+
+    try {
+        unsigned int nSize = 0;
+        filein >> nSize;
+        if (nSize == 0 || nSize > MAX_SIZE)
+            return error("%s : invalid block size %u", __func__, nSize);
+        vData.resize(nSize);
+        filein.read(vData.data(), nSize);
+    } catch (const std::exception& e) {
+        return error("%s : I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
 {
     if (!ReadBlockFromDisk(block, pindex->GetBlockPos()))
@@ -2463,35 +2959,40 @@ int64_t GetMasternodePayment(int nHeight, int64_t blockValue, int nMasternodeCou
     return ret;
 }
 
-void SetRingSize(int nHeight)
+void GetRingSizeBounds(int nHeight, int& nMinRingSize, int& nMaxRingSize)
 {
-    if (chainActive.Tip() == NULL) return;
-    if (nHeight == 0) {
-        nHeight = chainActive.Tip()->nHeight;
-    }
-
     // Original Ring Sizes on all networks
-    MIN_RING_SIZE = 11;
-    MAX_RING_SIZE = 15;
+    nMinRingSize = 11;
+    nMaxRingSize = 15;
 
     // Ring Sizes after the Hard Fork block
     // Add any Ring Size increases as the last check
     if (nHeight >= Params().HardForkRingSize()) {
-        MIN_RING_SIZE = 27;
-        MAX_RING_SIZE = 32;
+        nMinRingSize = 27;
+        nMaxRingSize = 32;
     }
 
     // Testnet Hard Forks were different
     if (Params().NetworkID() == CBaseChainParams::TESTNET) {
         if (nHeight >= Params().HardForkRingSize()) {
-            MIN_RING_SIZE = 25;
-            MAX_RING_SIZE = 30;
+            nMinRingSize = 25;
+            nMaxRingSize = 30;
         }
         if (nHeight >= Params().HardForkRingSize2()) {
-            MIN_RING_SIZE = 30;
-            MAX_RING_SIZE = 32;
+            nMinRingSize = 30;
+            nMaxRingSize = 32;
         }
     }
+}
+
+void SetRingSize(int nHeight)
+{
+    if (chainActive.Tip() == NULL) return;
+    if (nHeight == 0) {
+        nHeight = chainActive.Tip()->nHeight;
+    }
+
+    GetRingSizeBounds(nHeight, MIN_RING_SIZE, MAX_RING_SIZE);
 
     LogPrint(BCLog::SELECTCOINS, "%s: height %d: min ring size %d, max ring size: %d\n", __func__, nHeight, MIN_RING_SIZE, MAX_RING_SIZE);
     return;
@@ -2999,6 +3500,53 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
+/** Decode the coinstake inputs and outputs of a block to compute its effect on the money supply */
+static CBlockSupplyDelta ComputeBlockSupplyDelta(const CBlock& block)
+{
+    CBlockSupplyDelta delta;
+    for (const CTransaction& tx : block.vtx) {
+        delta.nFees += tx.nTxFee;
+        if (tx.IsCoinStake()) {
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                CAmount nTemp; // = txPrev.vout[prevout.n].nValue;
+                uint256 hashBlock;
+                CTransaction txPrev;
+                GetTransaction(tx.vin[i].prevout.hash, txPrev, hashBlock, true);
+                const CTxOut& out = txPrev.vout[tx.vin[i].prevout.n];
+                if (out.nValue > 0) {
+                    //UTXO created by coinbase/coin audit/coinstake transaction
+                    if (!VerifyZeroBlindCommitment(out)) {
+                        throw std::runtime_error("Commitment for coinstake not correct: failed to verify blind commitment");
+                    }
+                    delta.nValueIn += out.nValue;
+                } else {
+                    uint256 val = out.maskValue.amount;
+                    uint256 mask = out.maskValue.mask;
+                    CKey decodedMask;
+                    CPubKey sharedSec;
+                    sharedSec.Set(tx.vin[i].encryptionKey.begin(), tx.vin[i].encryptionKey.begin() + 33);
+                    ECDHInfo::Decode(mask.begin(), val.begin(), sharedSec, decodedMask, nTemp);
+                    //Verify commitment
+                    std::vector<unsigned char> commitment;
+                    CWallet::CreateCommitment(decodedMask.begin(), nTemp, commitment);
+                    if (commitment != out.commitment) {
+                        throw std::runtime_error("Commitment for coinstake not correct");
+                    }
+                    delta.nValueIn += nTemp;
+                }
+            }
+        }
+
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            if (i == 0 && tx.IsCoinStake())
+                continue;
+
+            delta.nValueOut += tx.vout[i].nValue;
+        }
+    }
+    return delta;
+}
+
 bool RecalculatePRCYSupply(int nHeightStart)
 {
     const int chainHeight = chainActive.Height();
@@ -3015,55 +3563,19 @@ bool RecalculatePRCYSupply(int nHeightStart)
             int percent = std::max(1, std::min(99, (int)((double)((pindex->nHeight - nHeightStart) * 100) / (chainHeight - nHeightStart))));
             uiInterface.ShowProgress(_("Recalculating PRCY supply..."), percent);
         }
-        CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
 
-        CAmount nValueIn = 0;
-        CAmount nValueOut = 0;
-        CAmount nFees = 0;
-        for (const CTransaction& tx : block.vtx) {
-            nFees += tx.nTxFee;
-            if (tx.IsCoinStake()) {
-                for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                    CAmount nTemp; // = txPrev.vout[prevout.n].nValue;
-                    uint256 hashBlock;
-                    CTransaction txPrev;
-                    GetTransaction(tx.vin[i].prevout.hash, txPrev, hashBlock, true);
-                    const CTxOut& out = txPrev.vout[tx.vin[i].prevout.n];
-                    if (out.nValue > 0) {
-                        //UTXO created by coinbase/coin audit/coinstake transaction
-                        if (!VerifyZeroBlindCommitment(out)) {
-                            throw std::runtime_error("Commitment for coinstake not correct: failed to verify blind commitment");
-                        }
-                        nValueIn += out.nValue;
-                    } else {
-                        uint256 val = out.maskValue.amount;
-                        uint256 mask = out.maskValue.mask;
-                        CKey decodedMask;
-                        CPubKey sharedSec;
-                        sharedSec.Set(tx.vin[i].encryptionKey.begin(), tx.vin[i].encryptionKey.begin() + 33);
-                        ECDHInfo::Decode(mask.begin(), val.begin(), sharedSec, decodedMask, nTemp);
-                        //Verify commitment
-                        std::vector<unsigned char> commitment;
-                        CWallet::CreateCommitment(decodedMask.begin(), nTemp, commitment);
-                        if (commitment != out.commitment) {
-                            throw std::runtime_error("Commitment for coinstake not correct");
-                        }
-                        nValueIn += nTemp;
-                    }
-                }
-            }
-
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                if (i == 0 && tx.IsCoinStake())
-                    continue;
-
-                nValueOut += tx.vout[i].nValue;
-            }
+        // Blocks connected since the supply delta index was introduced carry their own record,
+        // only older blocks need to be read back and have their coinstake decoded.
+        CBlockSupplyDelta delta;
+        if (!pblocktree->ReadSupplyDelta(pindex->GetBlockHash(), delta)) {
+            CBlock block;
+            assert(ReadBlockFromDisk(block, pindex));
+            delta = ComputeBlockSupplyDelta(block);
+            assert(pblocktree->WriteSupplyDelta(pindex->GetBlockHash(), delta));
         }
 
         // Rewrite money supply
-        pindex->nMoneySupply = nSupplyPrev + nValueOut - nValueIn - nFees;
+        pindex->nMoneySupply = nSupplyPrev + delta.GetDelta();
         nSupplyPrev = pindex->nMoneySupply;
 
         assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
@@ -3176,8 +3688,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     vPos.reserve(block.vtx.size());
     CBlockUndo blockundo;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
+    CBlockTxOffsets txOffsets;
+    txOffsets.vTxHash.reserve(block.vtx.size());
+    txOffsets.vTxOffset.reserve(block.vtx.size());
     CAmount nValueOut = 0;
     CAmount nValueIn = 0;
+    std::vector<std::string> vKeyImages;
     unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction& tx = block.vtx[i];
@@ -3189,7 +3705,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
         if (!block.IsPoABlockByVersion() && !tx.IsCoinBase()) {
             if (!tx.IsCoinStake()) {
-                if (!tx.IsCoinAudit()) {
+                // Transactions relayed to us before the block had their proofs verified already
+                if (!tx.IsCoinAudit() && !HaveRelayVerifiedProofs(tx, pindex)) {
                     if (!VerifyRingSignatureWithTxFee(tx, pindex))
                         return state.DoS(100, error("ConnectBlock() : Ring Signature check for transaction %s failed", tx.GetHash().ToString()),
                             REJECT_INVALID, "bad-ring-signature");
@@ -3209,7 +3726,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                     return state.Invalid(error("ConnectBlock() : key image already spent"),
                         REJECT_DUPLICATE, "bad-txns-inputs-spent");
                 }
-                pblocktree->WriteKeyImage(keyImage.GetHex(), bh);
+                vKeyImages.push_back(kh);
                 if (pwalletMain != NULL && !pwalletMain->IsLocked()) {
                     if (pwalletMain->GetDebit(in, ISMINE_ALL)) {
                         pwalletMain->keyImagesSpends[keyImage.GetHex()] = true;
@@ -3269,6 +3786,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), nHeight);
 
         vPos.emplace_back(tx.GetHash(), pos);
+        txOffsets.vTxHash.push_back(vPos.back().first);
+        txOffsets.vTxOffset.push_back(pos.nTxOffset);
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
 
@@ -3340,6 +3859,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             // update nUndoPos in block index
             pindex->nUndoPos = diskPosBlock.nPos;
             pindex->nStatus |= BLOCK_HAVE_UNDO;
+
+            // the layout of the block on disk never changes, so its transaction offsets only need writing once
+            if (!pblocktree->WriteBlockTxOffsets(pindex->GetBlockHash(), txOffsets))
+                return AbortNode(state, "Failed to write transaction offsets");
         }
 
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
@@ -3350,6 +3873,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
+    if (!pblocktree->WriteKeyImages(vKeyImages, pindex->GetBlockHash()))
+        return AbortNode(state, "Failed to write key images");
+
+    if (!pblocktree->WriteSupplyDelta(pindex->GetBlockHash(), CBlockSupplyDelta(nValueIn, nValueOut, nFees)))
+        return AbortNode(state, "Failed to write supply delta");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -3530,6 +4059,18 @@ bool static DisconnectTip(CValidationState& state)
             return error("DisconnectTip() : DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         assert(view.Flush());
     }
+    // Key images and the supply record only describe blocks on the active chain; they are rewritten if the block is reconnected.
+    std::vector<std::string> vKeyImages;
+    for (const CTransaction& tx : block.vtx) {
+        if (tx.IsCoinBase())
+            continue;
+        for (const CTxIn& in : tx.vin)
+            vKeyImages.push_back(in.keyImage.GetHex());
+    }
+    if (!pblocktree->EraseKeyImages(vKeyImages, pindexDelete->GetBlockHash()))
+        return AbortNode(state, "Failed to erase key images");
+    if (!pblocktree->EraseSupplyDelta(pindexDelete->GetBlockHash()))
+        return AbortNode(state, "Failed to erase supply delta");
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
@@ -3634,6 +4175,8 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     for (const CTransaction& tx : pblock->vtx) {
         SyncWithWallets(tx, pblock);
     }
+    // ... and about ring members orphan transactions were waiting for
+    OrphanRingMembersConfirmed(*pblock);
 
     int64_t nTime6 = GetTimeMicros();
     nTimePostConnect += nTime6 - nTime5;
@@ -3695,15 +4238,8 @@ void RemoveInvalidTransactionsFromMempool()
     std::vector<CTransaction> tobeRemoveds;
     for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = mempool.mapTx.begin(); it != mempool.mapTx.end(); ++it) {
         const CTransaction& tx = it->second.GetTx();
+        // Transactions whose key images got confirmed are evicted by removeForBlock
         for(size_t i = 0; i < tx.vin.size(); i++) {
-            std::string kiHex = tx.vin[i].keyImage.GetHex();
-            int confirm = 0;
-            if (CheckKeyImageSpendInMainChain(kiHex, confirm)) {
-                if (confirm > Params().MaxReorganizationDepth()) {
-                    tobeRemoveds.push_back(tx);
-                    break;
-                }
-            }
             bool needsBreak = false;
             std::vector<COutPoint> decoys = tx.vin[i].decoys;
             decoys.push_back(tx.vin[i].prevout);
@@ -3961,6 +4497,11 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock, bool fAlreadyChe
     } while (pindexMostWork != chainActive.Tip());
     CheckBlockIndex();
 
+    {
+        LOCK(cs_main);
+        ProcessReadyOrphans();
+    }
+
     // Write changes periodically to disk, after relay.
     if (!FlushStateToDisk(state, FLUSH_STATE_PERIODIC)) {
         return false;
@@ -5275,6 +5816,11 @@ bool static LoadBlockIndexDB(std::string& strError)
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
 
+    // Check whether key images of disconnected blocks have always been removed
+    bool fKeyImageUndo = false;
+    pblocktree->ReadFlag("keyimageundo", fKeyImageUndo);
+    fLegacyKeyImageIndex = !fKeyImageUndo;
+
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
 
@@ -5393,13 +5939,19 @@ void UnloadBlockIndex()
     mempool.clear();
     mapOrphanTransactions.clear();
     mapOrphanTransactionsByPrev.clear();
+    setOrphanTransactionsReady.clear();
     nSyncStarted = 0;
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
+    blockFileMap.Clear();
+    sendCache.Clear();
     nLastBlockFile = 0;
     nBlockSequenceId = 1;
     mapBlockSource.clear();
     mapBlocksInFlight.clear();
+    mapBlocksAwaitingParent.clear();
+    mapBlocksAwaitingParentByPrev.clear();
+    nBlocksAwaitingParentSize = 0;
     nQueuedValidatedHeaders = 0;
     nPreferredDownload = 0;
     setDirtyBlockIndex.clear();
@@ -5436,6 +5988,8 @@ bool InitBlockIndex()
     // Use the provided setting for -txindex in the new database
     fTxIndex = GetBoolArg("-txindex", true);
     pblocktree->WriteFlag("txindex", fTxIndex);
+    fLegacyKeyImageIndex = false;
+    pblocktree->WriteFlag("keyimageundo", true);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -5800,51 +6354,102 @@ bool static AlreadyHave(const CInv& inv)
     case MSG_TXLOCK_REQUEST:
         return mapTxLockReq.count(inv.hash) ||
                mapTxLockReqRejected.count(inv.hash);
-    case MSG_TXLOCK_VOTE:
+    case MSG_TXLOCK_VOTE: {
+        LOCK(cs_mapTxLockVote);
         return mapTxLockVote.count(inv.hash);
+    }
     case MSG_MASTERNODE_WINNER:
         if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
             masternodeSync.AddedMasternodeWinner(inv.hash);
             return true;
         }
         return false;
-    case MSG_BUDGET_VOTE:
-        if (budget.mapSeenMasternodeBudgetVotes.count(inv.hash)) {
+    case MSG_BUDGET_VOTE: {
+        CBudgetVote vote;
+        if (budget.GetProposalVote(inv.hash, vote)) {
             masternodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
+    }
     case MSG_BUDGET_PROPOSAL:
         if (budget.mapSeenMasternodeBudgetProposals.count(inv.hash)) {
             masternodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
-    case MSG_BUDGET_FINALIZED_VOTE:
-        if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
+    case MSG_BUDGET_FINALIZED_VOTE: {
+        CFinalizedBudgetVote vote;
+        if (budget.GetFinalizedBudgetVote(inv.hash, vote)) {
             masternodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
+    }
     case MSG_BUDGET_FINALIZED:
         if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
             masternodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
-    case MSG_MASTERNODE_ANNOUNCE:
+    case MSG_MASTERNODE_ANNOUNCE: {
+        LOCK(mnodeman.cs_seen);
         if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
             masternodeSync.AddedMasternodeList(inv.hash);
             return true;
         }
         return false;
-    case MSG_MASTERNODE_PING:
+    }
+    case MSG_MASTERNODE_PING: {
+        LOCK(mnodeman.cs_seen);
         return mnodeman.mapSeenMasternodePing.count(inv.hash);
     }
+    }
     // Don't know what it is, just say we already got one
     return true;
 }
 
+/** The cmpctblock message for pindex, built once and shared through the send cache */
+static CSerializeDataRef GetCompactBlockMessage(const CBlockIndex* pindex)
+{
+    const CInv inv(MSG_CMPCT_BLOCK, pindex->GetBlockHash());
+    CSerializeDataRef msg = sendCache.Get(inv);
+    if (msg)
+        return msg;
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return CSerializeDataRef();
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << CBlockHeaderAndShortTxIDs(block);
+    msg = CreateSerializedMessage(NetMsgType::CMPCTBLOCK, ss);
+    sendCache.Put(inv, msg);
+    return msg;
+}
+
+/** The block message for pindex, straight from the block file bytes and shared through the send cache */
+static CSerializeDataRef GetBlockMessage(const CBlockIndex* pindex)
+{
+    const CInv inv(MSG_BLOCK, pindex->GetBlockHash());
+    CSerializeDataRef msg = sendCache.Get(inv);
+    if (msg)
+        return msg;
+
+    // Blocks are stored in their network serialization
+    const CDiskBlockPos pos = pindex->GetBlockPos();
+    CBlockFileSpan span;
+    if (blockFileMap.MapBlock(pos, span)) {
+        msg = CreateSerializedMessage(NetMsgType::BLOCK, span.pdata, span.nSize);
+    } else {
+        std::vector<char> vData;
+        if (!ReadRawBlockFromDisk(vData, pos))
+            return CSerializeDataRef();
+        msg = CreateSerializedMessage(NetMsgType::BLOCK, vData.data(), vData.size());
+    }
+    sendCache.Put(inv, msg);
+    return msg;
+}
+
 void static ProcessGetData(CNode* pfrom)
 {
     AssertLockNotHeld(cs_main);
@@ -5864,7 +6469,7 @@ void static ProcessGetData(CNode* pfrom)
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
                 bool send = false;
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end()) {
@@ -5889,14 +6494,22 @@ void static ProcessGetData(CNode* pfrom)
                 }
                 // Don't send not-validated blocks
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage(NetMsgType::BLOCK, block);
-                    else // MSG_FILTERED_BLOCK)
+                    if (inv.type == MSG_CMPCT_BLOCK && (*mi).second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+                        CSerializeDataRef msg = GetCompactBlockMessage((*mi).second);
+                        if (!msg)
+                            assert(!"cannot load block from disk");
+                        pfrom->PushSerializedMessage(msg);
+                    } else if (inv.type == MSG_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
+                        // Send block from disk, serialized once for all peers
+                        CSerializeDataRef msg = GetBlockMessage((*mi).second);
+                        if (!msg)
+                            assert(!"cannot load block from disk");
+                        pfrom->PushSerializedMessage(msg);
+                    } else // MSG_FILTERED_BLOCK)
                     {
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second))
+                            assert(!"cannot load block from disk");
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
                             CMerkleBlock merkleBlock(block, *pfrom->pfilter);
@@ -5927,13 +6540,28 @@ void static ProcessGetData(CNode* pfrom)
                     }
                 }
             } else if (inv.IsKnownType()) {
-                // Send stream from relay memory
                 bool pushed = false;
-                {
+                // Transactions requested by many peers are serialized once
+                if (inv.type == MSG_TX && mempool.exists(inv.hash)) {
+                    CSerializeDataRef msg = sendCache.Get(inv);
+                    if (msg) {
+                        pfrom->PushSerializedMessage(msg);
+                        pushed = true;
+                    }
+                }
+
+                // Send stream from relay memory
+                if (!pushed) {
                     LOCK(cs_mapRelay);
                     std::map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
                     if (mi != mapRelay.end()) {
-                        pfrom->PushMessage(inv.GetCommand(), (*mi).second);
+                        if (inv.type == MSG_TX) {
+                            CSerializeDataRef msg = CreateSerializedMessage(NetMsgType::TX, (*mi).second);
+                            sendCache.Put(inv, msg);
+                            pfrom->PushSerializedMessage(msg);
+                        } else {
+                            pfrom->PushMessage(inv.GetCommand(), (*mi).second);
+                        }
                         pushed = true;
                     }
                 }
@@ -5944,11 +6572,14 @@ void static ProcessGetData(CNode* pfrom)
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
                         ss << tx;
-                        pfrom->PushMessage(NetMsgType::TX, ss);
+                        CSerializeDataRef msg = CreateSerializedMessage(NetMsgType::TX, ss);
+                        sendCache.Put(inv, msg);
+                        pfrom->PushSerializedMessage(msg);
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
+                    LOCK(cs_mapTxLockVote);
                     if (mapTxLockVote.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
@@ -5976,10 +6607,11 @@ void static ProcessGetData(CNode* pfrom)
                     }
                 }
                 if (!pushed && inv.type == MSG_BUDGET_VOTE) {
-                    if (budget.mapSeenMasternodeBudgetVotes.count(inv.hash)) {
+                    CBudgetVote vote;
+                    if (budget.GetProposalVote(inv.hash, vote)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenMasternodeBudgetVotes[inv.hash];
+                        ss << vote;
                         pfrom->PushMessage(NetMsgType::BUDGETVOTE, ss);
                         pushed = true;
                     }
@@ -5996,10 +6628,11 @@ void static ProcessGetData(CNode* pfrom)
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_FINALIZED_VOTE) {
-                    if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
+                    CFinalizedBudgetVote vote;
+                    if (budget.GetFinalizedBudgetVote(inv.hash, vote)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgetVotes[inv.hash];
+                        ss << vote;
                         pfrom->PushMessage(NetMsgType::FINALBUDGETVOTE, ss);
                         pushed = true;
                     }
@@ -6016,6 +6649,7 @@ void static ProcessGetData(CNode* pfrom)
                 }
 
                 if (!pushed && inv.type == MSG_MASTERNODE_ANNOUNCE) {
+                    LOCK(mnodeman.cs_seen);
                     if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
@@ -6026,6 +6660,7 @@ void static ProcessGetData(CNode* pfrom)
                 }
 
                 if (!pushed && inv.type == MSG_MASTERNODE_PING) {
+                    LOCK(mnodeman.cs_seen);
                     if (mnodeman.mapSeenMasternodePing.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
@@ -6062,6 +6697,322 @@ void static ProcessGetData(CNode* pfrom)
     }
 }
 
+/**
+ * Accept a transaction relayed by nodeid into the mempool and relay it, or
+ * keep it as an orphan if ring members are missing. pfrom is NULL if the peer
+ * disconnected while the transaction was being verified. A state that is
+ * already invalid (failed proof verification) is only reported.
+ */
+static void ProcessRelayedTransaction(NodeId nodeid, CNode* pfrom, const CTransaction& tx, CValidationState& state, bool fProofsVerified)
+{
+    AssertLockHeld(cs_main);
+
+    bool fMissingInputs = false;
+
+    if (state.IsValid() && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, false, fProofsVerified)) {
+        mempool.check(pcoinsTip);
+        RelayTransaction(tx);
+
+        LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d %s : accepted %s (poolsz %u)\n",
+            nodeid, pfrom ? pfrom->cleanSubVer : "",
+            tx.GetHash().ToString(),
+            mempool.mapTx.size());
+
+        // Ring members have to be confirmed, so orphans waiting on this
+        // transaction are only revisited once it is in a block
+    } else if (fMissingInputs) {
+        AddOrphanTx(tx, nodeid);
+
+        // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+        unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx",
+                                                                           DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+        unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+        if (nEvicted > 0)
+            LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
+    } else {
+        // AcceptToMemoryPool() returned false, possibly because the tx is
+        // already in the mempool; if the tx isn't in the mempool that
+        // means it was rejected and we shouldn't ask for it again.
+        if (!mempool.exists(tx.GetHash())) {
+            assert(recentRejects);
+            recentRejects->insert(tx.GetHash());
+        }
+        if (pfrom && pfrom->fWhitelisted) {
+            // Always relay transactions received from whitelisted peers, even
+            // if they were rejected from the mempool, allowing the node to
+            // function as a gateway for nodes hidden behind it.
+            //
+            // FIXME: This includes invalid transactions, which means a
+            // whitelisted peer could get us banned! We may want to change
+            // that.
+            RelayTransaction(tx);
+        }
+    }
+
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS)) {
+        LogPrint(BCLog::MEMPOOL, "%s from peer=%d %s was not accepted into the memory pool: %s\n",
+            tx.GetHash().ToString(),
+            nodeid, pfrom ? pfrom->cleanSubVer : "",
+            state.GetRejectReason());
+        if (pfrom)
+            pfrom->PushMessage(NetMsgType::REJECT, std::string(NetMsgType::TX), state.GetRejectCode(),
+                state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), tx.GetHash());
+        if (nDoS > 0)
+            Misbehaving(nodeid, nDoS);
+    }
+}
+
+/** Verify a relayed transaction on a verification thread and hand it to ProcessRelayedTransaction */
+static void ValidateRelayedTransaction(NodeId nodeid, const CTransaction& tx, secp256k1_scratch_space2* scratch)
+{
+    CBlockIndex* pindexVerified;
+    bool fMissingRingMembers;
+    {
+        LOCK(cs_main);
+        pindexVerified = chainActive.Tip();
+        std::set<uint256> setMissing;
+        fMissingRingMembers = GetMissingRingMembers(tx, setMissing);
+    }
+
+    CValidationState state;
+    bool fProofsVerified = false;
+    try {
+        if (!CheckTransaction(tx, true, state))
+            state.DoS(100, error("%s : CheckTransaction failed", __func__), REJECT_INVALID, "bad-tx");
+        else if (!fMissingRingMembers)
+            CheckTransactionProofs(tx, state, pindexVerified, scratch, &fProofsVerified);
+    } catch (const std::exception& e) {
+        state.DoS(100, error("%s : verification of %s failed: %s", __func__, tx.GetHash().ToString(), e.what()), REJECT_INVALID, "bad-tx");
+    }
+
+    LOCK(cs_main);
+    CNode* pfrom = NULL;
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            if (pnode->GetId() == nodeid) {
+                pfrom = pnode->AddRef();
+                break;
+            }
+        }
+    }
+    // The proofs have to be checked again if the tip moved on in the meantime,
+    // a transaction with missing ring members ends up in the orphan pool
+    ProcessRelayedTransaction(nodeid, pfrom, tx, state, state.IsValid() && fProofsVerified && chainActive.Tip() == pindexVerified);
+    if (pfrom)
+        pfrom->Release();
+}
+
+/** Validate the orphan transactions whose missing ring members all got confirmed */
+static void ProcessReadyOrphans()
+{
+    AssertLockHeld(cs_main);
+    while (!setOrphanTransactionsReady.empty()) {
+        const uint256 hash = *setOrphanTransactionsReady.begin();
+        std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
+        if (it == mapOrphanTransactions.end()) {
+            setOrphanTransactionsReady.erase(hash);
+            continue;
+        }
+        const CTransaction tx = it->second.tx;
+        const NodeId fromPeer = it->second.fromPeer;
+        EraseOrphanTx(hash);
+
+        LogPrint(BCLog::MEMPOOL, "ring members of orphan tx %s confirmed\n", hash.ToString());
+        if (nTxVerifyThreads > 0) {
+            if (!txValidationQueue.Push(fromPeer, tx))
+                LogPrint(BCLog::MEMPOOL, "orphan tx %s from peer=%d not queued for verification\n", hash.ToString(), fromPeer);
+            continue;
+        }
+        CValidationState state;
+        ProcessRelayedTransaction(fromPeer, NULL, tx, state, false);
+    }
+}
+
+void ThreadTxVerify()
+{
+    util::ThreadRename("prcycoin-txverify");
+    // The shared bulletproof scratch space is not thread safe, every verification thread gets its own
+    secp256k1_scratch_space2* scratch = secp256k1_scratch_space_create(GetContext(), 1024 * 1024 * 512);
+    try {
+        txValidationQueue.Thread([scratch](NodeId nodeid, const CTransaction& tx) {
+            try {
+                ValidateRelayedTransaction(nodeid, tx, scratch);
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, "ThreadTxVerify()");
+            }
+        });
+    } catch (...) {
+        secp256k1_scratch_space_destroy(scratch);
+        throw;
+    }
+}
+
+/** Maximum number of SwiftTX lock requests remembered with verified proofs */
+static const size_t MAX_VERIFIED_PROOFS = 1000;
+
+static Mutex cs_verifiedProofs;
+//! SwiftTX lock requests whose proofs were verified ahead, with the tip they were verified on
+static std::map<uint256, uint256> mapVerifiedProofs;
+
+bool HaveVerifiedProofs(const uint256& txid)
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs_verifiedProofs);
+    std::map<uint256, uint256>::iterator it = mapVerifiedProofs.find(txid);
+    if (it == mapVerifiedProofs.end())
+        return false;
+    const bool fVerified = it->second == chainActive.Tip()->GetBlockHash();
+    mapVerifiedProofs.erase(it);
+    return fVerified;
+}
+
+/**
+ * Check the signatures of a masternode, budget or SwiftTX message before the
+ * message handler gets to it. Nothing is changed but the recovered signature
+ * cache and the SwiftTX proofs cache; the handler still runs every check.
+ */
+static void VerifyMessageAhead(const CQueuedMessage& msg, secp256k1_scratch_space2* scratch)
+{
+    CDataStream vRecv(msg.vRecv);
+    const std::string& strCommand = msg.strCommand;
+    if (strCommand == NetMsgType::MNBROADCAST) {
+        CMasternodeBroadcast mnb;
+        vRecv >> mnb;
+        CMessageSigner::PrecomputeMessage(mnb.sig, mnb.GetStrMessage());
+        CMessageSigner::PrecomputeMessage(mnb.lastPing.vchSig, mnb.lastPing.GetStrMessage());
+    } else if (strCommand == NetMsgType::MNPING) {
+        CMasternodePing mnp;
+        vRecv >> mnp;
+        CMessageSigner::PrecomputeMessage(mnp.vchSig, mnp.GetStrMessage());
+    } else if (strCommand == NetMsgType::MNWINNER) {
+        CMasternodePaymentWinner winner;
+        vRecv >> winner;
+        CMessageSigner::PrecomputeMessage(winner.vchSig, winner.GetStrMessage());
+    } else if (strCommand == NetMsgType::BUDGETVOTE) {
+        CBudgetVote vote;
+        vRecv >> vote;
+        CMessageSigner::PrecomputeMessage(vote.vchSig, vote.GetStrMessage());
+    } else if (strCommand == NetMsgType::FINALBUDGETVOTE) {
+        CFinalizedBudgetVote vote;
+        vRecv >> vote;
+        CMessageSigner::PrecomputeMessage(vote.vchSig, vote.GetStrMessage());
+    } else if (strCommand == NetMsgType::IXLOCKVOTE) {
+        CConsensusVote vote;
+        vRecv >> vote;
+        CMessageSigner::PrecomputeMessage(vote.vchMasterNodeSignature, vote.GetStrMessage());
+    } else if (strCommand == NetMsgType::IX) {
+        CTransaction tx;
+        vRecv >> tx;
+        CBlockIndex* pindexVerified;
+        std::set<uint256> setMissing;
+        {
+            LOCK(cs_main);
+            if (mempool.exists(tx.GetHash()) || GetMissingRingMembers(tx, setMissing))
+                return;
+            pindexVerified = chainActive.Tip();
+        }
+        CValidationState state;
+        bool fProofsVerified = false;
+        if (!CheckTransaction(tx, true, state) || !CheckTransactionProofs(tx, state, pindexVerified, scratch, &fProofsVerified) || !fProofsVerified)
+            return;
+        LOCK(cs_verifiedProofs);
+        if (mapVerifiedProofs.size() >= MAX_VERIFIED_PROOFS) {
+            // Evict a random entry
+            std::map<uint256, uint256>::iterator it = mapVerifiedProofs.lower_bound(GetRandHash());
+            if (it == mapVerifiedProofs.end())
+                it = mapVerifiedProofs.begin();
+            mapVerifiedProofs.erase(it);
+        }
+        mapVerifiedProofs[tx.GetHash()] = pindexVerified->GetBlockHash();
+    }
+}
+
+/**
+ * Whether a masternode broadcast, ping or lock vote was processed already, so
+ * there is no signature to check ahead. Called by the message handler before
+ * queueing a message, while the masternodes thread expires the same seen maps,
+ * so they are read under their own locks.
+ */
+static bool AlreadyHaveMessage(const std::string& strCommand, const CDataStream& vRecvIn)
+{
+    try {
+        CDataStream vRecv(vRecvIn);
+        if (strCommand == NetMsgType::MNBROADCAST) {
+            CMasternodeBroadcast mnb;
+            vRecv >> mnb;
+            LOCK(mnodeman.cs_seen);
+            return mnodeman.mapSeenMasternodeBroadcast.count(mnb.GetHash());
+        } else if (strCommand == NetMsgType::MNPING) {
+            CMasternodePing mnp;
+            vRecv >> mnp;
+            LOCK(mnodeman.cs_seen);
+            return mnodeman.mapSeenMasternodePing.count(mnp.GetHash());
+        } else if (strCommand == NetMsgType::IXLOCKVOTE) {
+            CConsensusVote vote;
+            vRecv >> vote;
+            LOCK(cs_mapTxLockVote);
+            return mapTxLockVote.count(vote.GetHash());
+        }
+    } catch (const std::ios_base::failure&) {
+        // Malformed messages are reported by the message handler
+        return true;
+    }
+    return false;
+}
+
+void ThreadMessageVerify()
+{
+    util::ThreadRename("prcycoin-msgverify");
+    // The shared bulletproof scratch space is not thread safe, every verification thread gets its own
+    secp256k1_scratch_space2* scratch = secp256k1_scratch_space_create(GetContext(), 1024 * 1024 * 512);
+    try {
+        msgVerifyQueue.Thread([scratch](NodeId nodeid, const CQueuedMessage& msg) {
+            try {
+                VerifyMessageAhead(msg, scratch);
+            } catch (const std::ios_base::failure&) {
+                // Malformed messages are reported by the message handler
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, "ThreadMessageVerify()");
+            }
+        });
+    } catch (...) {
+        secp256k1_scratch_space_destroy(scratch);
+        throw;
+    }
+}
+
+/** Process a block received in full or reconstructed from a compact block. Must be called without cs_main. */
+static void ProcessBlockFromPeer(CNode* pfrom, CBlock& block, const std::string& strCommand)
+{
+    const CInv inv(MSG_BLOCK, block.GetHash());
+    pfrom->AddInventoryKnown(inv);
+    CValidationState state;
+    if (!mapBlockIndex.count(inv.hash)) {
+        ProcessNewBlock(state, pfrom, &block);
+        int nDoS;
+        if (state.IsInvalid(nDoS)) {
+            pfrom->PushMessage(NetMsgType::REJECT, strCommand, state.GetRejectCode(),
+                state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+            if (nDoS > 0) {
+                TRY_LOCK(cs_main, lockMain);
+                if (lockMain) Misbehaving(pfrom->GetId(), nDoS);
+            }
+        }
+        //disconnect this node if its old protocol version
+        pfrom->DisconnectOldProtocol(ActiveProtocol(), strCommand);
+        pfrom->DisconnectOldVersion(pfrom->strSubVer, chainActive.Height(), strCommand);
+        if (mapBlockIndex.count(inv.hash)) {
+            LogPrint(BCLog::NET, "Added block %s to block index map\n", inv.hash.GetHex());
+        }
+        ProcessBlocksAwaitingParent(inv.hash);
+    } else {
+        LogPrint(BCLog::NET, "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__,
+            inv.hash.GetHex());
+    }
+}
+
 bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d, chainheight=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id, chainActive.Height());
@@ -6293,13 +7244,20 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             bool fAlreadyHave = AlreadyHave(inv);
             LogPrint(BCLog::NET, "got inv: %s  %s peer=%d, inv.type=%d, mapBlocksInFlight.count(inv.hash)=%d\n", inv.ToString(), fAlreadyHave ? "have" : "new", pfrom->id, inv.type, mapBlocksInFlight.count(inv.hash));
 
-            if (!fAlreadyHave && pfrom)
+            // During initial download blocks are fetched through the peer's download window instead
+            const bool fQueueBlock = inv.type == MSG_BLOCK && !fAlreadyHave && !fImporting && !fReindex && IsInitialBlockDownload();
+            if (fQueueBlock) {
+                CNodeState* state = State(pfrom->GetId());
+                if (state->vBlocksToDownload.size() < BLOCK_DOWNLOAD_WINDOW)
+                    state->vBlocksToDownload.push_back(inv.hash);
+            } else if (!fAlreadyHave && pfrom)
                 pfrom->AskFor(inv, IsInitialBlockDownload()); // peershares: immediate retry during initial download
             if (inv.type == MSG_BLOCK) {
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
-                if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
-                    // Add this to the list of blocks to request
-                    vToFetch.push_back(inv);
+                if (!fAlreadyHave && !fQueueBlock && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash) && !mapCompactBlocksInFlight.count(inv.hash)) {
+                    // Add this to the list of blocks to request. New blocks are asked for compact;
+                    // the full block AskFor scheduled above is the fallback if that doesn't work out.
+                    vToFetch.push_back(MarkCompactBlockAsInFlight(pfrom, inv.hash) ? CInv(MSG_CMPCT_BLOCK, inv.hash) : inv);
                     LogPrint(BCLog::NET, "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(),
                         pfrom->id);
                 }
@@ -6420,124 +7378,29 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         }
         pfrom->PushMessage(NetMsgType::HEADERS, vHeaders);
     } else if (strCommand == NetMsgType::TX) {
-        std::vector<uint256> vWorkQueue;
-        std::vector<uint256> vEraseQueue;
         CTransaction tx;
-
-        //masternode signed transaction
-        bool ignoreFees = false;
-        CTxIn vin;
-        std::vector<unsigned char> vchSig;
-
         vRecv >> tx;
 
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        LOCK(cs_main);
-
-        bool fMissingInputs = false;
-        CValidationState state;
-
-        mapAlreadyAskedFor.erase(inv);
+        {
+            LOCK(cs_main);
+            mapAlreadyAskedFor.erase(inv);
 
-        if (AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees)) {
-            mempool.check(pcoinsTip);
-            RelayTransaction(tx);
-            vWorkQueue.push_back(inv.hash);
-
-            LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d %s : accepted %s (poolsz %u)\n",
-                pfrom->id, pfrom->cleanSubVer,
-                tx.GetHash().ToString(),
-                mempool.mapTx.size());
-
-            // Recursively process any orphan transactions that depended on this one
-            std::set<NodeId> setMisbehaving;
-            for (unsigned int i = 0; i < vWorkQueue.size(); i++) {
-                std::map<uint256, std::set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
-                if (itByPrev == mapOrphanTransactionsByPrev.end())
-                    continue;
-                for(std::set<uint256>::iterator mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end();
-                     ++mi) {
-                    const uint256& orphanHash = *mi;
-                    const CTransaction& orphanTx = mapOrphanTransactions[orphanHash].tx;
-                    NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-
-                    if (setMisbehaving.count(fromPeer))
-                        continue;
-                    if (AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2)) {
-                        LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
-                        RelayTransaction(orphanTx);
-                        vWorkQueue.push_back(orphanHash);
-                        vEraseQueue.push_back(orphanHash);
-                    } else if (!fMissingInputs2) {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos) && nDos > 0) {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos);
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s\n", orphanHash.ToString());
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
-                        assert(recentRejects);
-                        recentRejects->insert(orphanHash);
-                    }
-                    mempool.check(pcoinsTip);
-                }
+            if (!nTxVerifyThreads) {
+                CValidationState state;
+                ProcessRelayedTransaction(pfrom->GetId(), pfrom, tx, state, false);
+                return true;
             }
-
-            for (uint256 hash : vEraseQueue)
-                EraseOrphanTx(hash);
-        } else if (fMissingInputs) {
-            AddOrphanTx(tx, pfrom->GetId());
-
-            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-            unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx",
-                                                                               DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-            if (nEvicted > 0)
-                LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
-        } else {
-            // AcceptToMemoryPool() returned false, possibly because the tx is
-            // already in the mempool; if the tx isn't in the mempool that
-            // means it was rejected and we shouldn't ask for it again.
-            if (!mempool.exists(tx.GetHash())) {
-                assert(recentRejects);
-                recentRejects->insert(tx.GetHash());
-            }
-            if (pfrom->fWhitelisted) {
-                // Always relay transactions received from whitelisted peers, even
-                // if they were rejected from the mempool, allowing the node to
-                // function as a gateway for nodes hidden behind it.
-                //
-                // FIXME: This includes invalid transactions, which means a
-                // whitelisted peer could get us banned! We may want to change
-                // that.
-                RelayTransaction(tx);
-            }
-        }
-
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS)) {
-            LogPrint(BCLog::MEMPOOL, "%s from peer=%d %s was not accepted into the memory pool: %s\n",
-                tx.GetHash().ToString(),
-                pfrom->id, pfrom->cleanSubVer,
-                state.GetRejectReason());
-            pfrom->PushMessage(NetMsgType::REJECT, strCommand, state.GetRejectCode(),
-                state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-            if (nDoS > 0)
-                Misbehaving(pfrom->GetId(), nDoS);
+            if (mempool.exists(tx.GetHash()))
+                return true;
         }
+
+        // Verify the proofs off the message handler thread
+        if (!txValidationQueue.Push(pfrom->GetId(), tx))
+            LogPrint(BCLog::MEMPOOL, "not queueing tx %s from peer=%d for verification, already queued or peer queue full\n",
+                tx.GetHash().ToString(), pfrom->id);
     } else if (strCommand == NetMsgType::HEADERS && Params().HeadersFirstSyncingActive() && !fImporting &&
                !fReindex) // Ignore headers received while importing
     {
@@ -6599,14 +7462,27 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         CheckBlockIndex();
     } else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
+        const unsigned int nBlockSize = vRecv.size();
         CBlock block;
         vRecv >> block;
         uint256 hashBlock = block.GetHash();
         CInv inv(MSG_BLOCK, hashBlock);
         LogPrint(BCLog::NET, "received block %s peer=%d, height=%d\n", inv.hash.ToString(), pfrom->id, chainActive.Height());
 
+        bool fAwaitingParent = false;
+        {
+            LOCK(cs_main);
+            UpdateBlockDownloadStats(pfrom->GetId(), hashBlock, nBlockSize, nTimeReceived);
+            // Blocks downloaded in parallel can overtake their parent
+            if (!mapBlockIndex.count(block.hashPrevBlock))
+                fAwaitingParent = AddBlockAwaitingParent(pfrom->GetId(), block, nBlockSize);
+        }
+
         //sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
-        if (!mapBlockIndex.count(block.hashPrevBlock)) {
+        if (fAwaitingParent) {
+            LogPrint(BCLog::NET, "block %s from peer=%d arrived before its parent %s\n", hashBlock.ToString(), pfrom->id,
+                block.hashPrevBlock.ToString());
+        } else if (!mapBlockIndex.count(block.hashPrevBlock)) {
             if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
                 //we already asked for this block, so lets work backwards and ask for the previous block
                 pfrom->PushMessage(NetMsgType::GETBLOCKS, chainActive.GetLocator(), block.hashPrevBlock);
@@ -6617,30 +7493,124 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                 pfrom->vBlockRequested.push_back(hashBlock);
             }
         } else {
-            pfrom->AddInventoryKnown(inv);
-            CValidationState state;
-            if (!mapBlockIndex.count(block.GetHash())) {
-                ProcessNewBlock(state, pfrom, &block);
-                int nDoS;
-                if (state.IsInvalid(nDoS)) {
-                    pfrom->PushMessage(NetMsgType::REJECT, strCommand, state.GetRejectCode(),
-                        state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-                    if (nDoS > 0) {
-                        TRY_LOCK(cs_main, lockMain);
-                        if (lockMain) Misbehaving(pfrom->GetId(), nDoS);
-                    }
-                }
-                //disconnect this node if its old protocol version
-                pfrom->DisconnectOldProtocol(ActiveProtocol(), strCommand);
-                pfrom->DisconnectOldVersion(pfrom->strSubVer, chainActive.Height(), strCommand);
-                if (mapBlockIndex.count(block.GetHash())) {
-                    LogPrint(BCLog::NET, "Added block %s to block index map\n", block.GetHash().GetHex());
+            ProcessBlockFromPeer(pfrom, block, strCommand);
+        }
+    } else if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+        const uint256 hashBlock = cmpctblock.header.GetHash();
+        LogPrint(BCLog::NET, "received cmpctblock %s peer=%d\n", hashBlock.ToString(), pfrom->id);
+
+        CBlock block;
+        bool fReconstructed = false;
+        {
+            LOCK(cs_main);
+            std::map<uint256, CCompactBlockInFlight>::iterator it = mapCompactBlocksInFlight.find(hashBlock);
+            if (it == mapCompactBlocksInFlight.end() || it->second.nodeid != pfrom->GetId() || it->second.partialBlock) {
+                LogPrint(BCLog::NET, "Peer %d sent us an unrequested cmpctblock %s\n", pfrom->id, hashBlock.ToString());
+                return true;
+            }
+            if (mapBlockIndex.count(hashBlock)) {
+                mapCompactBlocksInFlight.erase(it);
+                return true;
+            }
+            // The full block path knows how to deal with blocks that don't connect
+            if (!mapBlockIndex.count(cmpctblock.header.hashPrevBlock)) {
+                RequestFullBlock(pfrom, hashBlock);
+                return true;
+            }
+
+            std::unique_ptr<PartiallyDownloadedBlock> partialBlock(new PartiallyDownloadedBlock(&mempool));
+            ReadStatus status = partialBlock->InitData(cmpctblock);
+            if (status == READ_STATUS_INVALID) {
+                mapCompactBlocksInFlight.erase(it);
+                Misbehaving(pfrom->GetId(), 100);
+                return error("%s : peer %d sent us an invalid cmpctblock %s", __func__, pfrom->id, hashBlock.ToString());
+            } else if (status == READ_STATUS_FAILED) {
+                RequestFullBlock(pfrom, hashBlock);
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            req.blockhash = hashBlock;
+            for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                if (!partialBlock->IsTxAvailable(i))
+                    req.indexes.push_back(i);
+            }
+            if (req.indexes.empty()) {
+                status = partialBlock->FillBlock(block, std::vector<CTransaction>());
+                if (status == READ_STATUS_OK) {
+                    mapCompactBlocksInFlight.erase(it);
+                    fReconstructed = true;
+                } else {
+                    RequestFullBlock(pfrom, hashBlock);
                 }
             } else {
-                LogPrint(BCLog::NET, "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__,
-                    block.GetHash().GetHex());
+                // Round trip for the transactions we don't have
+                it->second.partialBlock = std::move(partialBlock);
+                pfrom->PushMessage(NetMsgType::GETBLOCKTXN, req);
+            }
+        }
+        if (fReconstructed)
+            ProcessBlockFromPeer(pfrom, block, strCommand);
+    } else if (strCommand == NetMsgType::BLOCKTXN && !fImporting && !fReindex) {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        bool fReconstructed = false;
+        {
+            LOCK(cs_main);
+            std::map<uint256, CCompactBlockInFlight>::iterator it = mapCompactBlocksInFlight.find(resp.blockhash);
+            if (it == mapCompactBlocksInFlight.end() || it->second.nodeid != pfrom->GetId() || !it->second.partialBlock) {
+                LogPrint(BCLog::NET, "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
+                return true;
+            }
+
+            ReadStatus status = it->second.partialBlock->FillBlock(block, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                mapCompactBlocksInFlight.erase(it);
+                Misbehaving(pfrom->GetId(), 100);
+                return error("%s : peer %d sent us invalid compact block transactions", __func__, pfrom->id);
+            } else if (status == READ_STATUS_FAILED) {
+                // Might have collided, fall back to getdata now :(
+                RequestFullBlock(pfrom, resp.blockhash);
+            } else {
+                mapCompactBlocksInFlight.erase(it);
+                fReconstructed = true;
             }
         }
+        if (fReconstructed)
+            ProcessBlockFromPeer(pfrom, block, strCommand);
+    } else if (strCommand == NetMsgType::GETBLOCKTXN) {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+        BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+        if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return true;
+        }
+        // Only recent blocks are announced compact, anything older is fetched in full
+        if (it->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+            LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block > %i deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+            return true;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, it->second))
+            assert(!"cannot load block from disk");
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("%s : peer %d sent us a getblocktxn with out-of-bounds tx indices", __func__, pfrom->id);
+            }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        pfrom->PushMessage(NetMsgType::BLOCKTXN, resp);
     }
 
 
@@ -6857,6 +7827,21 @@ bool ProcessMessages(CNode* pfrom)
     //
     bool fOk = true;
 
+    // Hand complete masternode, budget and SwiftTX messages to the verification
+    // threads, so their signatures are checked by the time they get processed
+    if (nMsgVerifyThreads > 0 && !fLiteMode) {
+        for (CNetMessage& msg : pfrom->vRecvMsg) {
+            if (!msg.complete())
+                break;
+            if (msg.fVerifyQueued)
+                continue;
+            msg.fVerifyQueued = true;
+            const std::string strCommand = msg.hdr.GetCommand();
+            if (CMessageVerifyQueue::IsVerifiedAhead(strCommand) && !AlreadyHaveMessage(strCommand, msg.vRecv))
+                msgVerifyQueue.Push(pfrom->GetId(), CQueuedMessage(strCommand, msg.vRecv));
+        }
+    }
+
     if (!pfrom->vRecvGetData.empty())
         ProcessGetData(pfrom);
 
@@ -7129,10 +8114,11 @@ bool SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fDisconnect && !pto->fClient && fFetch && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        state.nBlockWindow = GetBlockDownloadWindow(state, pto->nMinPingUsecTime);
+        if (!pto->fDisconnect && !pto->fClient && fFetch && state.nBlocksInFlight < state.nBlockWindow) {
             std::vector<CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload,
+            FindNextBlocksToDownload(pto->GetId(), state.nBlockWindow - state.nBlocksInFlight, vToDownload,
                 staller);
             for (CBlockIndex* pindex : vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
@@ -7147,6 +8133,16 @@ bool SendMessages(CNode* pto)
                 }
             }
         }
+        // Blocks announced during initial download, in the order the peer announced them
+        while (!pto->fDisconnect && state.nBlocksInFlight < state.nBlockWindow && !state.vBlocksToDownload.empty()) {
+            const CInv inv(MSG_BLOCK, state.vBlocksToDownload.front());
+            state.vBlocksToDownload.pop_front();
+            if (AlreadyHave(inv) || mapBlocksInFlight.count(inv.hash) || mapBlocksAwaitingParent.count(inv.hash))
+                continue;
+            vGetData.push_back(inv);
+            MarkBlockAsInFlight(pto->GetId(), inv.hash);
+            LogPrint(BCLog::NET, "Requesting block %s peer=%d (window %d)\n", inv.hash.ToString(), pto->id, state.nBlockWindow);
+        }
 
         //
         // Message: getdata (non-blocks)
@@ -7246,5 +8242,6 @@ public:
         // orphan transactions
         mapOrphanTransactions.clear();
         mapOrphanTransactionsByPrev.clear();
+        setOrphanTransactionsReady.clear();
     }
 };
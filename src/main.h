@@ -71,6 +71,12 @@ static const unsigned int MAX_STANDARD_TX_SIZE = 150000;
 static const unsigned int MAX_P2SH_SIGOPS = 15;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Maximum serialized size of a transaction kept in the orphan pool */
+static const unsigned int MAX_ORPHAN_TX_SIZE = 50000;
+/** Time in seconds an orphan transaction waits for its missing ring members */
+static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
+/** Minimum time in seconds between two sweeps for expired orphan transactions */
+static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -83,8 +89,15 @@ static const int COINBASE_MATURITY = 100;
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer. */
-static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Number of blocks that can be requested at any given time from a single peer before its bandwidth is known. */
+static const int DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Bounds of the per-peer block download window, which follows the peer's measured bandwidth and round trip time. */
+static const int MIN_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 128;
+/** Maximum total size of downloaded blocks kept while waiting for their parent to arrive. */
+static const unsigned int MAX_BLOCKS_AWAITING_PARENT_SIZE = 32 * 1024 * 1024;
+/** Time in seconds after which a downloaded block whose parent never arrived is dropped. */
+static const int64_t BLOCK_AWAITING_PARENT_EXPIRE_TIME = 10 * 60;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -95,6 +108,13 @@ static const unsigned int MAX_HEADERS_RESULTS = 2000;
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
  *  harder). We'll probably want to make this a per-peer adaptive value at some point. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
+/** Maximum depth of blocks we serve as compact blocks or answer getblocktxn for. Older blocks are sent in full. */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Number of compact blocks that can be waiting for a reply or for missing transactions at any given time. */
+static const unsigned int MAX_CMPCTBLOCKS_IN_FLIGHT = 8;
+/** Time in seconds after which an unanswered compact block request no longer holds back other requests. */
+static const int64_t CMPCTBLOCK_TIMEOUT = 60;
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
@@ -146,6 +166,8 @@ extern uint256 g_best_block;
 extern std::atomic<bool> fImporting;
 extern std::atomic<bool> fReindex;
 extern int nScriptCheckThreads;
+extern int nTxVerifyThreads;
+extern int nMsgVerifyThreads;
 extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
@@ -185,7 +207,7 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals);
 secp256k1_context2* GetContext();
 secp256k1_scratch_space2* GetScratch();
 secp256k1_bulletproof_generators* GetGenerator();
-bool VerifyBulletProofAggregate(const CTransaction& tx);
+bool VerifyBulletProofAggregate(const CTransaction& tx, secp256k1_scratch_space2* scratch = NULL);
 bool VerifyRingSignatureWithTxFee(const CTransaction& tx, CBlockIndex* pindex);
 void DestroyContext();
 bool VerifyDerivedAddress(const CTxOut& out, std::string stealth);
@@ -232,6 +254,12 @@ bool VerifyZeroBlindCommitment(const CTxOut& out);
 bool SendMessages(CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the relayed transaction verification thread */
+void ThreadTxVerify();
+/** Run an instance of the masternode, budget and SwiftTX message verification thread */
+void ThreadMessageVerify();
+/** Whether the proofs of SwiftTX lock request txid were verified ahead on top of the current tip. Requires cs_main. */
+bool HaveVerifiedProofs(const uint256& txid);
 
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
@@ -252,6 +280,9 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock = NULL, bool fAlr
 CAmount GetBlockValue(int nHeight);
 
 void RemoveInvalidTransactionsFromMempool();
+/** Ring size rules for a transaction in the block at nHeight */
+void GetRingSizeBounds(int nHeight, int& nMinRingSize, int& nMaxRingSize);
+/** Set MIN_RING_SIZE/MAX_RING_SIZE for the wallet, to the rules at nHeight or at the tip for 0 */
 void SetRingSize(int nHeight);
 
 /** Create a new block index entry for a given block hash */
@@ -268,7 +299,17 @@ CAmount GetValueIn(CCoinsViewCache view, const CTransaction& tx);
 
 
 /** (try to) add transaction to memory pool **/
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool ignoreFees = false);
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool ignoreFees = false, bool fProofsVerified = false);
+
+/**
+ * Verify the ring signature and bulletproof of a transaction spending on top of pindexTip. Does not require cs_main.
+ * pfVerified is set to whether the proofs were actually checked, or tx has none. They are not checked
+ * during initial download.
+ */
+bool CheckTransactionProofs(const CTransaction& tx, CValidationState& state, CBlockIndex* pindexTip, secp256k1_scratch_space2* scratch = NULL, bool* pfVerified = NULL);
+
+/** Collect the txids of the ring members of tx that are not in a block yet. Returns true if any is missing. */
+bool GetMissingRingMembers(const CTransaction& tx, std::set<uint256>& setMissing);
 
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool isDSTX = false);
 
@@ -290,6 +331,8 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nBlockWindow;
+    int64_t nBlockBytesPerSec;
 };
 
 CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowFree);
@@ -383,6 +426,8 @@ public:
 bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+/** Read the serialized block stored at pos without deserializing it */
+bool ReadRawBlockFromDisk(std::vector<char>& vData, const CDiskBlockPos& pos);
 
 
 /** Functions for validating blocks and updating the block tree */
@@ -251,25 +251,28 @@ CBudgetDB::CBudgetDB()
     strMagicMessage = "MasternodeBudget";
 }
 
-bool CBudgetDB::Write(const CBudgetManager& objToSave)
+void CBudgetDB::Serialize(const CBudgetManager& objToSave, CDataStream& ssObj)
 {
     LOCK(objToSave.cs);
 
-    int64_t nStart = GetTimeMillis();
-
     // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
     ssObj << strMagicMessage;                   // masternode cache file specific magic message
     ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
     ssObj << objToSave;
     uint256 hash = Hash(ssObj.begin(), ssObj.end());
     ssObj << hash;
+}
+
+bool CBudgetDB::Write(const CDataStream& ssObj)
+{
+    int64_t nStart = GetTimeMillis();
 
-    // open output file, and associate with CAutoFile
-    FILE* file = fsbridge::fopen(pathDB, "wb");
+    // open temp output file, and associate with CAutoFile
+    fs::path pathTmp = pathDB.string() + ".new";
+    FILE* file = fsbridge::fopen(pathTmp, "wb");
     CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
+        return error("%s : Failed to open file %s", __func__, pathTmp.string());
 
     // Write and commit header, data
     try {
@@ -277,8 +280,13 @@ bool CBudgetDB::Write(const CBudgetManager& objToSave)
     } catch (const std::exception& e) {
         return error("%s : Serialize or I/O error - %s", __func__, e.what());
     }
+    FileCommit(fileout.Get());
     fileout.fclose();
 
+    // replace existing budget.dat, so a crash leaves either the old or the new one
+    if (!RenameOver(pathTmp, pathDB))
+        return error("%s : Rename-into-place failed", __func__);
+
     LogPrint(BCLog::MNBUDGET,"Written info to budget.dat  %dms\n", GetTimeMillis() - nStart);
 
     return true;
@@ -391,13 +399,21 @@ void DumpBudgets()
         }
     }
     LogPrint(BCLog::MNBUDGET,"Writting info to budget.dat...\n");
-    budgetdb.Write(budget);
+    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+    {
+        LOCK(budget.cs);
+        budgetdb.Serialize(budget, ssObj);
+        budget.journal.Rotate();
+    }
+    if (budgetdb.Write(ssObj))
+        budget.journal.RemoveRotated();
 
     LogPrint(BCLog::MNBUDGET,"Budget dump finished  %dms\n", GetTimeMillis() - nStart);
 }
 
 bool CBudgetManager::AddFinalizedBudget(CFinalizedBudget& finalizedBudget)
 {
+    LOCK(cs);
     std::string strError = "";
     if (!finalizedBudget.IsValid(strError)) return false;
 
@@ -406,6 +422,7 @@ bool CBudgetManager::AddFinalizedBudget(CFinalizedBudget& finalizedBudget)
     }
 
     mapFinalizedBudgets.insert(std::make_pair(finalizedBudget.GetHash(), finalizedBudget));
+    journal.Append(JOURNAL_FINALIZED_BUDGET, CFinalizedBudgetBroadcast(finalizedBudget));
     return true;
 }
 
@@ -424,9 +441,42 @@ bool CBudgetManager::AddProposal(CBudgetProposal& budgetProposal)
 
     mapProposals.insert(std::make_pair(budgetProposal.GetHash(), budgetProposal));
     LogPrint(BCLog::MNBUDGET,"CBudgetManager::AddProposal - proposal %s added\n", budgetProposal.GetName ().c_str ());
+    journal.Append(JOURNAL_PROPOSAL, CBudgetProposalBroadcast(budgetProposal));
     return true;
 }
 
+void CBudgetManager::OpenJournal()
+{
+    journal.Open([this](unsigned char nType, CDataStream& ssRecord) {
+        // like budget.dat, fill the seen maps as well so getdata for replayed items can be answered
+        LOCK(cs);
+        std::string strError;
+        if (nType == JOURNAL_PROPOSAL) {
+            CBudgetProposalBroadcast budgetProposalBroadcast;
+            ssRecord >> budgetProposalBroadcast;
+            mapSeenMasternodeBudgetProposals.insert(std::make_pair(budgetProposalBroadcast.GetHash(), budgetProposalBroadcast));
+            CBudgetProposal budgetProposal(budgetProposalBroadcast);
+            AddProposal(budgetProposal);
+        } else if (nType == JOURNAL_FINALIZED_BUDGET) {
+            CFinalizedBudgetBroadcast finalizedBudgetBroadcast;
+            ssRecord >> finalizedBudgetBroadcast;
+            mapSeenFinalizedBudgets.insert(std::make_pair(finalizedBudgetBroadcast.GetHash(), finalizedBudgetBroadcast));
+            CFinalizedBudget finalizedBudget(finalizedBudgetBroadcast);
+            AddFinalizedBudget(finalizedBudget);
+        } else if (nType == JOURNAL_PROPOSAL_VOTE) {
+            CBudgetVote vote;
+            ssRecord >> vote;
+            mapSeenMasternodeBudgetVotes.insert(std::make_pair(vote.GetHash(), vote));
+            UpdateProposal(vote, NULL, strError);
+        } else if (nType == JOURNAL_FINALIZED_BUDGET_VOTE) {
+            CFinalizedBudgetVote vote;
+            ssRecord >> vote;
+            mapSeenFinalizedBudgetVotes.insert(std::make_pair(vote.GetHash(), vote));
+            UpdateFinalizedBudget(vote, NULL, strError);
+        }
+    });
+}
+
 void CBudgetManager::CheckAndRemove()
 {
     LogPrint(BCLog::MNBUDGET, "CBudgetManager::CheckAndRemove\n");
@@ -621,7 +671,8 @@ bool CBudgetManager::IsTransactionValid(const CTransaction& txNew, int nBlockHei
     LOCK(cs);
 
     int nHighestCount = 0;
-    int nFivePercent = mnodeman.CountEnabled(ActiveProtocol()) / 20;
+    const int nEnabled = mnodeman.CountEnabled(ActiveProtocol());
+    int nFivePercent = nEnabled / 20;
     std::vector<CFinalizedBudget*> ret;
 
     // ------- Grab The Highest Count
@@ -651,7 +702,7 @@ bool CBudgetManager::IsTransactionValid(const CTransaction& txNew, int nBlockHei
     while (it != mapFinalizedBudgets.end()) {
         CFinalizedBudget* pfinalizedBudget = &((*it).second);
 
-        if (pfinalizedBudget->GetVoteCount() > nHighestCount - mnodeman.CountEnabled(ActiveProtocol()) / 10) {
+        if (pfinalizedBudget->GetVoteCount() > nHighestCount - nEnabled / 10) {
             if (nBlockHeight >= pfinalizedBudget->GetBlockStart() && nBlockHeight <= pfinalizedBudget->GetBlockEnd()) {
                 if (pfinalizedBudget->IsTransactionValid(txNew, nBlockHeight)) {
                     return true;
@@ -726,6 +777,7 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
     int nBlockStart = pindexPrev->nHeight - pindexPrev->nHeight % GetBudgetPaymentCycleBlocks() + GetBudgetPaymentCycleBlocks();
     int nBlockEnd = nBlockStart + GetBudgetPaymentCycleBlocks() - 1;
     CAmount nTotalBudget = GetTotalBudget(nBlockStart);
+    const int nTenthEnabled = mnodeman.CountEnabled(ActiveProtocol()) / 10;
 
 
     std::vector<std::pair<CBudgetProposal*, int> >::iterator it2 = vBudgetPorposalsSort.begin();
@@ -736,12 +788,12 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
         //prop start/end should be inside this period
         if (pbudgetProposal->fValid && pbudgetProposal->nBlockStart <= nBlockStart &&
             pbudgetProposal->nBlockEnd >= nBlockEnd &&
-            pbudgetProposal->GetYeas() - pbudgetProposal->GetNays() > mnodeman.CountEnabled(ActiveProtocol()) / 10 &&
+            pbudgetProposal->GetYeas() - pbudgetProposal->GetNays() > nTenthEnabled &&
             pbudgetProposal->IsEstablished()) {
 
             LogPrint(BCLog::MNBUDGET,"CBudgetManager::GetBudget() -   Check 1 passed: valid=%d | %ld <= %ld | %ld >= %ld | Yeas=%d Nays=%d Count=%d | established=%d\n",
                       pbudgetProposal->fValid, pbudgetProposal->nBlockStart, nBlockStart, pbudgetProposal->nBlockEnd,
-                      nBlockEnd, pbudgetProposal->GetYeas(), pbudgetProposal->GetNays(), mnodeman.CountEnabled(ActiveProtocol()) / 10,
+                      nBlockEnd, pbudgetProposal->GetYeas(), pbudgetProposal->GetNays(), nTenthEnabled,
                       pbudgetProposal->IsEstablished());
 
             if (pbudgetProposal->GetAmount() + nBudgetAllocated <= nTotalBudget) {
@@ -757,7 +809,7 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
         else {
             LogPrint(BCLog::MNBUDGET,"CBudgetManager::GetBudget() -   Check 1 failed: valid=%d | %ld <= %ld | %ld >= %ld | Yeas=%d Nays=%d Count=%d | established=%d\n",
                       pbudgetProposal->fValid, pbudgetProposal->nBlockStart, nBlockStart, pbudgetProposal->nBlockEnd,
-                      nBlockEnd, pbudgetProposal->GetYeas(), pbudgetProposal->GetNays(), mnodeman.CountEnabled(ActiveProtocol()) / 10,
+                      nBlockEnd, pbudgetProposal->GetYeas(), pbudgetProposal->GetNays(), nTenthEnabled,
                       pbudgetProposal->IsEstablished());
         }
 
@@ -1341,7 +1393,16 @@ bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string
     }
 
 
-    return mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError);
+    CBudgetProposal& budgetProposal = mapProposals[vote.nProposalHash];
+    uint256 hashVoter = vote.vin.prevout.GetHash();
+    std::map<uint256, CBudgetVote>::iterator itOld = budgetProposal.mapVotes.find(hashVoter);
+    uint256 hashOld = itOld != budgetProposal.mapVotes.end() ? itOld->second.GetHash() : uint256();
+    if (!budgetProposal.AddOrUpdateVote(vote, strError))
+        return false;
+    mapProposalVoteIndex.erase(hashOld);
+    mapProposalVoteIndex[vote.GetHash()] = std::make_pair(vote.nProposalHash, hashVoter);
+    journal.Append(JOURNAL_PROPOSAL_VOTE, vote);
+    return true;
 }
 
 bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pfrom, std::string& strError)
@@ -1367,7 +1428,73 @@ bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pf
         return false;
     }
     LogPrint(BCLog::MNBUDGET,"CBudgetManager::UpdateFinalizedBudget - Finalized Proposal %s added\n", vote.nBudgetHash.ToString());
-    return mapFinalizedBudgets[vote.nBudgetHash].AddOrUpdateVote(vote, strError);
+    CFinalizedBudget& finalizedBudget = mapFinalizedBudgets[vote.nBudgetHash];
+    uint256 hashVoter = vote.vin.prevout.GetHash();
+    std::map<uint256, CFinalizedBudgetVote>::iterator itOld = finalizedBudget.mapVotes.find(hashVoter);
+    uint256 hashOld = itOld != finalizedBudget.mapVotes.end() ? itOld->second.GetHash() : uint256();
+    if (!finalizedBudget.AddOrUpdateVote(vote, strError))
+        return false;
+    mapFinalizedBudgetVoteIndex.erase(hashOld);
+    mapFinalizedBudgetVoteIndex[vote.GetHash()] = std::make_pair(vote.nBudgetHash, hashVoter);
+    journal.Append(JOURNAL_FINALIZED_BUDGET_VOTE, vote);
+    return true;
+}
+
+bool CBudgetManager::GetProposalVote(const uint256& hash, CBudgetVote& vote)
+{
+    LOCK(cs);
+
+    CSeenCache<CBudgetVote>::iterator itSeen = mapSeenMasternodeBudgetVotes.find(hash);
+    if (itSeen != mapSeenMasternodeBudgetVotes.end()) {
+        vote = itSeen->second;
+        return true;
+    }
+
+    std::map<uint256, std::pair<uint256, uint256> >::iterator it = mapProposalVoteIndex.find(hash);
+    if (it == mapProposalVoteIndex.end()) return false;
+    std::map<uint256, CBudgetProposal>::iterator itProposal = mapProposals.find(it->second.first);
+    if (itProposal == mapProposals.end()) return false;
+    std::map<uint256, CBudgetVote>::iterator itVote = itProposal->second.mapVotes.find(it->second.second);
+    if (itVote == itProposal->second.mapVotes.end()) return false;
+
+    vote = itVote->second;
+    return true;
+}
+
+bool CBudgetManager::GetFinalizedBudgetVote(const uint256& hash, CFinalizedBudgetVote& vote)
+{
+    LOCK(cs);
+
+    CSeenCache<CFinalizedBudgetVote>::iterator itSeen = mapSeenFinalizedBudgetVotes.find(hash);
+    if (itSeen != mapSeenFinalizedBudgetVotes.end()) {
+        vote = itSeen->second;
+        return true;
+    }
+
+    std::map<uint256, std::pair<uint256, uint256> >::iterator it = mapFinalizedBudgetVoteIndex.find(hash);
+    if (it == mapFinalizedBudgetVoteIndex.end()) return false;
+    std::map<uint256, CFinalizedBudget>::iterator itBudget = mapFinalizedBudgets.find(it->second.first);
+    if (itBudget == mapFinalizedBudgets.end()) return false;
+    std::map<uint256, CFinalizedBudgetVote>::iterator itVote = itBudget->second.mapVotes.find(it->second.second);
+    if (itVote == itBudget->second.mapVotes.end()) return false;
+
+    vote = itVote->second;
+    return true;
+}
+
+void CBudgetManager::RebuildVoteIndexes()
+{
+    mapProposalVoteIndex.clear();
+    for (std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin(); it != mapProposals.end(); ++it) {
+        for (std::map<uint256, CBudgetVote>::iterator itVote = it->second.mapVotes.begin(); itVote != it->second.mapVotes.end(); ++itVote)
+            mapProposalVoteIndex[itVote->second.GetHash()] = std::make_pair(it->first, itVote->first);
+    }
+
+    mapFinalizedBudgetVoteIndex.clear();
+    for (std::map<uint256, CFinalizedBudget>::iterator it = mapFinalizedBudgets.begin(); it != mapFinalizedBudgets.end(); ++it) {
+        for (std::map<uint256, CFinalizedBudgetVote>::iterator itVote = it->second.mapVotes.begin(); itVote != it->second.mapVotes.end(); ++itVote)
+            mapFinalizedBudgetVoteIndex[itVote->second.GetHash()] = std::make_pair(it->first, itVote->first);
+    }
 }
 
 CBudgetProposal::CBudgetProposal()
@@ -1378,6 +1505,8 @@ CBudgetProposal::CBudgetProposal()
     nAmount = 0;
     nTime = 0;
     fValid = true;
+    nYeas = nNays = nAbstains = nYeasTotal = nNaysTotal = 0;
+    nCleanedListVersion = 0;
 }
 
 CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strURLIn, int nBlockStartIn, int nBlockEndIn, CScript addressIn, CAmount nAmountIn, uint256 nFeeTXHashIn)
@@ -1390,6 +1519,8 @@ CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strU
     nAmount = nAmountIn;
     nFeeTXHash = nFeeTXHashIn;
     fValid = true;
+    nYeas = nNays = nAbstains = nYeasTotal = nNaysTotal = 0;
+    nCleanedListVersion = 0;
 }
 
 CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
@@ -1404,6 +1535,12 @@ CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
     nFeeTXHash = other.nFeeTXHash;
     mapVotes = other.mapVotes;
     fValid = true;
+    nYeas = other.nYeas;
+    nNays = other.nNays;
+    nAbstains = other.nAbstains;
+    nYeasTotal = other.nYeasTotal;
+    nNaysTotal = other.nNaysTotal;
+    nCleanedListVersion = 0;
 }
 
 bool CBudgetProposal::IsValid(std::string& strError, bool fCheckCollateral)
@@ -1510,7 +1647,14 @@ bool CBudgetProposal::AddOrUpdateVote(CBudgetVote& vote, std::string& strError)
         return false;
     }
 
-    mapVotes[hash] = vote;
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.find(hash);
+    if (it != mapVotes.end()) {
+        CountVote(it->second, -1);
+        it->second = vote;
+    } else {
+        it = mapVotes.insert(std::make_pair(hash, vote)).first;
+    }
+    CountVote(it->second, 1);
     LogPrint(BCLog::MNBUDGET, "CBudgetProposal::AddOrUpdateVote - %s %s\n", strAction.c_str(), vote.GetHash().ToString().c_str());
 
     return true;
@@ -1519,69 +1663,47 @@ bool CBudgetProposal::AddOrUpdateVote(CBudgetVote& vote, std::string& strError)
 // If masternode voted for a proposal, but is now invalid -- remove the vote
 void CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
 {
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-
-    while (it != mapVotes.end()) {
-        (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
-        ++it;
-    }
-}
+    LOCK(cs);
 
-double CBudgetProposal::GetRatio()
-{
-    int yeas = 0;
-    int nays = 0;
+    // Without the signatures, a vote is only invalid when its masternode is not listed
+    const uint64_t nListVersion = mnodeman.GetListVersion();
+    if (!fSignatureCheck && nCleanedListVersion == nListVersion) return;
 
     std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES) yeas++;
-        if ((*it).second.nVote == VOTE_NO) nays++;
+        (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
         ++it;
     }
 
-    if (yeas + nays == 0) return 0.0f;
-
-    return ((double)(yeas) / (double)(yeas + nays));
+    RecountVotes();
+    nCleanedListVersion = nListVersion;
 }
 
-int CBudgetProposal::GetYeas()
+void CBudgetProposal::CountVote(const CBudgetVote& vote, int nDelta)
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    if (vote.nVote == VOTE_YES) nYeasTotal += nDelta;
+    if (vote.nVote == VOTE_NO) nNaysTotal += nDelta;
+    if (!vote.fValid) return;
+    if (vote.nVote == VOTE_YES) nYeas += nDelta;
+    if (vote.nVote == VOTE_NO) nNays += nDelta;
+    if (vote.nVote == VOTE_ABSTAIN) nAbstains += nDelta;
 }
 
-int CBudgetProposal::GetNays()
+void CBudgetProposal::RecountVotes()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_NO && (*it).second.fValid) ret++;
-        ++it;
-    }
+    LOCK(cs);
 
-    return ret;
+    nYeas = nNays = nAbstains = nYeasTotal = nNaysTotal = 0;
+    for (const std::pair<const uint256, CBudgetVote>& vote : mapVotes)
+        CountVote(vote.second, 1);
 }
 
-int CBudgetProposal::GetAbstains()
+double CBudgetProposal::GetRatio()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_ABSTAIN && (*it).second.fValid) ret++;
-        ++it;
-    }
+    if (nYeasTotal + nNaysTotal == 0) return 0.0f;
 
-    return ret;
+    return ((double)(nYeasTotal) / (double)(nYeasTotal + nNaysTotal));
 }
 
 int CBudgetProposal::GetBlockStartCycle()
@@ -1689,8 +1811,7 @@ bool CBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     CPubKey pubKeyCollateralAddress;
     CKey keyCollateralAddress;
 
-    HEX_DATA_STREAM << vin.prevout << nProposalHash << nVote << nTime;
-    std::string strMessage = HEX_STR(ser);
+    std::string strMessage = GetStrMessage();
 
     if (!CMessageSigner::SignMessage(strMessage, vchSig, keyMasternode)) {
         LogPrint(BCLog::MNBUDGET,"CBudgetVote::Sign - Error upon calling SignMessage");
@@ -1705,11 +1826,16 @@ bool CBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     return true;
 }
 
+std::string CBudgetVote::GetStrMessage() const
+{
+    HEX_DATA_STREAM << vin.prevout << nProposalHash << nVote << nTime;
+    return HEX_STR(ser);
+}
+
 bool CBudgetVote::SignatureValid(bool fSignatureCheck)
 {
     std::string strError = "";
-    HEX_DATA_STREAM << vin.prevout << nProposalHash << nVote << nTime;
-    std::string strMessage = HEX_STR(ser);
+    std::string strMessage = GetStrMessage();
 
     CMasternode* pmn = mnodeman.Find(vin);
 
@@ -1738,6 +1864,7 @@ CFinalizedBudget::CFinalizedBudget()
     nTime = 0;
     fValid = true;
     fAutoChecked = false;
+    nCleanedListVersion = 0;
 }
 
 CFinalizedBudget::CFinalizedBudget(const CFinalizedBudget& other)
@@ -1750,6 +1877,7 @@ CFinalizedBudget::CFinalizedBudget(const CFinalizedBudget& other)
     nTime = other.nTime;
     fValid = true;
     fAutoChecked = false;
+    nCleanedListVersion = 0;
 }
 
 bool CFinalizedBudget::AddOrUpdateVote(CFinalizedBudgetVote& vote, std::string& strError)
@@ -1865,12 +1993,20 @@ void CFinalizedBudget::AutoCheck()
 // If masternode voted for a proposal, but is now invalid -- remove the vote
 void CFinalizedBudget::CleanAndRemove(bool fSignatureCheck)
 {
+    LOCK(cs);
+
+    // Without the signatures, a vote is only invalid when its masternode is not listed
+    const uint64_t nListVersion = mnodeman.GetListVersion();
+    if (!fSignatureCheck && nCleanedListVersion == nListVersion) return;
+
     std::map<uint256, CFinalizedBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
         (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
         ++it;
     }
+
+    nCleanedListVersion = nListVersion;
 }
 
 
@@ -2124,8 +2260,7 @@ bool CFinalizedBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     CPubKey pubKeyCollateralAddress;
     CKey keyCollateralAddress;
 
-    HEX_DATA_STREAM_PROTOCOL(PROTOCOL_VERSION) << vin.prevout << nBudgetHash << nTime;
-    std::string strMessage = HEX_STR(ser);
+    std::string strMessage = GetStrMessage();
 
     if (!CMessageSigner::SignMessage(strMessage, vchSig, keyMasternode)) {
         LogPrint(BCLog::MNBUDGET,"CFinalizedBudgetVote::Sign - Error upon calling SignMessage");
@@ -2140,11 +2275,16 @@ bool CFinalizedBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     return true;
 }
 
+std::string CFinalizedBudgetVote::GetStrMessage() const
+{
+    HEX_DATA_STREAM_PROTOCOL(PROTOCOL_VERSION) << vin.prevout << nBudgetHash << nTime;
+    return HEX_STR(ser);
+}
+
 bool CFinalizedBudgetVote::SignatureValid(bool fSignatureCheck)
 {
     std::string strError;
-    HEX_DATA_STREAM_PROTOCOL(PROTOCOL_VERSION) << vin.prevout << nBudgetHash << nTime;
-    std::string strMessage = HEX_STR(ser);
+    std::string strMessage = GetStrMessage();
 
     CMasternode* pmn = mnodeman.Find(vin);
 
@@ -8,11 +8,13 @@
 #define MASTERNODE_BUDGET_H
 
 #include "base58.h"
+#include "cachejournal.h"
 #include "init.h"
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
 #include "net.h"
+#include "seencache.h"
 #include "sync.h"
 #include "util.h"
 
@@ -30,6 +32,9 @@ class CTxBudgetPayment;
 #define VOTE_YES 1
 #define VOTE_NO 2
 
+#define BUDGET_SEEN_VOTES_EXPIRE_SECONDS (30 * 24 * 60 * 60)
+#define BUDGET_SEEN_VOTES_MAX_BYTES (64 * 1024 * 1024)
+
 static const CAmount PROPOSAL_FEE_TX = (50 * COIN);
 static const CAmount BUDGET_FEE_TX = (50 * COIN);
 static const int64_t BUDGET_VOTE_UPDATE_MIN = 60 * 60;
@@ -67,6 +72,7 @@ public:
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool SignatureValid(bool fSignatureCheck);
     void Relay();
+    std::string GetStrMessage() const;
 
     std::string GetVoteString()
     {
@@ -119,6 +125,7 @@ public:
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool SignatureValid(bool fSignatureCheck);
     void Relay();
+    std::string GetStrMessage() const;
 
     uint256 GetHash()
     {
@@ -161,7 +168,10 @@ public:
     };
 
     CBudgetDB();
-    bool Write(const CBudgetManager& objToSave);
+    /** The file with its header and checksum, serialized under the locks appends to the journal take */
+    void Serialize(const CBudgetManager& objToSave, CDataStream& ssObj);
+    /** Write what Serialize produced and rename it into place, without holding any lock */
+    bool Write(const CDataStream& ssObj);
     ReadResult Read(CBudgetManager& objToLoad, bool fDryRun = false);
 };
 
@@ -176,6 +186,13 @@ private:
     // XX42    std::map<uint256, CTransaction> mapCollateral;
     std::map<uint256, uint256> mapCollateralTxids;
 
+    // proposal or budget and voter of every vote in their mapVotes, by vote hash, so
+    // votes Sync advertises can still be served once they expire from the seen caches
+    std::map<uint256, std::pair<uint256, uint256> > mapProposalVoteIndex;
+    std::map<uint256, std::pair<uint256, uint256> > mapFinalizedBudgetVoteIndex;
+
+    void RebuildVoteIndexes();
+
 public:
     // critical section to protect the inner data structures
     mutable RecursiveMutex cs;
@@ -185,18 +202,33 @@ public:
     std::map<uint256, CFinalizedBudget> mapFinalizedBudgets;
 
     std::map<uint256, CBudgetProposalBroadcast> mapSeenMasternodeBudgetProposals;
-    std::map<uint256, CBudgetVote> mapSeenMasternodeBudgetVotes;
+    CSeenCache<CBudgetVote> mapSeenMasternodeBudgetVotes;
     std::map<uint256, CBudgetVote> mapOrphanMasternodeBudgetVotes;
     std::map<uint256, CFinalizedBudgetBroadcast> mapSeenFinalizedBudgets;
-    std::map<uint256, CFinalizedBudgetVote> mapSeenFinalizedBudgetVotes;
+    CSeenCache<CFinalizedBudgetVote> mapSeenFinalizedBudgetVotes;
     std::map<uint256, CFinalizedBudgetVote> mapOrphanFinalizedBudgetVotes;
 
-    CBudgetManager()
+    // Proposals, finalized budgets and votes accepted since budget.dat was written,
+    // proposals and budgets recorded as their broadcasts so replay can fill the seen maps too
+    enum JournalRecord {
+        JOURNAL_PROPOSAL = 1,
+        JOURNAL_FINALIZED_BUDGET = 2,
+        JOURNAL_PROPOSAL_VOTE = 3,
+        JOURNAL_FINALIZED_BUDGET_VOTE = 4
+    };
+    CCacheJournal journal;
+
+    CBudgetManager() : mapSeenMasternodeBudgetVotes(BUDGET_SEEN_VOTES_EXPIRE_SECONDS, BUDGET_SEEN_VOTES_MAX_BYTES),
+                       mapSeenFinalizedBudgetVotes(BUDGET_SEEN_VOTES_EXPIRE_SECONDS, BUDGET_SEEN_VOTES_MAX_BYTES),
+                       journal("budget.journal", "MasternodeBudget")
     {
         mapProposals.clear();
         mapFinalizedBudgets.clear();
     }
 
+    /// Replay budget.journal on top of what was read from budget.dat, and keep recording to it
+    void OpenJournal();
+
     void ClearSeen()
     {
         mapSeenMasternodeBudgetProposals.clear();
@@ -231,6 +263,9 @@ public:
 
     bool UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string& strError);
     bool UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pfrom, std::string& strError);
+    /// Find a vote by hash in the seen cache, or among the votes of its proposal or budget
+    bool GetProposalVote(const uint256& hash, CBudgetVote& vote);
+    bool GetFinalizedBudgetVote(const uint256& hash, CFinalizedBudgetVote& vote);
     bool PropExists(uint256 nHash);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
     std::string GetRequiredPaymentsString(int nBlockHeight);
@@ -250,6 +285,8 @@ public:
         mapSeenFinalizedBudgetVotes.clear();
         mapOrphanMasternodeBudgetVotes.clear();
         mapOrphanFinalizedBudgetVotes.clear();
+        mapProposalVoteIndex.clear();
+        mapFinalizedBudgetVoteIndex.clear();
     }
     void CheckAndRemove();
     std::string ToString() const;
@@ -269,6 +306,8 @@ public:
 
         READWRITE(mapProposals);
         READWRITE(mapFinalizedBudgets);
+        if (ser_action.ForRead())
+            RebuildVoteIndexes();
     }
 };
 
@@ -309,6 +348,7 @@ private:
     // critical section to protect the inner data structures
     mutable RecursiveMutex cs;
     bool fAutoChecked; //If it matches what we see, we'll auto vote for it (masternode only)
+    uint64_t nCleanedListVersion; //masternode list version the votes were last checked against
 
 public:
     bool fValid;
@@ -455,6 +495,16 @@ private:
     mutable RecursiveMutex cs;
     CAmount nAlloted;
 
+    // running tallies of mapVotes, valid votes by type plus all yes/no votes for GetRatio
+    int nYeas;
+    int nNays;
+    int nAbstains;
+    int nYeasTotal;
+    int nNaysTotal;
+    uint64_t nCleanedListVersion; //masternode list version the votes were last checked against
+
+    void CountVote(const CBudgetVote& vote, int nDelta);
+
 public:
     bool fValid;
     std::string strProposalName;
@@ -480,6 +530,7 @@ public:
 
     void Calculate();
     bool AddOrUpdateVote(CBudgetVote& vote, std::string& strError);
+    void RecountVotes();
     bool HasMinimumRequiredSupport();
     std::pair<std::string, std::string> GetVotes();
 
@@ -505,9 +556,9 @@ public:
     int GetBlockCurrentCycle();
     int GetBlockEndCycle();
     double GetRatio();
-    int GetYeas();
-    int GetNays();
-    int GetAbstains();
+    int GetYeas() { return nYeas; }
+    int GetNays() { return nNays; }
+    int GetAbstains() { return nAbstains; }
     CAmount GetAmount() { return nAmount; }
     void SetAllotted(CAmount nAllotedIn) { nAlloted = nAllotedIn; }
     CAmount GetAllotted() { return nAlloted; }
@@ -546,6 +597,8 @@ public:
 
         //for saving to the serialized db
         READWRITE(mapVotes);
+        if (ser_action.ForRead())
+            RecountVotes();
     }
 };
 
@@ -574,6 +627,8 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        first.RecountVotes();
+        second.RecountVotes();
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
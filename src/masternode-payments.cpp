@@ -32,23 +32,29 @@ CMasternodePaymentDB::CMasternodePaymentDB()
     strMagicMessage = "MasternodePayments";
 }
 
-bool CMasternodePaymentDB::Write(const CMasternodePayments& objToSave)
+void CMasternodePaymentDB::Serialize(const CMasternodePayments& objToSave, CDataStream& ssObj)
 {
-    int64_t nStart = GetTimeMillis();
-
     // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
     ssObj << strMagicMessage;                   // masternode cache file specific magic message
     ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
+    {
+        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+        ssObj << objToSave;
+    }
     uint256 hash = Hash(ssObj.begin(), ssObj.end());
     ssObj << hash;
+}
 
-    // open output file, and associate with CAutoFile
-    FILE* file = fsbridge::fopen(pathDB, "wb");
+bool CMasternodePaymentDB::Write(const CDataStream& ssObj)
+{
+    int64_t nStart = GetTimeMillis();
+
+    // open temp output file, and associate with CAutoFile
+    fs::path pathTmp = pathDB.string() + ".new";
+    FILE* file = fsbridge::fopen(pathTmp, "wb");
     CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
+        return error("%s : Failed to open file %s", __func__, pathTmp.string());
 
     // Write and commit header, data
     try {
@@ -56,8 +62,13 @@ bool CMasternodePaymentDB::Write(const CMasternodePayments& objToSave)
     } catch (const std::exception& e) {
         return error("%s : Serialize or I/O error - %s", __func__, e.what());
     }
+    FileCommit(fileout.Get());
     fileout.fclose();
 
+    // replace existing mnpayments.dat, so a crash leaves either the old or the new one
+    if (!RenameOver(pathTmp, pathDB))
+        return error("%s : Rename-into-place failed", __func__);
+
     LogPrint(BCLog::MASTERNODE, "Written info to mnpayments.dat  %dms\n", GetTimeMillis() - nStart);
 
     return true;
@@ -167,7 +178,15 @@ void DumpMasternodePayments()
         }
     }
     LogPrint(BCLog::MASTERNODE, "Writting info to mnpayments.dat...\n");
-    paymentdb.Write(masternodePayments);
+    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+    {
+        // AddWinningMasternode appends under these locks too, so every winner is either serialized or in the fresh journal
+        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+        paymentdb.Serialize(masternodePayments, ssObj);
+        masternodePayments.journal.Rotate();
+    }
+    if (paymentdb.Write(ssObj))
+        masternodePayments.journal.RemoveRotated();
 
     LogPrint(BCLog::MASTERNODE, "Budget dump finished  %dms\n", GetTimeMillis() - nStart);
 }
@@ -379,8 +398,7 @@ bool CMasternodePaymentWinner::Sign(CKey& keyMasternode, CPubKey& pubKeyMasterno
     std::string strMasterNodeSignMessage;
 
     std::string payeeString(payee.begin(), payee.end());
-    HEX_DATA_STREAM_PROTOCOL(PROTOCOL_VERSION) << vinMasternode.prevout.GetHash() << nBlockHeight << payee;
-    std::string strMessage = HEX_STR(ser);
+    std::string strMessage = GetStrMessage();
 
     if (!CMessageSigner::SignMessage(strMessage, vchSig, keyMasternode)) {
         LogPrint(BCLog::MASTERNODE,"%s - SignMessage Error.%s\n", __func__);
@@ -417,24 +435,84 @@ bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
         nHeight = chainActive.Tip()->nHeight;
     }
 
-    std::vector<unsigned char> mnpayee;
-    mnpayee = mn.vin.masternodeStealthAddress;
+    std::map<std::vector<unsigned char>, std::set<int> >::const_iterator mi = mapPayeeWinningHeights.find(mn.vin.masternodeStealthAddress);
+    if (mi == mapPayeeWinningHeights.end()) return false;
 
-    std::vector<unsigned char> payee;
-    for (int64_t h = nHeight; h <= nHeight + 8; h++) {
-        if (h == nNotBlockHeight) continue;
-        if (mapMasternodeBlocks.count(h)) {
-            if (mapMasternodeBlocks[h].GetPayee(payee)) {
-                if (mnpayee == payee) {
-                    return true;
-                }
-            }
-        }
+    for (std::set<int>::const_iterator it = mi->second.lower_bound(nHeight); it != mi->second.end() && *it <= nHeight + 8; ++it) {
+        if (*it != nNotBlockHeight) return true;
     }
 
     return false;
 }
 
+int CMasternodePayments::GetLastPaidHeight(const std::vector<unsigned char>& payee, int nHeight, int nDepth)
+{
+    LOCK(cs_mapMasternodeBlocks);
+
+    std::map<std::vector<unsigned char>, std::set<int> >::const_iterator mi = mapPayeeVotedHeights.find(payee);
+    if (mi == mapPayeeVotedHeights.end()) return 0;
+
+    std::set<int>::const_iterator it = mi->second.upper_bound(nHeight);
+    if (it == mi->second.begin()) return 0;
+    --it;
+    if (*it <= 0 || *it <= nHeight - nDepth) return 0;
+    return *it;
+}
+
+void CMasternodePayments::AddToIndexes(CMasternodeBlockPayees& blockPayees)
+{
+    std::vector<unsigned char> payee;
+    if (blockPayees.GetPayee(payee))
+        mapPayeeWinningHeights[payee].insert(blockPayees.nBlockHeight);
+
+    LOCK(cs_vecPayments);
+    for (const CMasternodePayee& p : blockPayees.vecPayments) {
+        if (p.nVotes >= 2)
+            mapPayeeVotedHeights[p.masternodeStealthAddress].insert(blockPayees.nBlockHeight);
+    }
+}
+
+static void EraseIndexedHeight(std::map<std::vector<unsigned char>, std::set<int> >& mapHeights, const std::vector<unsigned char>& payee, int nHeight)
+{
+    std::map<std::vector<unsigned char>, std::set<int> >::iterator mi = mapHeights.find(payee);
+    if (mi == mapHeights.end()) return;
+    mi->second.erase(nHeight);
+    if (mi->second.empty()) mapHeights.erase(mi);
+}
+
+void CMasternodePayments::RemoveFromIndexes(CMasternodeBlockPayees& blockPayees)
+{
+    LOCK(cs_vecPayments);
+    for (const CMasternodePayee& p : blockPayees.vecPayments) {
+        EraseIndexedHeight(mapPayeeVotedHeights, p.masternodeStealthAddress, blockPayees.nBlockHeight);
+        EraseIndexedHeight(mapPayeeWinningHeights, p.masternodeStealthAddress, blockPayees.nBlockHeight);
+    }
+}
+
+void CMasternodePayments::RebuildIndexes()
+{
+    LOCK(cs_mapMasternodeBlocks);
+
+    mapPayeeVotedHeights.clear();
+    mapPayeeWinningHeights.clear();
+    for (std::pair<const int, CMasternodeBlockPayees>& blockPayees : mapMasternodeBlocks)
+        AddToIndexes(blockPayees.second);
+}
+
+void CMasternodePayments::AddPayeeVote(int nBlockHeight, const std::vector<unsigned char>& payee)
+{
+    LOCK(cs_mapMasternodeBlocks);
+
+    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.find(nBlockHeight);
+    if (it == mapMasternodeBlocks.end())
+        it = mapMasternodeBlocks.insert(std::make_pair(nBlockHeight, CMasternodeBlockPayees(nBlockHeight))).first;
+
+    // The vote can change who leads at this height, index it again
+    RemoveFromIndexes(it->second);
+    it->second.AddPayee(1, payee);
+    AddToIndexes(it->second);
+}
+
 bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerIn)
 {
     uint256 blockHash;
@@ -450,91 +528,93 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
         }
 
         mapMasternodePayeeVotes[winnerIn.GetHash()] = winnerIn;
-
-        if (!mapMasternodeBlocks.count(winnerIn.nBlockHeight)) {
-            CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
-            mapMasternodeBlocks[winnerIn.nBlockHeight] = blockPayees;
-        }
+        AddPayeeVote(winnerIn.nBlockHeight, winnerIn.vinMasternode.masternodeStealthAddress);
+        journal.Append(JOURNAL_WINNER, winnerIn);
     }
 
-    mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(1, winnerIn.vinMasternode.masternodeStealthAddress);
-
     return true;
 }
 
-bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew)
+void CMasternodePayments::OpenJournal()
 {
-    LOCK2(cs_main, cs_vecPayments);
-
-    int nMaxSignatures = 0;
-    int nMasternode_Drift_Count = 0;
-
-    std::string strPayeesPossible = "";
-    nMasternode_Drift_Count = mnodeman.size() + Params().MasternodeCountDrift();
-    CBlockIndex* pindexPrev = chainActive.Tip();
-    CAmount requiredMasternodePayment = GetMasternodePayment(nBlockHeight, GetBlockValue(pindexPrev->nHeight));
-
-    //require at least 6 signatures
-    for (CMasternodePayee& payee : vecPayments)
-        if (payee.nVotes >= nMaxSignatures && payee.nVotes >= MNPAYMENTS_SIGNATURES_REQUIRED)
-            nMaxSignatures = payee.nVotes;
+    journal.Open([this](unsigned char nType, CDataStream& ssRecord) {
+        if (nType == JOURNAL_WINNER) {
+            CMasternodePaymentWinner winner;
+            ssRecord >> winner;
+            AddWinningMasternode(winner);
+        }
+    });
+}
 
-    // if we don't have at least 6 signatures on a payee, approve whichever is the longest chain
-    if (nMaxSignatures < MNPAYMENTS_SIGNATURES_REQUIRED) return true;
+void CMasternodeBlockPayees::UpdateRequired()
+{
+    AssertLockHeld(cs_vecPayments);
+    if (fRequiredValid) return;
 
+    setRequiredPayees.clear();
+    strRequiredPayees = "";
+    strRequiredPayments = "Unknown";
     for (CMasternodePayee& payee : vecPayments) {
-        bool found = false;
-        for (CTxOut out : txNew.vout) {
-            if (payee.masternodeStealthAddress == out.masternodeStealthAddress) {
-                if (out.nValue >= requiredMasternodePayment)
-                    found = true;
-                else
-                    LogPrint(BCLog::MASTERNODE, "Masternode payment is out of drift range. Paid=%s Min=%s\n", FormatMoney(out.nValue).c_str(), FormatMoney(requiredMasternodePayment).c_str());
-            }
-        }
+        std::string paymentAddress(payee.masternodeStealthAddress.begin(), payee.masternodeStealthAddress.end());
 
         if (payee.nVotes >= MNPAYMENTS_SIGNATURES_REQUIRED) {
-            if (found) return true;
-
-            std::string address2(payee.masternodeStealthAddress.begin(), payee.masternodeStealthAddress.end());
-
-            if (strPayeesPossible == "") {
-                strPayeesPossible += address2;
+            setRequiredPayees.insert(payee.masternodeStealthAddress);
+            if (strRequiredPayees == "") {
+                strRequiredPayees += paymentAddress;
             } else {
-                strPayeesPossible += "," + address2;
+                strRequiredPayees += "," + paymentAddress;
             }
         }
+
+        if (strRequiredPayments != "Unknown") {
+            strRequiredPayments += ", " + paymentAddress + ":" + std::to_string(payee.nVotes);
+        } else {
+            strRequiredPayments = paymentAddress + ":" + std::to_string(payee.nVotes);
+        }
     }
-    LogPrint(BCLog::MASTERNODE, "CMasternodePayments::IsTransactionValid - Missing required payment of %s to %s\n", FormatMoney(requiredMasternodePayment).c_str(), strPayeesPossible.c_str());
-    return false;
+    fRequiredValid = true;
 }
 
-std::string CMasternodeBlockPayees::GetRequiredPaymentsString()
+bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew)
 {
-    LOCK(cs_vecPayments);
+    LOCK2(cs_main, cs_vecPayments);
 
-    std::string ret = "Unknown";
+    UpdateRequired();
 
-    for (CMasternodePayee& payee : vecPayments) {
-        //CTxDestination address1;
-        std::string paymentAddress(payee.masternodeStealthAddress.begin(), payee.masternodeStealthAddress.end());
+    // if we don't have at least 6 signatures on a payee, approve whichever is the longest chain
+    if (setRequiredPayees.empty()) return true;
 
-        if (ret != "Unknown") {
-            ret += ", " + paymentAddress + ":" + std::to_string(payee.nVotes);
-        } else {
-            ret = paymentAddress + ":" + std::to_string(payee.nVotes);
-        }
+    // the amount follows the tip, derive it again once that moved
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    if (hashRequiredPaymentTip != pindexPrev->GetBlockHash()) {
+        nRequiredPayment = GetMasternodePayment(nBlockHeight, GetBlockValue(pindexPrev->nHeight));
+        hashRequiredPaymentTip = pindexPrev->GetBlockHash();
     }
 
-    return ret;
+    for (const CTxOut& out : txNew.vout) {
+        if (!setRequiredPayees.count(out.masternodeStealthAddress)) continue;
+        if (out.nValue >= nRequiredPayment) return true;
+        LogPrint(BCLog::MASTERNODE, "Masternode payment is out of drift range. Paid=%s Min=%s\n", FormatMoney(out.nValue).c_str(), FormatMoney(nRequiredPayment).c_str());
+    }
+    LogPrint(BCLog::MASTERNODE, "CMasternodePayments::IsTransactionValid - Missing required payment of %s to %s\n", FormatMoney(nRequiredPayment).c_str(), strRequiredPayees.c_str());
+    return false;
+}
+
+std::string CMasternodeBlockPayees::GetRequiredPaymentsString()
+{
+    LOCK(cs_vecPayments);
+
+    UpdateRequired();
+    return strRequiredPayments;
 }
 
 std::string CMasternodePayments::GetRequiredPaymentsString(int nBlockHeight)
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].GetRequiredPaymentsString();
+    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.find(nBlockHeight);
+    if (it != mapMasternodeBlocks.end()) {
+        return it->second.GetRequiredPaymentsString();
     }
 
     return "Unknown";
@@ -544,8 +624,9 @@ bool CMasternodePayments::IsTransactionValid(const CTransaction& txNew, int nBlo
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].IsTransactionValid(txNew);
+    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.find(nBlockHeight);
+    if (it != mapMasternodeBlocks.end()) {
+        return it->second.IsTransactionValid(txNew);
     }
 
     return true;
@@ -573,7 +654,11 @@ void CMasternodePayments::CleanPaymentList()
             LogPrint(BCLog::MASTERNODE, "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
             masternodeSync.mapSeenSyncMNW.erase((*it).first);
             mapMasternodePayeeVotes.erase(it++);
-            mapMasternodeBlocks.erase(winner.nBlockHeight);
+            std::map<int, CMasternodeBlockPayees>::iterator mi = mapMasternodeBlocks.find(winner.nBlockHeight);
+            if (mi != mapMasternodeBlocks.end()) {
+                RemoveFromIndexes(mi->second);
+                mapMasternodeBlocks.erase(mi);
+            }
         } else {
             ++it;
         }
@@ -685,13 +770,18 @@ void CMasternodePaymentWinner::Relay()
     RelayInv(inv);
 }
 
+std::string CMasternodePaymentWinner::GetStrMessage() const
+{
+    HEX_DATA_STREAM_PROTOCOL(PROTOCOL_VERSION) << vinMasternode.prevout.GetHash() << nBlockHeight << payee;
+    return HEX_STR(ser);
+}
+
 bool CMasternodePaymentWinner::SignatureValid()
 {
     CMasternode* pmn = mnodeman.Find(vinMasternode);
 
     if (pmn != NULL) {
-        HEX_DATA_STREAM_PROTOCOL(PROTOCOL_VERSION) << vinMasternode.prevout.GetHash() << nBlockHeight << payee;
-        std::string strMessage = HEX_STR(ser);
+        std::string strMessage = GetStrMessage();
 
         std::string strError = "";
         if (!CMessageSigner::VerifyMessage(pmn->pubKeyMasternode, vchSig, strMessage, strError)) {
@@ -7,6 +7,7 @@
 #ifndef MASTERNODE_PAYMENTS_H
 #define MASTERNODE_PAYMENTS_H
 
+#include "cachejournal.h"
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
@@ -53,7 +54,10 @@ public:
     };
 
     CMasternodePaymentDB();
-    bool Write(const CMasternodePayments& objToSave);
+    /** The file with its header and checksum, serialized under the locks appends to the journal take */
+    void Serialize(const CMasternodePayments& objToSave, CDataStream& ssObj);
+    /** Write what Serialize produced and rename it into place, without holding any lock */
+    bool Write(const CDataStream& ssObj);
     ReadResult Read(CMasternodePayments& objToLoad, bool fDryRun = false);
 };
 
@@ -87,6 +91,18 @@ public:
 // Keep track of votes for payees from masternodes
 class CMasternodeBlockPayees
 {
+private:
+    //! What block checks need from the votes, derived again after the next vote comes in
+    bool fRequiredValid;
+    std::set<std::vector<unsigned char> > setRequiredPayees; //payees with at least MNPAYMENTS_SIGNATURES_REQUIRED votes
+    std::string strRequiredPayees;
+    std::string strRequiredPayments;
+    //! Required payment amount, for the tip it was derived at
+    uint256 hashRequiredPaymentTip;
+    CAmount nRequiredPayment;
+
+    void UpdateRequired();
+
 public:
     int nBlockHeight;
     std::vector<CMasternodePayee> vecPayments;
@@ -95,17 +111,22 @@ public:
     {
         nBlockHeight = 0;
         vecPayments.clear();
+        fRequiredValid = false;
+        nRequiredPayment = 0;
     }
     CMasternodeBlockPayees(int nBlockHeightIn)
     {
         nBlockHeight = nBlockHeightIn;
         vecPayments.clear();
+        fRequiredValid = false;
+        nRequiredPayment = 0;
     }
 
     void AddPayee(int nIncrement, std::vector<unsigned char> masternodeStealthAddress)
     {
         LOCK(cs_vecPayments);
 
+        fRequiredValid = false;
         for (CMasternodePayee& payee : vecPayments) {
             if (payee.masternodeStealthAddress == masternodeStealthAddress) {
                 payee.nVotes += nIncrement;
@@ -153,6 +174,8 @@ public:
     {
         READWRITE(nBlockHeight);
         READWRITE(vecPayments);
+        if (ser_action.ForRead())
+            fRequiredValid = false;
     }
 };
 
@@ -193,6 +216,7 @@ public:
     bool IsValid(CNode* pnode, std::string& strError);
     bool SignatureValid();
     void Relay();
+    std::string GetStrMessage() const;
 
     void AddPayee(std::vector<unsigned char> payeeIn)
     {
@@ -234,25 +258,46 @@ private:
     int nSyncedFromPeer;
     int nLastBlockHeight;
 
+    //! Heights at which a payee has at least 2 votes, by payee
+    std::map<std::vector<unsigned char>, std::set<int> > mapPayeeVotedHeights;
+    //! Heights at which a payee has the most votes, by payee
+    std::map<std::vector<unsigned char>, std::set<int> > mapPayeeWinningHeights;
+
+    void AddToIndexes(CMasternodeBlockPayees& blockPayees);
+    void RemoveFromIndexes(CMasternodeBlockPayees& blockPayees);
+    void RebuildIndexes();
+
 public:
     std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
     std::map<uint256, int> mapMasternodesLastVote; //prevout.hash + prevout.n, nBlockHeight
 
-    CMasternodePayments()
+    // Winners accepted since mnpayments.dat was written
+    enum JournalRecord {
+        JOURNAL_WINNER = 1
+    };
+    CCacheJournal journal;
+
+    CMasternodePayments() : journal("mnpayments.journal", "MasternodePayments")
     {
         nSyncedFromPeer = 0;
         nLastBlockHeight = 0;
     }
 
+    /// Replay mnpayments.journal on top of what was read from mnpayments.dat, and keep recording to it
+    void OpenJournal();
+
     void Clear()
     {
         LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
         mapMasternodeBlocks.clear();
         mapMasternodePayeeVotes.clear();
+        mapPayeeVotedHeights.clear();
+        mapPayeeWinningHeights.clear();
     }
 
     bool AddWinningMasternode(CMasternodePaymentWinner& winner);
+    void AddPayeeVote(int nBlockHeight, const std::vector<unsigned char>& payee);
     bool ProcessBlock(int nBlockHeight);
 
     void Sync(CNode* node, int nCountNeeded);
@@ -262,6 +307,8 @@ public:
     bool GetBlockPayee(int nBlockHeight, std::vector<unsigned char>& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
     bool IsScheduled(CMasternode& mn, int nNotBlockHeight);
+    /** Newest height in (nHeight - nDepth, nHeight] at which payee has at least 2 votes, 0 if there is none */
+    int GetLastPaidHeight(const std::vector<unsigned char>& payee, int nHeight, int nDepth);
 
     bool CanVote(COutPoint outMasternode, int nBlockHeight)
     {
@@ -293,6 +340,8 @@ public:
     {
         READWRITE(mapMasternodePayeeVotes);
         READWRITE(mapMasternodeBlocks);
+        if (ser_action.ForRead())
+            RebuildIndexes();
     }
 };
 
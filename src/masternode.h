@@ -63,6 +63,7 @@ public:
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool VerifySignature(CPubKey& pubKeyMasternode, int &nDos);
     void Relay();
+    std::string GetStrMessage() const;
 
     uint256 GetHash()
     {
@@ -189,6 +190,7 @@ public:
     }
 
     uint256 CalculateScore(int mod = 1, int64_t nBlockHeight = 0);
+    uint256 CalculateScore(const uint256& hashBlock) const;
 
     ADD_SERIALIZE_METHODS;
 
@@ -215,7 +217,8 @@ public:
         READWRITE(nLastScanningErrorBlockHeight);
     }
 
-    int64_t SecondsSincePayment();
+    /** nEnabled is the number of enabled masternodes, counted when -1 */
+    int64_t SecondsSincePayment(int nEnabled = -1) const;
 
     bool UpdateFromNewBroadcast(CMasternodeBroadcast& mnb);
 
@@ -239,7 +242,7 @@ public:
         lastPing = CMasternodePing();
     }
 
-    bool IsEnabled()
+    bool IsEnabled() const
     {
         return activeState == MASTERNODE_ENABLED;
     }
@@ -264,7 +267,7 @@ public:
 
     std::string GetStatus();
 
-    std::string Status()
+    std::string Status() const
     {
         std::string strStatus = "ACTIVE";
 
@@ -277,7 +280,7 @@ public:
         return strStatus;
     }
 
-    int64_t GetLastPaid();
+    int64_t GetLastPaid(int nEnabled = -1) const;
     bool IsValidNetAddr();
 
     /// Is the input associated with collateral public key? (and there is 5000 PRCY - checking if valid masternode)
@@ -7,6 +7,7 @@
 #include "masternodeman.h"
 
 #include "addrman.h"
+#include "masternode-budget.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "messagesigner.h"
@@ -31,19 +32,11 @@ struct CompareLastPaid {
     }
 };
 
-struct CompareScoreTxIn {
-    bool operator()(const std::pair<int64_t, CTxIn>& t1,
-        const std::pair<int64_t, CTxIn>& t2) const
+struct CompareScoreDescending {
+    bool operator()(const std::pair<int64_t, CMasternode*>& t1,
+        const std::pair<int64_t, CMasternode*>& t2) const
     {
-        return t1.first < t2.first;
-    }
-};
-
-struct CompareScoreMN {
-    bool operator()(const std::pair<int64_t, CMasternode>& t1,
-        const std::pair<int64_t, CMasternode>& t2) const
-    {
-        return t1.first < t2.first;
+        return t1.first > t2.first;
     }
 };
 
@@ -57,23 +50,26 @@ CMasternodeDB::CMasternodeDB()
     strMagicMessage = "MasternodeCache";
 }
 
-bool CMasternodeDB::Write(const CMasternodeMan& mnodemanToSave)
+void CMasternodeDB::Serialize(const CMasternodeMan& mnodemanToSave, CDataStream& ssMasternodes)
 {
-    int64_t nStart = GetTimeMillis();
-
     // serialize, checksum data up to that point, then append checksum
-    CDataStream ssMasternodes(SER_DISK, CLIENT_VERSION);
     ssMasternodes << strMagicMessage;                   // masternode cache file specific magic message
     ssMasternodes << FLATDATA(Params().MessageStart()); // network specific magic number
     ssMasternodes << mnodemanToSave;
     uint256 hash = Hash(ssMasternodes.begin(), ssMasternodes.end());
     ssMasternodes << hash;
+}
 
-    // open output file, and associate with CAutoFile
-    FILE* file = fsbridge::fopen(pathMN, "wb");
+bool CMasternodeDB::Write(const CDataStream& ssMasternodes)
+{
+    int64_t nStart = GetTimeMillis();
+
+    // open temp output file, and associate with CAutoFile
+    fs::path pathTmp = pathMN.string() + ".new";
+    FILE* file = fsbridge::fopen(pathTmp, "wb");
     CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathMN.string());
+        return error("%s : Failed to open file %s", __func__, pathTmp.string());
 
     // Write and commit header, data
     try {
@@ -81,11 +77,14 @@ bool CMasternodeDB::Write(const CMasternodeMan& mnodemanToSave)
     } catch (const std::exception& e) {
         return error("%s : Serialize or I/O error - %s", __func__, e.what());
     }
-
+    FileCommit(fileout.Get());
     fileout.fclose();
 
+    // replace existing mncache.dat, so a crash leaves either the old or the new one
+    if (!RenameOver(pathTmp, pathMN))
+        return error("%s : Rename-into-place failed", __func__);
+
     LogPrint(BCLog::MASTERNODE,"Written info to mncache.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrint(BCLog::MASTERNODE,"  %s\n", mnodemanToSave.ToString());
 
     return true;
 }
@@ -193,16 +192,106 @@ void DumpMasternodes()
         }
     }
     LogPrint(BCLog::MASTERNODE,"Writting info to mncache.dat...\n");
-    mndb.Write(mnodeman);
+    CDataStream ssMasternodes(SER_DISK, CLIENT_VERSION);
+    std::string strSummary;
+    {
+        // the pings and entries appended meanwhile go to the fresh journal
+        LOCK(mnodeman.cs);
+        mndb.Serialize(mnodeman, ssMasternodes);
+        mnodeman.journal.Rotate();
+        strSummary = mnodeman.ToString();
+    }
+    if (mndb.Write(ssMasternodes)) {
+        LogPrint(BCLog::MASTERNODE,"  %s\n", strSummary);
+        mnodeman.journal.RemoveRotated();
+    }
 
     LogPrint(BCLog::MASTERNODE,"Masternode dump finished  %dms\n", GetTimeMillis() - nStart);
 }
 
-CMasternodeMan::CMasternodeMan()
+CMasternodeMan::CMasternodeMan() : snapshot(std::make_shared<const CMasternodeListSnapshot>()), fSnapshotDirty(true), nListVersion(1),
+                                   mapSeenMasternodeBroadcast(MASTERNODE_REMOVAL_SECONDS * 2, MASTERNODES_SEEN_MAX_BYTES),
+                                   mapSeenMasternodePing(MASTERNODE_REMOVAL_SECONDS * 2, MASTERNODES_SEEN_MAX_BYTES),
+                                   journal("mncache.journal", "MasternodeCache")
 {
     nDsqCount = 0;
 }
 
+template <typename K>
+static void EraseIndexEntry(std::multimap<K, CMasternode*>& index, const K& key, const CMasternode* pmn)
+{
+    typedef typename std::multimap<K, CMasternode*>::iterator Iter;
+    std::pair<Iter, Iter> range = index.equal_range(key);
+    for (Iter it = range.first; it != range.second; ++it) {
+        if (it->second == pmn) {
+            index.erase(it);
+            return;
+        }
+    }
+}
+
+void CMasternodeMan::AddToIndexes(CMasternode& mn)
+{
+    AssertLockHeld(cs);
+    mapMasternodesByCollateral.insert(std::make_pair(mn.vin.prevout, &mn));
+    mapMasternodesByCollateralPayee.insert(std::make_pair(GetScriptForDestination(mn.pubKeyCollateralAddress), &mn));
+    mapMasternodesByPubKey.insert(std::make_pair(mn.pubKeyMasternode, &mn));
+    mapMasternodesByStealthAddress.insert(std::make_pair(mn.vin.masternodeStealthAddress, &mn));
+}
+
+void CMasternodeMan::RemoveFromIndexes(CMasternode& mn)
+{
+    AssertLockHeld(cs);
+    std::map<COutPoint, CMasternode*>::iterator it = mapMasternodesByCollateral.find(mn.vin.prevout);
+    if (it != mapMasternodesByCollateral.end() && it->second == &mn)
+        mapMasternodesByCollateral.erase(it);
+    EraseIndexEntry(mapMasternodesByCollateralPayee, GetScriptForDestination(mn.pubKeyCollateralAddress), &mn);
+    EraseIndexEntry(mapMasternodesByPubKey, mn.pubKeyMasternode, &mn);
+    EraseIndexEntry(mapMasternodesByStealthAddress, mn.vin.masternodeStealthAddress, &mn);
+}
+
+std::list<CMasternode>::iterator CMasternodeMan::Erase(std::list<CMasternode>::iterator it)
+{
+    AssertLockHeld(cs);
+    RemoveFromIndexes(*it);
+    ClearScoresCache();
+    fSnapshotDirty = true;
+    nListVersion++;
+    return vMasternodes.erase(it);
+}
+
+void CMasternodeMan::ClearScoresCache()
+{
+    AssertLockHeld(cs);
+    mapScoresCache.clear();
+    vScoresCacheOrder.clear();
+}
+
+// Scores only depend on the block hash and the collateral, so they are computed once per block
+// for the whole list and shared by every rank lookup at that height until the list changes
+const std::vector<std::pair<int64_t, CMasternode*> >& CMasternodeMan::GetScores(const uint256& hashBlock)
+{
+    AssertLockHeld(cs);
+
+    std::map<uint256, std::vector<std::pair<int64_t, CMasternode*> > >::iterator it = mapScoresCache.find(hashBlock);
+    if (it != mapScoresCache.end())
+        return it->second;
+
+    if (vScoresCacheOrder.size() >= MASTERNODES_SCORES_CACHE_SIZE) {
+        mapScoresCache.erase(vScoresCacheOrder.front());
+        vScoresCacheOrder.pop_front();
+    }
+    vScoresCacheOrder.push_back(hashBlock);
+
+    std::vector<std::pair<int64_t, CMasternode*> >& vecScores = mapScoresCache[hashBlock];
+    vecScores.reserve(vMasternodes.size());
+    for (CMasternode& mn : vMasternodes)
+        vecScores.push_back(std::make_pair((int64_t)mn.CalculateScore(hashBlock).GetCompact(false), &mn));
+    // Stable, so ties keep list order like the linear scans did
+    std::stable_sort(vecScores.begin(), vecScores.end(), CompareScoreDescending());
+    return vecScores;
+}
+
 bool CMasternodeMan::Add(CMasternode& mn)
 {
     LOCK(cs);
@@ -214,12 +303,51 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        AddToIndexes(vMasternodes.back());
+        ClearScoresCache();
+        fSnapshotDirty = true;
+        nListVersion++;
+        journal.Append(JOURNAL_MASTERNODE, vMasternodes.back());
         return true;
     }
 
     return false;
 }
 
+void CMasternodeMan::OpenJournal()
+{
+    journal.Open([this](unsigned char nType, CDataStream& ssRecord) {
+        LOCK(cs);
+        if (nType == JOURNAL_MASTERNODE) {
+            CMasternode mn;
+            ssRecord >> mn;
+            CMasternode* pmn = Find(mn.vin);
+            if (pmn == NULL) {
+                vMasternodes.push_back(mn);
+                AddToIndexes(vMasternodes.back());
+            } else if (pmn->sigTime <= mn.sigTime) {
+                // the ping may be newer than the broadcast
+                CMasternodePing lastPing = pmn->lastPing;
+                RemoveFromIndexes(*pmn);
+                *pmn = mn;
+                if (lastPing.sigTime > pmn->lastPing.sigTime) pmn->lastPing = lastPing;
+                AddToIndexes(*pmn);
+            }
+            ClearScoresCache();
+            fSnapshotDirty = true;
+            nListVersion++;
+        } else if (nType == JOURNAL_PING) {
+            CMasternodePing mnp;
+            ssRecord >> mnp;
+            CMasternode* pmn = Find(mnp.vin);
+            if (pmn != NULL && pmn->lastPing.sigTime < mnp.sigTime) {
+                pmn->lastPing = mnp;
+                fSnapshotDirty = true;
+            }
+        }
+    });
+}
+
 void CMasternodeMan::AskForMN(CNode* pnode, CTxIn& vin)
 {
     std::map<COutPoint, int64_t>::iterator i = mWeAskedForMasternodeListEntry.find(vin.prevout);
@@ -254,24 +382,27 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     LOCK(cs);
 
     //remove inactive and outdated
-    std::vector<CMasternode>::iterator it = vMasternodes.begin();
+    std::list<CMasternode>::iterator it = vMasternodes.begin();
     while (it != vMasternodes.end()) {
         if ((*it).activeState == CMasternode::MASTERNODE_REMOVE ||
             (*it).activeState == CMasternode::MASTERNODE_VIN_SPENT ||
             (forceExpiredRemoval && (*it).activeState == CMasternode::MASTERNODE_EXPIRED) ||
             (*it).protocolVersion < masternodePayments.GetMinMasternodePaymentsProto()) {
-            LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Removing inactive Masternode %s - %i now,mapSeenMasternodeBroadcast.size=%d\n", (*it).vin.prevout.hash.ToString(), size() - 1, mapSeenMasternodeBroadcast.size());
-
-            //erase all of the broadcasts we've seen from this vin
-            // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
-            //    sending a brand new mnb
-            std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-            while (it3 != mapSeenMasternodeBroadcast.end()) {
-                if ((*it3).second.vin == (*it).vin) {
-                    masternodeSync.mapSeenSyncMNB.erase((*it3).first);
-                    mapSeenMasternodeBroadcast.erase(it3++);
-                } else {
-                    ++it3;
+            {
+                LOCK(cs_seen);
+                LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Removing inactive Masternode %s - %i now,mapSeenMasternodeBroadcast.size=%d\n", (*it).vin.prevout.hash.ToString(), size() - 1, mapSeenMasternodeBroadcast.size());
+
+                //erase all of the broadcasts we've seen from this vin
+                // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
+                //    sending a brand new mnb
+                CSeenCache<CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
+                while (it3 != mapSeenMasternodeBroadcast.end()) {
+                    if ((*it3).second.vin == (*it).vin) {
+                        masternodeSync.mapSeenSyncMNB.erase((*it3).first);
+                        mapSeenMasternodeBroadcast.erase(it3++);
+                    } else {
+                        ++it3;
+                    }
                 }
             }
 
@@ -285,7 +416,7 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
                 }
             }
 
-            it = vMasternodes.erase(it);
+            it = Erase(it);
         } else {
             ++it;
         }
@@ -321,37 +452,31 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
         }
     }
 
-    // remove expired mapSeenMasternodeBroadcast
-    std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-    while (it3 != mapSeenMasternodeBroadcast.end()) {
-        if ((*it3).second.lastPing.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
-            mapSeenMasternodeBroadcast.erase(it3++);
-            masternodeSync.mapSeenSyncMNB.erase((*it3).second.GetHash());
-        } else {
-            ++it3;
-        }
-    }
-
-    // remove expired mapSeenMasternodePing
-    std::map<uint256, CMasternodePing>::iterator it4 = mapSeenMasternodePing.begin();
-    while (it4 != mapSeenMasternodePing.end()) {
-        if ((*it4).second.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
-            mapSeenMasternodePing.erase(it4++);
-        } else {
-            ++it4;
-        }
-    }
+    // expire seen broadcasts of masternodes that stopped pinging, and old pings
+    LOCK(cs_seen);
+    mapSeenMasternodeBroadcast.Expire();
+    mapSeenMasternodePing.Expire();
 }
 
 void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    mapMasternodesByCollateral.clear();
+    mapMasternodesByCollateralPayee.clear();
+    mapMasternodesByPubKey.clear();
+    mapMasternodesByStealthAddress.clear();
+    ClearScoresCache();
+    fSnapshotDirty = true;
+    nListVersion++;
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
-    mapSeenMasternodeBroadcast.clear();
-    mapSeenMasternodePing.clear();
+    {
+        LOCK(cs_seen);
+        mapSeenMasternodeBroadcast.clear();
+        mapSeenMasternodePing.clear();
+    }
     nDsqCount = 0;
 }
 
@@ -440,37 +565,30 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
 CMasternode* CMasternodeMan::Find(const CScript& payee)
 {
     LOCK(cs);
-    CScript payee2;
-
-    for (CMasternode& mn : vMasternodes) {
-        payee2 = GetScriptForDestination(mn.pubKeyCollateralAddress);
-        if (payee2 == payee)
-            return &mn;
-    }
-    return NULL;
+    std::multimap<CScript, CMasternode*>::iterator it = mapMasternodesByCollateralPayee.find(payee);
+    return it == mapMasternodesByCollateralPayee.end() ? NULL : it->second;
 }
 
 CMasternode* CMasternodeMan::Find(const CTxIn& vin)
 {
     LOCK(cs);
-
-    for (CMasternode& mn : vMasternodes) {
-        if (mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    std::map<COutPoint, CMasternode*>::iterator it = mapMasternodesByCollateral.find(vin.prevout);
+    return it == mapMasternodesByCollateral.end() ? NULL : it->second;
 }
 
 
 CMasternode* CMasternodeMan::Find(const CPubKey& pubKeyMasternode)
 {
     LOCK(cs);
+    std::multimap<CPubKey, CMasternode*>::iterator it = mapMasternodesByPubKey.find(pubKeyMasternode);
+    return it == mapMasternodesByPubKey.end() ? NULL : it->second;
+}
 
-    for (CMasternode& mn : vMasternodes) {
-        if (mn.pubKeyMasternode == pubKeyMasternode)
-            return &mn;
-    }
-    return NULL;
+CMasternode* CMasternodeMan::Find(const std::vector<unsigned char>& masternodeStealthAddress)
+{
+    LOCK(cs);
+    std::multimap<std::vector<unsigned char>, CMasternode*>::iterator it = mapMasternodesByStealthAddress.find(masternodeStealthAddress);
+    return it == mapMasternodesByStealthAddress.end() ? NULL : it->second;
 }
 
 //
@@ -478,7 +596,8 @@ CMasternode* CMasternodeMan::Find(const CPubKey& pubKeyMasternode)
 //
 CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount)
 {
-    LOCK(cs);
+    // input ages, scores and last payments read the chain, so cs_main goes first
+    LOCK2(cs_main, cs);
 
     CMasternode* pBestMasternode = NULL;
     std::vector<std::pair<int64_t, CTxIn> > vecMasternodeLastPaid;
@@ -504,7 +623,7 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
         //make sure it has as many confirmations as there are masternodes
         if (mn.GetMasternodeInputAge() < nMnCount) continue;
 
-        vecMasternodeLastPaid.push_back(std::make_pair(mn.SecondsSincePayment(), mn.vin));
+        vecMasternodeLastPaid.push_back(std::make_pair(mn.SecondsSincePayment(nMnCount), mn.vin));
     }
 
     nCount = (int)vecMasternodeLastPaid.size();
@@ -537,63 +656,100 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     return pBestMasternode;
 }
 
+void CMasternodeMan::PublishSnapshot(bool fForce)
+{
+    int64_t nNow = GetTime();
+    int nHeight = WITH_LOCK(cs_main, return chainActive.Height());
+    uint256 hashRankBlock;
+    if (!GetBlockHash(hashRankBlock, nHeight))
+        hashRankBlock = uint256();
+
+    std::shared_ptr<const CMasternodeListSnapshot> last = GetSnapshot();
+    if (!fForce && !fSnapshotDirty && nNow - last->nTime < MASTERNODES_SNAPSHOT_SECONDS && last->hashRankBlock == hashRankBlock)
+        return;
+    // Cleared before copying, so a change made meanwhile gets published next time
+    fSnapshotDirty = false;
+
+    std::shared_ptr<CMasternodeListSnapshot> next = std::make_shared<CMasternodeListSnapshot>();
+    next->nTime = nNow;
+    next->hashRankBlock = hashRankBlock;
+    {
+        // same order as GetNextMasternodeInQueueForPayment, cs_main is never locked while holding cs
+        LOCK2(cs_main, cs);
+        Check();
+        next->vMasternodes.assign(vMasternodes.begin(), vMasternodes.end());
+        next->vRanks.assign(vMasternodes.size(), 0);
+        if (!hashRankBlock.IsNull()) {
+            // enabled masternodes ranked by the scores cache, then matched to their place in the list
+            std::map<const CMasternode*, int> mapRanks;
+            for (const std::pair<int64_t, CMasternode*>& s : GetScores(hashRankBlock)) {
+                if (s.second->IsEnabled())
+                    mapRanks.insert(std::make_pair(s.second, (int)mapRanks.size() + 1));
+            }
+            size_t i = 0;
+            for (const CMasternode& mn : vMasternodes) {
+                std::map<const CMasternode*, int>::const_iterator it = mapRanks.find(&mn);
+                if (it != mapRanks.end())
+                    next->vRanks[i] = it->second;
+                i++;
+            }
+        }
+        next->nStable = stable_size();
+        next->nEnabled = CountEnabled();
+        CountNetworks(ActiveProtocol(), next->nIPv4, next->nIPv6, next->nOnion);
+        if (nHeight > 0)
+            GetNextMasternodeInQueueForPayment(nHeight, true, next->nInQueue);
+    }
+
+    LOCK(cs_snapshot);
+    snapshot = next;
+}
+
+std::shared_ptr<const CMasternodeListSnapshot> CMasternodeMan::GetSnapshot() const
+{
+    LOCK(cs_snapshot);
+    return snapshot;
+}
+
 CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight, int minProtocol)
 {
-    int64_t score = 0;
-    CMasternode* winner = NULL;
+    uint256 hash;
+    if (!GetBlockHash(hash, nBlockHeight)) return NULL;
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
+    LOCK(cs);
+
+    // scan for winner, highest score first
+    for (const std::pair<int64_t, CMasternode*>& s : GetScores(hash)) {
+        if (s.first <= 0) break;
+        CMasternode& mn = *s.second;
         mn.Check();
         if (mn.protocolVersion < minProtocol || !mn.IsEnabled()) continue;
-
-        // calculate the score for each Masternode
-        uint256 n = mn.CalculateScore(mod, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        // determine the winner
-        if (n2 > score) {
-            score = n2;
-            winner = &mn;
-        }
+        return &mn;
     }
 
-    return winner;
+    return NULL;
 }
 
 int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
-    int64_t nMasternode_Min_Age = MN_WINNER_MINIMUM_AGE;
-    int64_t nMasternode_Age = 0;
-
     //make sure we know about this block
     uint256 hash;
     if (!GetBlockHash(hash, nBlockHeight)) return -1;
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
-        if (mn.protocolVersion < minProtocol) {
-            LogPrint(BCLog::MASTERNODE,"Skipping Masternode with obsolete version %d\n", mn.protocolVersion);
-            continue;                                                       // Skip obsolete versions
-        }
+    LOCK(cs);
+
+    int rank = 0;
+    for (const std::pair<int64_t, CMasternode*>& s : GetScores(hash)) {
+        CMasternode& mn = *s.second;
+        if (mn.protocolVersion < minProtocol) continue; // Skip obsolete versions
 
         if (fOnlyActive) {
             mn.Check();
             if (!mn.IsEnabled()) continue;
         }
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(n2, mn.vin));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
 
-    int rank = 0;
-    for (PAIRTYPE(int64_t, CTxIn) & s : vecMasternodeScores) {
         rank++;
-        if (s.second.prevout == vin.prevout) {
+        if (mn.vin.prevout == vin.prevout) {
             return rank;
         }
     }
@@ -603,36 +759,35 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
 
 std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
 {
-    std::vector<std::pair<int64_t, CMasternode> > vecMasternodeScores;
     std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
 
     //make sure we know about this block
     uint256 hash;
     if (!GetBlockHash(hash, nBlockHeight)) return vecMasternodeRanks;
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
+    LOCK(cs);
+
+    // enabled masternodes by score, then the others
+    std::vector<CMasternode*> vecDisabled;
+    int rank = 0;
+    for (const std::pair<int64_t, CMasternode*>& s : GetScores(hash)) {
+        CMasternode& mn = *s.second;
         mn.Check();
 
         if (mn.protocolVersion < minProtocol) continue;
 
         if (!mn.IsEnabled()) {
-            vecMasternodeScores.push_back(std::make_pair(9999, mn));
+            vecDisabled.push_back(&mn);
             continue;
         }
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(n2, mn));
+        rank++;
+        vecMasternodeRanks.push_back(std::make_pair(rank, mn));
     }
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
-
-    int rank = 0;
-    for (PAIRTYPE(int64_t, CMasternode) & s : vecMasternodeScores) {
+    for (CMasternode* pmn : vecDisabled) {
         rank++;
-        vecMasternodeRanks.push_back(std::make_pair(rank, s.second));
+        vecMasternodeRanks.push_back(std::make_pair(rank, *pmn));
     }
 
     return vecMasternodeRanks;
@@ -640,35 +795,51 @@ std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
+    uint256 hash;
+    if (!GetBlockHash(hash, nBlockHeight)) return NULL;
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
+    LOCK(cs);
+
+    int rank = 0;
+    for (const std::pair<int64_t, CMasternode*>& s : GetScores(hash)) {
+        CMasternode& mn = *s.second;
         if (mn.protocolVersion < minProtocol) continue;
         if (fOnlyActive) {
             mn.Check();
             if (!mn.IsEnabled()) continue;
         }
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(n2, mn.vin));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
-
-    int rank = 0;
-    for (PAIRTYPE(int64_t, CTxIn) & s : vecMasternodeScores) {
         rank++;
         if (rank == nRank) {
-            return Find(s.second);
+            return &mn;
         }
     }
 
     return NULL;
 }
 
+std::vector<COutPoint> CMasternodeMan::GetTopMasternodes(int nCount, int64_t nBlockHeight, int minProtocol)
+{
+    std::vector<COutPoint> vecTop;
+
+    uint256 hash;
+    if (!GetBlockHash(hash, nBlockHeight)) return vecTop;
+
+    LOCK(cs);
+
+    for (const std::pair<int64_t, CMasternode*>& s : GetScores(hash)) {
+        if ((int)vecTop.size() >= nCount) break;
+        CMasternode& mn = *s.second;
+        if (mn.protocolVersion < minProtocol) continue;
+        mn.Check();
+        if (!mn.IsEnabled()) continue;
+
+        vecTop.push_back(mn.vin.prevout);
+    }
+
+    return vecTop;
+}
+
 void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
     if (fLiteMode) return; //disable all Masternode related functionality
@@ -679,11 +850,14 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         CMasternodeBroadcast mnb;
         vRecv >> mnb;
 
-        if (mapSeenMasternodeBroadcast.count(mnb.GetHash())) { //seen
-            masternodeSync.AddedMasternodeList(mnb.GetHash());
-            return;
+        {
+            LOCK(cs_seen);
+            if (mapSeenMasternodeBroadcast.count(mnb.GetHash())) { //seen
+                masternodeSync.AddedMasternodeList(mnb.GetHash());
+                return;
+            }
+            mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
         }
-        mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
 
         int nDoS = 0;
         if (!mnb.CheckAndUpdate(nDoS)) {
@@ -726,8 +900,11 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         LogPrint(BCLog::MNPING, "mnp - Masternode ping, vin: %s\n", mnp.vin.prevout.hash.ToString());
 
-        if (mapSeenMasternodePing.count(mnp.GetHash())) return; //seen
-        mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+        {
+            LOCK(cs_seen);
+            if (mapSeenMasternodePing.count(mnp.GetHash())) return; //seen
+            mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+        }
 
         int nDoS = 0;
         if (mnp.CheckAndUpdate(nDoS)) return;
@@ -784,7 +961,10 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                     pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
                     nInvCount++;
 
-                    if (!mapSeenMasternodeBroadcast.count(hash)) mapSeenMasternodeBroadcast.insert(std::make_pair(hash, mnb));
+                    {
+                        LOCK(cs_seen);
+                        if (!mapSeenMasternodeBroadcast.count(hash)) mapSeenMasternodeBroadcast.insert(std::make_pair(hash, mnb));
+                    }
 
                     if (vin == mn.vin) {
                         LogPrint(BCLog::MASTERNODE, "dseg - Sent 1 Masternode entry to peer %i\n", pfrom->GetId());
@@ -805,11 +985,11 @@ void CMasternodeMan::Remove(CTxIn vin)
 {
     LOCK(cs);
 
-    std::vector<CMasternode>::iterator it = vMasternodes.begin();
+    std::list<CMasternode>::iterator it = vMasternodes.begin();
     while (it != vMasternodes.end()) {
         if ((*it).vin == vin) {
             LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
-            vMasternodes.erase(it);
+            Erase(it);
             break;
         }
         ++it;
@@ -819,8 +999,11 @@ void CMasternodeMan::Remove(CTxIn vin)
 void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
 {
     LOCK(cs);
-    mapSeenMasternodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
-    mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
+    {
+        LOCK(cs_seen);
+        mapSeenMasternodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
+        mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
+    }
 
     LogPrint(BCLog::MASTERNODE,"CMasternodeMan::UpdateMasternodeList -- masternode=%s\n", mnb.vin.prevout.ToStringShort());
 
@@ -830,11 +1013,24 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         if (Add(mn)) {
             masternodeSync.AddedMasternodeList(mnb.GetHash());
         }
-    } else if (pmn->UpdateFromNewBroadcast(mnb)) {
+    } else if (UpdateFromNewBroadcast(*pmn, mnb)) {
         masternodeSync.AddedMasternodeList(mnb.GetHash());
     }
 }
 
+bool CMasternodeMan::UpdateFromNewBroadcast(CMasternode& mn, CMasternodeBroadcast& mnb)
+{
+    LOCK(cs);
+    RemoveFromIndexes(mn);
+    bool fUpdated = mn.UpdateFromNewBroadcast(mnb);
+    AddToIndexes(mn);
+    if (fUpdated) {
+        fSnapshotDirty = true;
+        journal.Append(JOURNAL_MASTERNODE, mn);
+    }
+    return fUpdated;
+}
+
 std::string CMasternodeMan::ToString() const
 {
     std::ostringstream info;
@@ -860,6 +1056,8 @@ void ThreadCheckMasternodes()
         // try to sync from all available nodes, one step at a time
         masternodeSync.Process();
 
+        mnodeman.PublishSnapshot();
+
         if (masternodeSync.IsBlockchainSynced()) {
             c++;
 
@@ -872,6 +1070,18 @@ void ThreadCheckMasternodes()
                 masternodePayments.CleanPaymentList();
                 CleanTransactionLocksList();
             }
+
+            // checkpoint the caches the journals have grown on, which also compacts them
+            const bool fDumpTime = c % MASTERNODES_DUMP_SECONDS == 0;
+            size_t nJournalSize = mnodeman.journal.GetSize();
+            if (nJournalSize >= CACHE_JOURNAL_MAX_BYTES || (fDumpTime && nJournalSize > 0))
+                DumpMasternodes();
+            nJournalSize = budget.journal.GetSize();
+            if (nJournalSize >= CACHE_JOURNAL_MAX_BYTES || (fDumpTime && nJournalSize > 0))
+                DumpBudgets();
+            nJournalSize = masternodePayments.journal.GetSize();
+            if (nJournalSize >= CACHE_JOURNAL_MAX_BYTES || (fDumpTime && nJournalSize > 0))
+                DumpMasternodePayments();
         }
     }
 }
@@ -9,15 +9,26 @@
 
 #include "activemasternode.h"
 #include "base58.h"
+#include "cachejournal.h"
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
 #include "net.h"
+#include "seencache.h"
 #include "sync.h"
 #include "util.h"
 
+#include <atomic>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
+#define MASTERNODES_SCORES_CACHE_SIZE 32
+#define MASTERNODES_SNAPSHOT_SECONDS 5
+#define MASTERNODES_SEEN_MAX_BYTES (32 * 1024 * 1024)
 
 
 class CMasternodeMan;
@@ -49,57 +60,151 @@ public:
     };
 
     CMasternodeDB();
-    bool Write(const CMasternodeMan& mnodemanToSave);
+    /** The file with its header and checksum, serialized under the locks appends to the journal take */
+    void Serialize(const CMasternodeMan& mnodemanToSave, CDataStream& ssMasternodes);
+    /** Write what Serialize produced and rename it into place, without holding any lock */
+    bool Write(const CDataStream& ssMasternodes);
     ReadResult Read(CMasternodeMan& mnodemanToLoad, bool fDryRun = false);
 };
 
+/** Immutable copy of the masternode list and its counts, for readers that must not wait on CMasternodeMan::cs
+ */
+class CMasternodeListSnapshot
+{
+public:
+    std::vector<CMasternode> vMasternodes;
+    // rank of each entry of vMasternodes at hashRankBlock, 0 if it is not enabled
+    std::vector<int> vRanks;
+    uint256 hashRankBlock;
+    int nStable;
+    int nEnabled;
+    int nInQueue;
+    int nIPv4;
+    int nIPv6;
+    int nOnion;
+    int64_t nTime;
+
+    CMasternodeListSnapshot() : nStable(0), nEnabled(0), nInQueue(0), nIPv4(0), nIPv6(0), nOnion(0), nTime(0) {}
+};
+
 class CMasternodeMan
 {
 private:
-    // critical section to protect the inner data structures
-    mutable RecursiveMutex cs;
-
     // critical section to protect the inner data structures specifically on messaging
     mutable RecursiveMutex cs_process_message;
 
-    // map to hold all MNs
-    std::vector<CMasternode> vMasternodes;
+    // list to hold all MNs, entries keep their address for the indexes below and for callers holding a CMasternode*
+    std::list<CMasternode> vMasternodes;
+    // indexes into vMasternodes, kept up to date by AddToIndexes and RemoveFromIndexes
+    std::map<COutPoint, CMasternode*> mapMasternodesByCollateral;
+    std::multimap<CScript, CMasternode*> mapMasternodesByCollateralPayee;
+    std::multimap<CPubKey, CMasternode*> mapMasternodesByPubKey;
+    std::multimap<std::vector<unsigned char>, CMasternode*> mapMasternodesByStealthAddress;
     // who's asked for the Masternode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForMasternodeList;
     // who we asked for the Masternode list and the last time
     std::map<CNetAddr, int64_t> mWeAskedForMasternodeList;
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
+    // scores of every listed MN by block hash, highest first, dropped whenever an MN is added or removed
+    std::map<uint256, std::vector<std::pair<int64_t, CMasternode*> > > mapScoresCache;
+    std::deque<uint256> vScoresCacheOrder;
+    // last published copy of the list, cs_snapshot only guards swapping the pointer
+    mutable Mutex cs_snapshot;
+    std::shared_ptr<const CMasternodeListSnapshot> snapshot;
+    // set when an entry is added, removed or updated since the last publish
+    std::atomic<bool> fSnapshotDirty;
+    // bumped whenever an entry is added or removed
+    std::atomic<uint64_t> nListVersion;
+
+    void AddToIndexes(CMasternode& mn);
+    void RemoveFromIndexes(CMasternode& mn);
+    std::list<CMasternode>::iterator Erase(std::list<CMasternode>::iterator it);
+    void ClearScoresCache();
+    const std::vector<std::pair<int64_t, CMasternode*> >& GetScores(const uint256& hashBlock);
 
 public:
-    // Keep track of all broadcasts I've seen
-    std::map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
+    // critical section to protect the inner data structures
+    // taken under cs_main by block creation and validation, so cs_main is never locked while holding it
+    mutable RecursiveMutex cs;
+    // guards the seen maps below, nothing else is locked while holding it
+    mutable RecursiveMutex cs_seen;
+
+    // Keep track of all broadcasts I've seen, touched whenever their masternode pings
+    CSeenCache<CMasternodeBroadcast> mapSeenMasternodeBroadcast;
     // Keep track of all pings I've seen
-    std::map<uint256, CMasternodePing> mapSeenMasternodePing;
+    CSeenCache<CMasternodePing> mapSeenMasternodePing;
+
+    // Masternodes added or updated and pings accepted since mncache.dat was written
+    enum JournalRecord {
+        JOURNAL_MASTERNODE = 1,
+        JOURNAL_PING = 2
+    };
+    CCacheJournal journal;
 
     // keep track of dsq count to prevent masternodes from gaming obfuscation queue
     // TODO: Remove this from serialization
     int64_t nDsqCount;
 
-    ADD_SERIALIZE_METHODS;
+    size_t GetSerializeSize(int nType, int nVersion) const
+    {
+        CSizeComputer s(nType, nVersion);
+        Serialize(s, nType, nVersion);
+        return s.size();
+    }
+
+    // Same layout as when the masternodes were kept in a std::vector<CMasternode>, so mncache.dat stays readable
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        LOCK(cs);
+        WriteCompactSize(s, vMasternodes.size());
+        for (const CMasternode& mn : vMasternodes)
+            ::Serialize(s, mn, nType, nVersion);
+        ::Serialize(s, mAskedUsForMasternodeList, nType, nVersion);
+        ::Serialize(s, mWeAskedForMasternodeList, nType, nVersion);
+        ::Serialize(s, mWeAskedForMasternodeListEntry, nType, nVersion);
+        ::Serialize(s, nDsqCount, nType, nVersion);
+
+        LOCK(cs_seen);
+        ::Serialize(s, mapSeenMasternodeBroadcast, nType, nVersion);
+        ::Serialize(s, mapSeenMasternodePing, nType, nVersion);
+    }
 
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
     {
         LOCK(cs);
-        READWRITE(vMasternodes);
-        READWRITE(mAskedUsForMasternodeList);
-        READWRITE(mWeAskedForMasternodeList);
-        READWRITE(mWeAskedForMasternodeListEntry);
-        READWRITE(nDsqCount);
-
-        READWRITE(mapSeenMasternodeBroadcast);
-        READWRITE(mapSeenMasternodePing);
+        vMasternodes.clear();
+        mapMasternodesByCollateral.clear();
+        mapMasternodesByCollateralPayee.clear();
+        mapMasternodesByPubKey.clear();
+        mapMasternodesByStealthAddress.clear();
+        ClearScoresCache();
+        fSnapshotDirty = true;
+        nListVersion++;
+        uint64_t nMasternodes = ReadCompactSize(s);
+        for (uint64_t i = 0; i < nMasternodes; i++) {
+            vMasternodes.push_back(CMasternode());
+            ::Unserialize(s, vMasternodes.back(), nType, nVersion);
+            AddToIndexes(vMasternodes.back());
+        }
+        ::Unserialize(s, mAskedUsForMasternodeList, nType, nVersion);
+        ::Unserialize(s, mWeAskedForMasternodeList, nType, nVersion);
+        ::Unserialize(s, mWeAskedForMasternodeListEntry, nType, nVersion);
+        ::Unserialize(s, nDsqCount, nType, nVersion);
+
+        LOCK(cs_seen);
+        ::Unserialize(s, mapSeenMasternodeBroadcast, nType, nVersion);
+        ::Unserialize(s, mapSeenMasternodePing, nType, nVersion);
     }
 
     CMasternodeMan();
     CMasternodeMan(CMasternodeMan& other);
 
+    /// Replay mncache.journal on top of what was read from mncache.dat, and keep recording to it
+    void OpenJournal();
+
     /// Add an entry
     bool Add(CMasternode& mn);
 
@@ -125,6 +230,7 @@ public:
     CMasternode* Find(const CScript& payee);
     CMasternode* Find(const CTxIn& vin);
     CMasternode* Find(const CPubKey& pubKeyMasternode);
+    CMasternode* Find(const std::vector<unsigned char>& masternodeStealthAddress);
 
     /// Find an entry in the masternode list that is next to be paid
     CMasternode* GetNextMasternodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount);
@@ -135,18 +241,30 @@ public:
     std::vector<CMasternode> GetFullMasternodeVector()
     {
         Check();
-        return vMasternodes;
+        LOCK(cs);
+        return std::vector<CMasternode>(vMasternodes.begin(), vMasternodes.end());
     }
 
+    /// Copy the list for GetSnapshot readers, if it changed, the tip moved or the last copy is MASTERNODES_SNAPSHOT_SECONDS old
+    void PublishSnapshot(bool fForce = false);
+
+    /// Last published copy of the list, never waits for the list to be unlocked
+    std::shared_ptr<const CMasternodeListSnapshot> GetSnapshot() const;
+
     std::vector<std::pair<int, CMasternode> > GetMasternodeRanks(int64_t nBlockHeight, int minProtocol = 0);
     int GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
     CMasternode* GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
+    /// Collaterals of the nCount highest ranked enabled Masternodes, rank 1 first
+    std::vector<COutPoint> GetTopMasternodes(int nCount, int64_t nBlockHeight, int minProtocol = 0);
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
     /// Return the number of (unique) Masternodes
     int size() { return vMasternodes.size(); }
 
+    /// Changes whenever a masternode is added or removed, so checks that only depend on which are listed can be skipped
+    uint64_t GetListVersion() const { return nListVersion; }
+
     /// Return the number of Masternodes older than (default) 8000 seconds
     int stable_size ();
 
@@ -156,6 +274,9 @@ public:
 
     /// Update masternode list and maps using provided CMasternodeBroadcast
     void UpdateMasternodeList(CMasternodeBroadcast mnb);
+
+    /// Update a listed entry from a newer broadcast, keeping the indexes in sync with its new keys
+    bool UpdateFromNewBroadcast(CMasternode& mn, CMasternodeBroadcast& mnb);
 };
 
 void ThreadCheckMasternodes();
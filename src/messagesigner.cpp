@@ -7,9 +7,20 @@
 #include "hash.h"
 #include "main.h" // For strMessageMagic
 #include "messagesigner.h"
+#include "random.h"
+#include "sync.h"
 #include "tinyformat.h"
 #include "utilstrencodings.h"
 
+#include <map>
+
+/** Maximum number of recovered signatures remembered by CHashSigner::RecoverHash */
+static const size_t MAX_RECOVERED_SIGNATURES = 50000;
+
+static Mutex cs_recoveredSignatures;
+//! Key id that produced a compact signature, by hash of the signed hash and the signature
+static std::map<uint256, CKeyID> mapRecoveredSignatures;
+
 bool CMessageSigner::GetKeysFromSecret(const std::string& strSecret, CKey& keyRet, CPubKey& pubkeyRet)
 {
     CBitcoinSecret vchSecret;
@@ -37,12 +48,22 @@ bool CMessageSigner::VerifyMessage(const CPubKey& pubkey, const std::vector<unsi
 }
 
 bool CMessageSigner::VerifyMessage(const CKeyID& keyID, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet)
+{
+    return CHashSigner::VerifyHash(GetMessageHash(strMessage), keyID, vchSig, strErrorRet);
+}
+
+void CMessageSigner::PrecomputeMessage(const std::vector<unsigned char>& vchSig, const std::string& strMessage)
+{
+    CKeyID keyID;
+    CHashSigner::RecoverHash(GetMessageHash(strMessage), vchSig, keyID);
+}
+
+uint256 CMessageSigner::GetMessageHash(const std::string& strMessage)
 {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
-
-    return CHashSigner::VerifyHash(ss.GetHash(), keyID, vchSig, strErrorRet);
+    return ss.GetHash();
 }
 
 bool CHashSigner::SignHash(const uint256& hash, const CKey& key, std::vector<unsigned char>& vchSigRet)
@@ -57,18 +78,47 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey& pubkey, const s
 
 bool CHashSigner::VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
 {
-    CPubKey pubkeyFromSig;
-    if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
+    CKeyID keyIDFromSig;
+    if(!RecoverHash(hash, vchSig, keyIDFromSig)) {
         strErrorRet = "Error recovering public key.";
         return false;
     }
 
-    if(pubkeyFromSig.GetID() != keyID) {
+    if(keyIDFromSig != keyID) {
         strErrorRet = strprintf("Keys don't match: pubkey=%s, pubkeyFromSig=%s, hash=%s, vchSig=%s",
-                    keyID.ToString(), pubkeyFromSig.GetID().ToString(), hash.ToString(),
+                    keyID.ToString(), keyIDFromSig.ToString(), hash.ToString(),
                     EncodeBase64(&vchSig[0], vchSig.size()));
         return false;
     }
 
     return true;
 }
+
+bool CHashSigner::RecoverHash(const uint256& hash, const std::vector<unsigned char>& vchSig, CKeyID& keyIDRet)
+{
+    const uint256 entry = Hash(hash.begin(), hash.end(), vchSig.begin(), vchSig.end());
+    {
+        LOCK(cs_recoveredSignatures);
+        std::map<uint256, CKeyID>::const_iterator it = mapRecoveredSignatures.find(entry);
+        if (it != mapRecoveredSignatures.end()) {
+            keyIDRet = it->second;
+            return true;
+        }
+    }
+
+    CPubKey pubkeyFromSig;
+    if(!pubkeyFromSig.RecoverCompact(hash, vchSig))
+        return false;
+    keyIDRet = pubkeyFromSig.GetID();
+
+    LOCK(cs_recoveredSignatures);
+    if (mapRecoveredSignatures.size() >= MAX_RECOVERED_SIGNATURES) {
+        // Evict a random entry
+        std::map<uint256, CKeyID>::iterator it = mapRecoveredSignatures.lower_bound(GetRandHash());
+        if (it == mapRecoveredSignatures.end())
+            it = mapRecoveredSignatures.begin();
+        mapRecoveredSignatures.erase(it);
+    }
+    mapRecoveredSignatures.emplace(entry, keyIDRet);
+    return true;
+}
@@ -7,6 +7,7 @@
 #define MESSAGESIGNER_H
 
 #include "key.h"
+#include "pubkey.h"
 
 /** Helper class for signing messages and checking their signatures
  */
@@ -21,6 +22,11 @@ public:
     static bool VerifyMessage(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet);
     /// Verify the message signature, returns true if succcessful
     static bool VerifyMessage(const CKeyID& keyID, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet);
+    /// Recover the signer of the message ahead of time, so that verifying it later is a cache lookup
+    static void PrecomputeMessage(const std::vector<unsigned char>& vchSig, const std::string& strMessage);
+
+private:
+    static uint256 GetMessageHash(const std::string& strMessage);
 };
 
 /** Helper class for signing hashes and checking their signatures
@@ -34,6 +40,8 @@ public:
     static bool VerifyHash(const uint256& hash, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
     /// Verify the hash signature, returns true if succcessful
     static bool VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
+    /// Recover the key id that signed the hash, using the cache of recovered signatures
+    static bool RecoverHash(const uint256& hash, const std::vector<unsigned char>& vchSig, CKeyID& keyIDRet);
 };
 
 #endif
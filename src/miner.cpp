@@ -32,8 +32,9 @@ extern CWallet* pwalletMain;
 #include "masternode-payments.h"
 #include "validationinterface.h"
 
+#include <atomic>
+
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple.hpp>
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -41,55 +42,187 @@ extern CWallet* pwalletMain;
 // PRCYcoinMiner
 //
 
-//
-// Unconfirmed transactions in the memory pool often depend on other
-// transactions in the memory pool. When we select transactions from the
-// pool, we select by highest priority or fee rate, so we might consider
-// transactions that depend on transactions that aren't yet in the block.
-// The COrphan class keeps track of these 'temporary orphans' while
-// CreateBlock is figuring out which transactions to include.
-//
-class COrphan
-{
-public:
-    const CTransaction* ptx;
-    std::set<uint256> setDependsOn;
-    CFeeRate feeRate;
-    double dPriority;
-
-    COrphan(const CTransaction* ptxIn) : ptx(ptxIn), feeRate(0), dPriority(0)
-    {
-    }
-};
-
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockSize = 0;
 int64_t nLastCoinStakeSearchInterval = 0;
 int64_t nDefaultMinerSleep = 0;
 //int64_t nConsolidationTime = 0;
 
-// We want to sort transactions by priority and fee rate, so:
-typedef boost::tuple<double, CFeeRate, const CTransaction*> TxPriority;
-class TxPriorityCompare
+void CBlockTemplateCandidates::AddCandidate(const uint256& hash, unsigned int nTxSize, CAmount nFee, const CFeeRate& feeRate)
 {
-    bool byFee;
+    CCandidate& candidate = mapCandidates[hash];
+    candidate.nTxSize = nTxSize;
+    candidate.nFee = nFee;
+    candidate.feeRate = feeRate;
+    setByFeeRate.insert(std::make_pair(feeRate, hash));
+}
 
-public:
-    TxPriorityCompare(bool _byFee) : byFee(_byFee) {}
+void CBlockTemplateCandidates::EraseCandidate(std::map<uint256, CCandidate>::iterator it)
+{
+    setByFeeRate.erase(std::make_pair(it->second.feeRate, it->first));
+    mapCandidates.erase(it);
+}
 
-    bool operator()(const TxPriority& a, const TxPriority& b)
-    {
-        if (byFee) {
-            if (a.get<1>() == b.get<1>())
-                return a.get<0>() < b.get<0>();
-            return a.get<1>() < b.get<1>();
+bool CBlockTemplateCandidates::CheckCandidate(const CTransaction& tx, CCoinsViewCache& view)
+{
+    if (tx.IsCoinBase() || tx.IsCoinStake())
+        return false;
+    // Check key images not duplicated with what in db
+    for (const CTxIn& txin : tx.vin) {
+        if (IsSpentKeyImage(txin.keyImage.GetHex(), UINT256_ZERO))
+            return false;
+        //Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
+        if (invalid_out::ContainsOutPoint(txin.prevout)) {
+            LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
+            return false;
+        }
+    }
+    if (!CheckHaveInputs(view, tx))
+        return false;
+
+    // Note that flags: we don't want to set mempool/IsStandard()
+    // policy here, but we still have to ensure that the block we
+    // create only contains transactions that are valid in new blocks.
+    CValidationState state;
+    return CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true);
+}
+
+void CBlockTemplateCandidates::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+{
+    LOCK(cs);
+    const uint256 hash = tx.GetHash();
+    if (pblock) {
+        // Confirmed
+        std::map<uint256, CCandidate>::iterator it = mapCandidates.find(hash);
+        if (it != mapCandidates.end())
+            EraseCandidate(it);
+        setRejected.erase(hash);
+        setPending.erase(hash);
+    } else {
+        // Accepted to the pool, or resurrected from a disconnected block
+        setPending.insert(hash);
+    }
+}
+
+void CBlockTemplateCandidates::Update()
+{
+    if (!fRegistered.exchange(true))
+        RegisterValidationInterface(this);
+
+    LOCK2(cs_main, mempool.cs);
+    LOCK(cs);
+    CBlockIndex* pindexTip = chainActive.Tip();
+    if (pindexTip->GetBlockHash() != hashTip) {
+        if (pindexTip->pprev && pindexTip->pprev->GetBlockHash() == hashTip) {
+            setPending.insert(setRejected.begin(), setRejected.end());
+            for (std::map<uint256, CCandidate>::iterator it = mapCandidates.begin(); it != mapCandidates.end();) {
+                if (mempool.mapTx.count(it->first))
+                    ++it;
+                else
+                    EraseCandidate(it++);
+            }
         } else {
-            if (a.get<0>() == b.get<0>())
-                return a.get<1>() < b.get<1>();
-            return a.get<0>() < b.get<0>();
+            mapCandidates.clear();
+            setByFeeRate.clear();
+            setPending.clear();
+            for (std::map<uint256, CTxMemPoolEntry>::const_iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
+                setPending.insert(mi->first);
+        }
+        setRejected.clear();
+        hashTip = pindexTip->GetBlockHash();
+    }
+    if (setPending.empty())
+        return;
+
+    CCoinsViewCache view(pcoinsTip);
+    for (const uint256& hash : setPending) {
+        std::map<uint256, CTxMemPoolEntry>::const_iterator mi = mempool.mapTx.find(hash);
+        if (mi == mempool.mapTx.end() || mapCandidates.count(hash))
+            continue;
+        const CTransaction& tx = mi->second.GetTx();
+        if (!CheckCandidate(tx, view)) {
+            setRejected.insert(hash);
+            continue;
+        }
+        double dPriorityDelta = 0;
+        CAmount nFeeDelta = 0;
+        mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
+        const unsigned int nTxSize = mi->second.GetTxSize();
+        AddCandidate(hash, nTxSize, tx.nTxFee, CFeeRate(tx.nTxFee + nFeeDelta, nTxSize));
+    }
+    setPending.clear();
+}
+
+void CBlockTemplateCandidates::Select(int nHeight, unsigned int nBlockMaxSize, unsigned int nBlockMinSize, unsigned int nBlockPrioritySize,
+    CBlockTemplate* pblocktemplate, uint64_t& nBlockSize, uint64_t& nBlockTx, CAmount& nFees)
+{
+    AssertLockHeld(mempool.cs);
+    LOCK(cs);
+    bool fPrintPriority = GetBoolArg("-printpriority", false);
+    bool fSortedByFee = (nBlockPrioritySize <= 0);
+    const CFeeRate customMinRelayTxFee = CFeeRate(5000);
+
+    LogPrint(BCLog::STAKING, "Selecting from %d transactions\n", setByFeeRate.size());
+    // Candidates that left the pool, erased once done walking setByFeeRate
+    std::vector<uint256> vStale;
+    for (std::set<std::pair<CFeeRate, uint256> >::reverse_iterator it = setByFeeRate.rbegin(); it != setByFeeRate.rend(); ++it) {
+        const uint256& hash = it->second;
+        const CFeeRate& feeRate = it->first;
+        std::map<uint256, CCandidate>::const_iterator itCandidate = mapCandidates.find(hash);
+        if (itCandidate == mapCandidates.end())
+            continue;
+        const CCandidate& candidate = itCandidate->second;
+
+        // Size limits
+        const unsigned int nTxSize = candidate.nTxSize;
+        if (nBlockSize + nTxSize >= nBlockMaxSize)
+            continue;
+
+        // Skip free transactions if we're past the minimum block size:
+        if (fSortedByFee && (feeRate < customMinRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+            continue;
+
+        // Prioritise by fee once past the priority size
+        if (!fSortedByFee && (nBlockSize + nTxSize >= nBlockPrioritySize))
+            fSortedByFee = true;
+
+        CTransaction tx;
+        if (!mempool.lookup(hash, tx)) {
+            // Evicted or conflicted since it was checked
+            vStale.push_back(hash);
+            continue;
+        }
+        if (!IsFinalTx(tx, nHeight))
+            continue;
+
+        // Added
+        const CAmount nTxFees = candidate.nFee;
+        pblocktemplate->block.vtx.push_back(tx);
+        pblocktemplate->vTxFees.push_back(nTxFees);
+        pblocktemplate->vTxSigOps.push_back(0);
+        nBlockSize += nTxSize;
+        ++nBlockTx;
+        nFees += nTxFees;
+
+        if (fPrintPriority) {
+            LogPrintf("fee %s txid %s\n", feeRate.ToString(), hash.ToString());
         }
     }
-};
+
+    for (const uint256& hash : vStale) {
+        std::map<uint256, CCandidate>::iterator it = mapCandidates.find(hash);
+        if (it != mapCandidates.end())
+            EraseCandidate(it);
+    }
+}
+
+size_t CBlockTemplateCandidates::size()
+{
+    LOCK(cs);
+    return mapCandidates.size();
+}
+
+static CBlockTemplateCandidates blockTemplateCandidates;
 
 void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
 {
@@ -256,161 +389,12 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, const CPubKey& txP
 
         CBlockIndex* pindexPrev = chainActive.Tip();
         const int nHeight = pindexPrev->nHeight + 1;
-        CCoinsViewCache view(pcoinsTip);
-
-        // Priority order to process transactions
-        std::list<COrphan> vOrphan; // list memory doesn't move
-        std::map<uint256, std::vector<COrphan*> > mapDependers;
-        bool fPrintPriority = GetBoolArg("-printpriority", false);
-
-        // This vector will be sorted into a priority queue:
-        std::vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.mapTx.size());
-        std::set<CKeyImage> keyImages;
-        for (std::map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
-             mi != mempool.mapTx.end(); ++mi) {
-            const CTransaction& tx = mi->second.GetTx();
-            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight)) {
-                continue;
-            }
-            bool fKeyImageCheck = true;
-            // Check key images not duplicated with what in db
-            for (const CTxIn& txin : tx.vin) {
-                const CKeyImage& keyImage = txin.keyImage;
-                if (IsSpentKeyImage(keyImage.GetHex(), UINT256_ZERO)) {
-                    fKeyImageCheck = false;
-                    break;
-                }
-                //Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
-                if (invalid_out::ContainsOutPoint(txin.prevout)) {
-                    LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
-                    break;
-                }
-            }
 
-            if (!fKeyImageCheck) {
-                continue;
-            }
-
-            if (!CheckHaveInputs(view, tx)) continue;
-
-            COrphan* porphan = NULL;
-            double dPriority = 0;
-            CAmount nTotalIn = 0;
-
-            // Priority is sum(valuein * age) / modified_txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority = GetPriority(tx, chainActive.Height());
-
-            uint256 hash = tx.GetHash();
-            mempool.ApplyDeltas(hash, dPriority, nTotalIn);
-
-            CFeeRate feeRate(tx.nTxFee, nTxSize);
-
-            bool isDuplicate = false;
-            for (const CTxIn& txin : tx.vin) {
-                const CKeyImage& keyImage = txin.keyImage;
-                if (keyImages.count(keyImage)) {
-                    isDuplicate = true;
-                    break;
-                }
-                keyImages.insert(keyImage);
-            }
-            if (isDuplicate) continue;
-            vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->second.GetTx()));
-        }
-
-        LogPrint(BCLog::STAKING, "Selecting %d transactions from mempool\n", vecPriority.size());
         // Collect transactions into block
         uint64_t nBlockSize = 1000;
         uint64_t nBlockTx = 0;
-        int nBlockSigOps = 100;
-        bool fSortedByFee = (nBlockPrioritySize <= 0);
-
-        TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-        std::vector<CBigNum> vBlockSerials;
-        std::vector<CBigNum> vTxSerials;
-        while (!vecPriority.empty()) {
-            // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransaction& tx = *(vecPriority.front().get<2>());
-
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
-
-            // Size limits
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            if (nBlockSize + nTxSize >= nBlockMaxSize)
-                continue;
-
-            // Skip free transactions if we're past the minimum block size:
-            const uint256& hash = tx.GetHash();
-            double dPriorityDelta = 0;
-            CAmount nFeeDelta = 0;
-            mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-            CFeeRate customMinRelayTxFee = CFeeRate(5000);
-            if (fSortedByFee && (feeRate < customMinRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
-                continue;
-
-            // Prioritise by fee once past the priority size or we run out of high-priority
-            // transactions:
-            if (!fSortedByFee &&
-                ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
-                fSortedByFee = true;
-                comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            }
-
-            if (!CheckHaveInputs(view, tx))
-                continue;
-
-            CAmount nTxFees = tx.nTxFee;
-
-            // Note that flags: we don't want to set mempool/IsStandard()
-            // policy here, but we still have to ensure that the block we
-            // create only contains transactions that are valid in new blocks.
-
-            CValidationState state;
-            if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
-                continue;
-
-            CTxUndo txundo;
-            if (tx.IsCoinStake()) {
-                UpdateCoins(tx, view, txundo, nHeight);
-            }
-
-            // Added
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOps.push_back(0);
-            nBlockSize += nTxSize;
-            ++nBlockTx;
-            nFees += nTxFees;
-
-            for (const CBigNum& bnSerial : vTxSerials)
-                vBlockSerials.emplace_back(bnSerial);
-
-            if (fPrintPriority) {
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                    dPriority, feeRate.ToString(), tx.GetHash().ToString());
-            }
-
-            // Add transactions that depend on this one to the priority queue
-            if (mapDependers.count(hash)) {
-                for (COrphan* porphan : mapDependers[hash]) {
-                    if (!porphan->setDependsOn.empty()) {
-                        porphan->setDependsOn.erase(hash);
-                        if (porphan->setDependsOn.empty()) {
-                            vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                        }
-                    }
-                }
-            }
-        }
+        blockTemplateCandidates.Update();
+        blockTemplateCandidates.Select(nHeight, nBlockMaxSize, nBlockMinSize, nBlockPrioritySize, pblocktemplate.get(), nBlockSize, nBlockTx, nFees);
 
         if (!fProofOfStake) {
             //Masternode and general budget payments
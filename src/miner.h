@@ -6,20 +6,78 @@
 #ifndef BITCOIN_MINER_H
 #define BITCOIN_MINER_H
 
+#include "amount.h"
 #include "primitives/block.h"
+#include "sync.h"
+#include "validationinterface.h"
 
+#include <atomic>
+#include <map>
+#include <set>
 #include <stdint.h>
 #include "key.h"
 
 class CBlock;
 class CBlockHeader;
 class CBlockIndex;
+class CCoinsViewCache;
 class CReserveKey;
 class CScript;
 class CWallet;
 
 struct CBlockTemplate;
 
+/**
+ * Mempool transactions ready to be mined on top of the current tip, kept
+ * between CreateNewBlock calls.
+ *
+ * Every transaction is checked against the tip once (key images, ring members,
+ * inputs) when it enters the pool, and kept with its cached size and fee rate
+ * in a fee rate ordered set. Transactions leaving the pool are dropped lazily,
+ * rejected transactions are rechecked when the tip moves on (ring members may
+ * have matured), and everything is rechecked after a reorganization.
+ *
+ * All ring transactions share the same priority, so the old priority-then-fee
+ * ordering reduces to ordering by fee rate.
+ */
+class CBlockTemplateCandidates : public CValidationInterface
+{
+protected:
+    struct CCandidate {
+        unsigned int nTxSize;
+        CAmount nFee;
+        CFeeRate feeRate;
+    };
+
+    Mutex cs;
+    std::atomic<bool> fRegistered;
+    //! Tip the candidates were checked against
+    uint256 hashTip;
+    std::map<uint256, CCandidate> mapCandidates;
+    //! Candidates ordered by fee rate (including prioritisetransaction deltas), lowest first
+    std::set<std::pair<CFeeRate, uint256> > setByFeeRate;
+    //! Pool transactions not minable at hashTip
+    std::set<uint256> setRejected;
+    //! Pool transactions not checked yet
+    std::set<uint256> setPending;
+
+    void AddCandidate(const uint256& hash, unsigned int nTxSize, CAmount nFee, const CFeeRate& feeRate);
+    void EraseCandidate(std::map<uint256, CCandidate>::iterator it);
+    bool CheckCandidate(const CTransaction& tx, CCoinsViewCache& view);
+
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+
+public:
+    CBlockTemplateCandidates() : fRegistered(false) {}
+
+    /** Bring the candidates up to date with the mempool and the tip */
+    void Update();
+    /** Fill pblocktemplate with the best candidates, highest fee rate first. Requires mempool.cs. */
+    void Select(int nHeight, unsigned int nBlockMaxSize, unsigned int nBlockMinSize, unsigned int nBlockPrioritySize,
+        CBlockTemplate* pblocktemplate, uint64_t& nBlockSize, uint64_t& nBlockTx, CAmount& nFees);
+    size_t size();
+};
+
 /** Generate a new block, without valid proof-of-work */
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, const CPubKey& txPub, const CKey& txPriv, CWallet* pwallet, bool fProofOfStake);
 
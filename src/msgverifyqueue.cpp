@@ -0,0 +1,20 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "msgverifyqueue.h"
+
+#include "protocol.h"
+
+CMessageVerifyQueue msgVerifyQueue;
+
+bool CMessageVerifyQueue::IsVerifiedAhead(const std::string& strCommand)
+{
+    return strCommand == NetMsgType::MNBROADCAST ||
+           strCommand == NetMsgType::MNPING ||
+           strCommand == NetMsgType::MNWINNER ||
+           strCommand == NetMsgType::BUDGETVOTE ||
+           strCommand == NetMsgType::FINALBUDGETVOTE ||
+           strCommand == NetMsgType::IX ||
+           strCommand == NetMsgType::IXLOCKVOTE;
+}
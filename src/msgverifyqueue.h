@@ -0,0 +1,67 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRCY_MSGVERIFYQUEUE_H
+#define PRCY_MSGVERIFYQUEUE_H
+
+#include "hash.h"
+#include "peerqueue.h"
+#include "streams.h"
+#include "version.h"
+
+#include <set>
+#include <string>
+
+/** -msgverifythreads default (number of masternode, budget and SwiftTX message verification threads, 0 = disabled) */
+static const int DEFAULT_MSGVERIFY_THREADS = 2;
+/** Maximum number of message verification threads allowed */
+static const int MAX_MSGVERIFY_THREADS = 16;
+/** Maximum number of messages waiting for verification per peer */
+static const unsigned int MAX_MSGVERIFY_QUEUE_PER_PEER = 1000;
+
+/** A received message waiting for verification */
+class CQueuedMessage
+{
+public:
+    std::string strCommand;
+    CDataStream vRecv;
+    //! Hash of the command and payload, the same message relayed by several peers is verified once
+    uint256 hash;
+
+    CQueuedMessage() : vRecv(SER_NETWORK, PROTOCOL_VERSION) {}
+    CQueuedMessage(const std::string& strCommandIn, const CDataStream& vRecvIn) : strCommand(strCommandIn), vRecv(vRecvIn)
+    {
+        hash = Hash(strCommand.begin(), strCommand.end(), vRecv.begin(), vRecv.end());
+    }
+};
+
+/**
+ * Masternode, budget and SwiftTX messages are handed to this queue as soon
+ * as they are complete. Worker threads check their signatures and proofs
+ * ahead of the message handler, which still processes every message in
+ * order and applies its state changes under the usual locks, but finds the
+ * expensive checks already done. A message already queued by another peer
+ * is not queued again.
+ */
+class CMessageVerifyQueue : public CPeerQueue<CQueuedMessage>
+{
+public:
+    CMessageVerifyQueue() : CPeerQueue<CQueuedMessage>(MAX_MSGVERIFY_QUEUE_PER_PEER) {}
+
+    /** Whether messages of type strCommand are verified ahead of processing */
+    static bool IsVerifiedAhead(const std::string& strCommand);
+
+protected:
+    bool IsQueued(const CQueuedMessage& msg) const override { return setQueued.count(msg.hash); }
+    void Queued(const CQueuedMessage& msg) override { setQueued.insert(msg.hash); }
+    void Dequeued(const CQueuedMessage& msg) override { setQueued.erase(msg.hash); }
+
+private:
+    //! Messages queued or being verified
+    std::set<uint256> setQueued;
+};
+
+extern CMessageVerifyQueue msgVerifyQueue;
+
+#endif // PRCY_MSGVERIFYQUEUE_H
@@ -30,6 +30,10 @@
 
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/upnpcommands.h>
@@ -65,6 +69,10 @@
 namespace {
     const int MAX_OUTBOUND_CONNECTIONS = 16;
     const int MAX_FEELER_CONNECTIONS = 1;
+    //! Maximum number of socket events handled per epoll_wait call
+    const int MAX_SOCKET_EVENTS = 256;
+    //! Maximum number of reads from one socket per round, so a fast peer can't starve the others
+    const int MAX_SOCKET_RECV_ROUNDS = 16;
 
     struct ListenSocket {
         SOCKET socket;
@@ -113,6 +121,13 @@ RecursiveMutex cs_nLastNodeId;
 static CSemaphore *semOutbound = NULL;
 boost::condition_variable messageHandlerCondition;
 
+#ifdef HAVE_SYS_EPOLL_H
+//! epoll instance of the socket handler thread, -1 when select() is used
+static int hEpollFd = -1;
+//! Pipe used to wake the socket handler thread up from epoll_wait
+static int hWakeupPipe[2] = {-1, -1};
+#endif
+
 // Signals for message handling
 static CNodeSignals g_signals;
 
@@ -351,6 +366,43 @@ CNode *FindNode(const CService &addr) {
     return NULL;
 }
 
+/** True when sockets are waited on with select(), which can't handle descriptors >= FD_SETSIZE */
+static bool IsSelectBackend()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    return hEpollFd == -1;
+#else
+    return true;
+#endif
+}
+
+/** Watch a new node's socket for edge triggered read and write readiness */
+static void AddSocketEvents(CNode* pnode)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (hEpollFd == -1)
+        return;
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = pnode;
+    if (epoll_ctl(hEpollFd, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+        LogPrintf("%s: epoll_ctl failed for peer=%d: %s\n", __func__, pnode->id, NetworkErrorString(WSAGetLastError()));
+        pnode->CloseSocketDisconnect();
+    }
+#endif
+}
+
+void WakeupSocketHandler()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (hWakeupPipe[1] == -1)
+        return;
+    // A full pipe means a wakeup is pending already
+    char c = 0;
+    if (write(hWakeupPipe[1], &c, 1) != 1) {}
+#endif
+}
+
 CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool fCountFailure)
 {
     if (pszDest == NULL) {
@@ -376,7 +428,7 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool fCountFailure
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout,
                                       &proxyConnectionFailed) :
         ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed)) {
-        if (!IsSelectableSocket(hSocket)) {
+        if (IsSelectBackend() && !IsSelectableSocket(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -392,6 +444,7 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool fCountFailure
             LOCK(cs_vNodes);
             vNodes.push_back(pnode);
         }
+        AddSocketEvents(pnode);
 
         pnode->nServicesExpected = ServiceFlags(addrConnect.nServices & nRelevantServices);
         pnode->nTimeConnected = GetTime();
@@ -772,10 +825,10 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes) {
 
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode *pnode) {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    std::deque<CSerializeDataRef>::iterator it = pnode->vSendMsg.begin();
 
     while (it != pnode->vSendMsg.end()) {
-        const CSerializeData &data = *it;
+        const CSerializeData &data = **it;
         assert(data.size() > pnode->nSendOffset);
         int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset,
                           MSG_NOSIGNAL | MSG_DONTWAIT);
@@ -982,7 +1035,7 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket)) {
+    if (IsSelectBackend() && !IsSelectableSocket(hSocket)) {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
         return;
@@ -1013,7 +1066,185 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
+    AddSocketEvents(pnode);
+}
+
+// requires LOCK(cs_vRecvMsg)
+static bool CanReceive(CNode* pnode)
+{
+    return pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+           pnode->GetTotalRecvSize() <= ReceiveFloodSize();
+}
+
+/** Read once from the node's socket. Returns true if the read filled the buffer, so more data may be waiting. */
+// requires LOCK(cs_vRecvMsg)
+static bool SocketRecvData(CNode* pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    if (nBytes > 0) {
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+            pnode->CloseSocketDisconnect();
+        pnode->nLastRecv = GetTime();
+        pnode->nRecvBytes += nBytes;
+        pnode->RecordBytesRecv(nBytes);
+        return nBytes == (int)sizeof(pchBuf);
+    } else if (nBytes == 0) {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            LogPrint(BCLog::NET, "socket closed\n");
+        pnode->CloseSocketDisconnect();
+    } else if (nBytes < 0) {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR &&
+            nErr != WSAEINPROGRESS) {
+            if (!pnode->fDisconnect)
+                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+            pnode->CloseSocketDisconnect();
+        }
+    }
+    return false;
+}
+
+static void InactivityCheck(CNode* pnode)
+{
+    int64_t nTime = GetTime();
+    if (nTime - pnode->nTimeConnected > 60) {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+            LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0,
+                     pnode->nLastSend != 0, pnode->id);
+            pnode->fDisconnect = true;
+        } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
+            LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+            pnode->fDisconnect = true;
+        } else if (nTime - pnode->nLastRecv >
+                   (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
+            LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+            pnode->fDisconnect = true;
+        } else if (pnode->nPingNonceSent &&
+                   pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
+            LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->fDisconnect = true;
+        }
+    }
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/**
+ * Wait for socket events with epoll and service the ready sockets.
+ *
+ * Node sockets are edge triggered. A read event is remembered in fHasRecvData
+ * until the socket is drained, which may take several rounds when the peer
+ * hits the receive flood limit; the message handler wakes this thread up once
+ * it made room. A write event flushes the send queue right away. All nodes are
+ * still visited about once a second for the inactivity checks.
+ */
+static void SocketEventsEpoll()
+{
+    static int64_t nNextInactivityCheck = 0;
+    static bool fRecvPending = false;
+
+    struct epoll_event events[MAX_SOCKET_EVENTS];
+    int nEvents = epoll_wait(hEpollFd, events, MAX_SOCKET_EVENTS, fRecvPending ? 0 : 1000);
+    boost::this_thread::interruption_point();
+
+    if (nEvents < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+            MilliSleep(50);
+        }
+        nEvents = 0;
+    }
+
+    bool fFullScan = fRecvPending;
+    std::vector<CNode*> vNodesReadable;
+    for (int i = 0; i < nEvents; i++) {
+        void* ptr = events[i].data.ptr;
+        if (ptr == NULL) {
+            // WakeupSocketHandler
+            char buf[128];
+            while (read(hWakeupPipe[0], buf, sizeof(buf)) > 0) {}
+            fFullScan = true;
+            continue;
+        }
+
+        //
+        // Accept new connections
+        //
+        bool fListenSocket = false;
+        for (const ListenSocket& hListenSocket : vhListenSocket) {
+            if (ptr == &hListenSocket) {
+                AcceptConnection(hListenSocket);
+                fListenSocket = true;
+            }
+        }
+        if (fListenSocket)
+            continue;
+
+        // Events are only reported for open sockets and nodes are only
+        // deleted by this thread, so the node is still around
+        CNode* pnode = static_cast<CNode*>(ptr);
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            pnode->fHasRecvData = true;
+            vNodesReadable.push_back(pnode);
+        }
+        if (events[i].events & EPOLLOUT) {
+            LOCK(pnode->cs_vSend);
+            if (pnode->hSocket != INVALID_SOCKET && !pnode->vSendMsg.empty())
+                SocketSendData(pnode);
+        }
+    }
+
+    int64_t nNow = GetTimeMillis();
+    bool fCheckInactivity = nNow >= nNextInactivityCheck;
+    if (fCheckInactivity) {
+        nNextInactivityCheck = nNow + 1000;
+        fFullScan = true;
+    }
+
+    //
+    // Service each socket
+    //
+    std::vector<CNode*> vNodesCopy;
+    {
+        LOCK(cs_vNodes);
+        vNodesCopy = fFullScan ? vNodes : vNodesReadable;
+        for (CNode* pnode : vNodesCopy)
+            pnode->AddRef();
+    }
+    fRecvPending = false;
+    for (CNode* pnode : vNodesCopy) {
+        boost::this_thread::interruption_point();
+
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+        if (pnode->fHasRecvData) {
+            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+            if (lockRecv) {
+                for (int nRound = 0; nRound < MAX_SOCKET_RECV_ROUNDS; nRound++) {
+                    if (!pnode->fHasRecvData || pnode->hSocket == INVALID_SOCKET || !CanReceive(pnode))
+                        break;
+                    if (!SocketRecvData(pnode))
+                        pnode->fHasRecvData = false;
+                }
+                if (pnode->fHasRecvData && pnode->hSocket != INVALID_SOCKET && CanReceive(pnode))
+                    fRecvPending = true;
+            }
+        }
+
+        if (fCheckInactivity)
+            InactivityCheck(pnode);
+    }
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodesCopy)
+            pnode->Release();
+    }
 }
+#endif
 
 void ThreadSocketHandler() {
     unsigned int nPrevNodeCount = 0;
@@ -1082,6 +1313,13 @@ void ThreadSocketHandler() {
             uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
         }
 
+#ifdef HAVE_SYS_EPOLL_H
+        if (hEpollFd != -1) {
+            SocketEventsEpoll();
+            continue;
+        }
+#endif
+
         //
         // Find which sockets have data to receive
         //
@@ -1138,8 +1376,7 @@ void ThreadSocketHandler() {
                 }
                 {
                     TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                                     pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
+                    if (lockRecv && CanReceive(pnode))
                         FD_SET(pnode->hSocket, &fdsetRecv);
                 }
             }
@@ -1191,34 +1428,8 @@ void ThreadSocketHandler() {
                 continue;
             if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv) {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0) {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                            pnode->nRecvBytes += nBytes;
-                            pnode->RecordBytesRecv(nBytes);
-                        } else if (nBytes == 0) {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                LogPrint(BCLog::NET, "socket closed\n");
-                            pnode->CloseSocketDisconnect();
-                        } else if (nBytes < 0) {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR &&
-                                nErr != WSAEINPROGRESS) {
-                                if (!pnode->fDisconnect)
-                                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
+                if (lockRecv)
+                    SocketRecvData(pnode);
             }
 
             //
@@ -1234,25 +1445,7 @@ void ThreadSocketHandler() {
             //
             // Inactivity checking
             //
-            int64_t nTime = GetTime();
-            if (nTime - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0,
-                             pnode->nLastSend != 0, pnode->id);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastRecv >
-                           (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                } else if (pnode->nPingNonceSent &&
-                           pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-            }
+            InactivityCheck(pnode);
         }
         {
             LOCK(cs_vNodes);
@@ -1726,6 +1919,7 @@ void ThreadMessageHandler() {
         }
 
         bool fSleep = true;
+        bool fWakeupSocketHandler = false;
         for (CNode * pnode : vNodesCopy)
         {
             if (pnode->fDisconnect)
@@ -1737,6 +1931,9 @@ void ThreadMessageHandler() {
                     if (!GetNodeSignals().ProcessMessages(pnode)) {
                         pnode->CloseSocketDisconnect();
                     }
+                    // The socket handler stopped reading from this node, resume now that there is room
+                    if (pnode->fHasRecvData)
+                        fWakeupSocketHandler = true;
                     if (pnode->nSendSize < SendBufferSize()) {
                         if (!pnode->vRecvGetData.empty() ||
                             (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete())) {
@@ -1760,6 +1957,9 @@ void ThreadMessageHandler() {
             pnode->Release();
         }
 
+        if (fWakeupSocketHandler)
+            WakeupSocketHandler();
+
         if (fSleep)
             messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() +
                                                      boost::posix_time::milliseconds(100));
@@ -1900,6 +2100,34 @@ void static Discover(boost::thread_group &threadGroup) {
 #endif
 }
 
+static void InitSocketEvents()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (GetArg("-socketevents", DEFAULT_SOCKETEVENTS) == "epoll") {
+        hEpollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (hEpollFd == -1) {
+            LogPrintf("epoll_create1 failed: %s, falling back to select\n", NetworkErrorString(WSAGetLastError()));
+        } else if (pipe2(hWakeupPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+            LogPrintf("pipe2 failed: %s, falling back to select\n", NetworkErrorString(WSAGetLastError()));
+            close(hEpollFd);
+            hEpollFd = -1;
+        } else {
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = NULL;
+            epoll_ctl(hEpollFd, EPOLL_CTL_ADD, hWakeupPipe[0], &event);
+            // Listen sockets stay level triggered, one connection is accepted per event
+            for (ListenSocket& hListenSocket : vhListenSocket) {
+                event.data.ptr = &hListenSocket;
+                if (epoll_ctl(hEpollFd, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0)
+                    LogPrintf("epoll_ctl failed for listen socket: %s\n", NetworkErrorString(WSAGetLastError()));
+            }
+        }
+    }
+#endif
+    LogPrintf("Using %s for socket events\n", IsSelectBackend() ? "select" : "epoll");
+}
+
 void StartNode(boost::thread_group &threadGroup, CScheduler &scheduler) {
     uiInterface.InitMessage(_("Loading addresses..."));
     // Load addresses from peers.dat
@@ -1964,6 +2192,8 @@ void StartNode(boost::thread_group &threadGroup, CScheduler &scheduler) {
     // Map ports with UPnP
     MapPort(GetBoolArg("-upnp", DEFAULT_UPNP));
 
+    InitSocketEvents();
+
     // Send and receive from sockets, accept connections
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "net", &ThreadSocketHandler));
 
@@ -2009,6 +2239,13 @@ public:
         if (hListenSocket.socket != INVALID_SOCKET)
             if (!CloseSocket(hListenSocket.socket))
                 LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+#ifdef HAVE_SYS_EPOLL_H
+        if (hEpollFd != -1) {
+            close(hEpollFd);
+            close(hWakeupPipe[0]);
+            close(hWakeupPipe[1]);
+        }
+#endif
 
         // clean up some globals (to help leak detection)
         for (CNode * pnode : vNodes)
@@ -2281,6 +2518,7 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     fNetworkNode = false;
     fSuccessfullyConnected = false;
     fDisconnect = false;
+    fHasRecvData = false;
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
@@ -2405,17 +2643,58 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend) {
 
     LogPrint(BCLog::NET, "(%d bytes) peer=%d\n", nSize, id);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
+    std::shared_ptr<CSerializeData> data = std::make_shared<CSerializeData>();
+    ssSend.GetAndClear(*data);
+    nSendSize += data->size();
+    vSendMsg.push_back(data);
 
     // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
+    if (vSendMsg.size() == 1)
         SocketSendData(this);
 
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
 
+void CNode::PushSerializedMessage(const CSerializeDataRef& msg)
+{
+    LOCK(cs_vSend);
+    assert(ssSend.size() == 0);
+    const char* pszCommand = &(*msg)[MESSAGE_START_SIZE];
+    LogPrint(BCLog::NET, "sending: %s (%d bytes, serialized) peer=%d\n",
+        SanitizeString(std::string(pszCommand, strnlen(pszCommand, CMessageHeader::COMMAND_SIZE))),
+        msg->size() - CMessageHeader::HEADER_SIZE, id);
+
+    vSendMsg.push_back(msg);
+    nSendSize += msg->size();
+
+    // If write queue empty, attempt "optimistic write"
+    if (vSendMsg.size() == 1)
+        SocketSendData(this);
+}
+
+CSerializeDataRef CreateSerializedMessage(const char* pszCommand, const char* pdata, size_t nSize)
+{
+    CMessageHeader hdr(pszCommand, nSize);
+    uint256 hash = Hash(pdata, pdata + nSize);
+    memcpy(&hdr.nChecksum, hash.begin(), sizeof(hdr.nChecksum));
+
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    ssHeader << hdr;
+    assert(ssHeader.size() == CMessageHeader::HEADER_SIZE);
+
+    std::shared_ptr<CSerializeData> msg = std::make_shared<CSerializeData>();
+    msg->reserve(ssHeader.size() + nSize);
+    msg->insert(msg->end(), ssHeader.begin(), ssHeader.end());
+    msg->insert(msg->end(), pdata, pdata + nSize);
+    return msg;
+}
+
+CSerializeDataRef CreateSerializedMessage(const char* pszCommand, const CDataStream& ssPayload)
+{
+    const char* pdata = ssPayload.empty() ? NULL : &ssPayload[0];
+    return CreateSerializedMessage(pszCommand, pdata, ssPayload.size());
+}
+
 //
 // CBanDB
 //
@@ -23,6 +23,7 @@
 
 #include <atomic>
 #include <deque>
+#include <memory>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -69,6 +70,12 @@ static const bool DEFAULT_UPNP = false;
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 /** The maximum number of peer connections to maintain. */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
+/** -socketevents default (mechanism used by the socket handler thread to wait for socket readiness) */
+#ifdef HAVE_SYS_EPOLL_H
+static const char* const DEFAULT_SOCKETEVENTS = "epoll";
+#else
+static const char* const DEFAULT_SOCKETEVENTS = "select";
+#endif
 
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
@@ -88,9 +95,17 @@ bool BindListenPort(const CService& bindAddr, std::string& strError, bool fWhite
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
 void SocketSendData(CNode* pnode);
+void WakeupSocketHandler();
 
 typedef int64_t NodeId;
 
+/** A complete serialized network message, possibly shared by the send queues of several peers */
+typedef std::shared_ptr<const CSerializeData> CSerializeDataRef;
+
+/** Build a complete network message (header and payload) from an already serialized payload */
+CSerializeDataRef CreateSerializedMessage(const char* pszCommand, const char* pdata, size_t nSize);
+CSerializeDataRef CreateSerializedMessage(const char* pszCommand, const CDataStream& ssPayload);
+
 struct CombinerAll {
     typedef bool result_type;
 
@@ -215,6 +230,8 @@ public:
 
     int64_t nTime; // time (in microseconds) of message receipt.
 
+    bool fVerifyQueued; // handed to the message verification threads
+
     CNetMessage(int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), vRecv(nTypeIn, nVersionIn)
     {
         hdrbuf.resize(24);
@@ -222,6 +239,7 @@ public:
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        fVerifyQueued = false;
     }
 
     bool complete() const
@@ -314,7 +332,7 @@ public:
     size_t nSendSize;   // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<CSerializeDataRef> vSendMsg;
     RecursiveMutex cs_vSend;
 
     RecursiveMutex cs_sendProcessing;
@@ -346,6 +364,8 @@ public:
     bool fNetworkNode;
     bool fSuccessfullyConnected;
     std::atomic_bool fDisconnect;
+    // Set when the socket may have unread data (edge triggered socket events only)
+    std::atomic_bool fHasRecvData;
     // We use fRelayTxes for two purposes -
     // a) it allows us to not relay tx invs before receiving the peer's version message
     // b) the peer may tell us in their version message that we should not relay tx invs
@@ -514,6 +534,9 @@ public:
 
     void PushVersion();
 
+    /** Queue a message built by CreateSerializedMessage, without copying or re-hashing it */
+    void PushSerializedMessage(const CSerializeDataRef& msg);
+
 
     void PushMessage(const char* pszCommand)
     {
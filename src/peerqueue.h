@@ -0,0 +1,121 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRCY_PEERQUEUE_H
+#define PRCY_PEERQUEUE_H
+
+#include "net.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Work queue with one FIFO per peer, drained by worker threads that serve
+ * the peers round robin. A peer flooding the queue only delays its own work.
+ *
+ * Derived classes can refuse duplicate items through IsQueued, Queued and
+ * Dequeued, which are called with the queue lock held.
+ */
+template <typename T>
+class CPeerQueue
+{
+public:
+    typedef std::function<void(NodeId, const T&)> WorkFn;
+
+    explicit CPeerQueue(unsigned int nMaxPerPeerIn) : nMaxPerPeer(nMaxPerPeerIn), nQueued(0) {}
+    virtual ~CPeerQueue() {}
+
+    /** Queue item for nodeid. Returns false if the peer's queue is full or the item is already queued. */
+    bool Push(NodeId nodeid, const T& item)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (IsQueued(item))
+                return false;
+            std::deque<T>& queue = mapPeerQueues[nodeid];
+            if (queue.size() >= nMaxPerPeer)
+                return false;
+            if (queue.empty())
+                vPeerRotation.push_back(nodeid);
+            queue.push_back(item);
+            Queued(item);
+            nQueued++;
+        }
+        cond.notify_one();
+        return true;
+    }
+
+    /** Drop the items still queued for a disconnected peer */
+    void RemovePeer(NodeId nodeid)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        typename std::map<NodeId, std::deque<T> >::iterator it = mapPeerQueues.find(nodeid);
+        if (it == mapPeerQueues.end())
+            return;
+        for (const T& item : it->second)
+            Dequeued(item);
+        nQueued -= it->second.size();
+        mapPeerQueues.erase(it);
+        vPeerRotation.erase(std::remove(vPeerRotation.begin(), vPeerRotation.end(), nodeid), vPeerRotation.end());
+    }
+
+    /** Number of items queued or being worked on */
+    size_t size()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return nQueued;
+    }
+
+    /** Worker thread loop, calls fn for every queued item until interrupted */
+    void Thread(const WorkFn& fn)
+    {
+        while (true) {
+            NodeId nodeid;
+            T item;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (vPeerRotation.empty())
+                    cond.wait(lock); // interruption point
+                nodeid = vPeerRotation.front();
+                vPeerRotation.pop_front();
+                std::deque<T>& queue = mapPeerQueues[nodeid];
+                item = queue.front();
+                queue.pop_front();
+                // Back of the line until every other peer got a turn
+                if (queue.empty())
+                    mapPeerQueues.erase(nodeid);
+                else
+                    vPeerRotation.push_back(nodeid);
+            }
+
+            fn(nodeid, item);
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            Dequeued(item);
+            nQueued--;
+        }
+    }
+
+protected:
+    virtual bool IsQueued(const T& item) const { return false; }
+    virtual void Queued(const T& item) {}
+    virtual void Dequeued(const T& item) {}
+
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    const unsigned int nMaxPerPeer;
+    std::map<NodeId, std::deque<T> > mapPeerQueues;
+    //! Peers with queued items, in the order they are served
+    std::deque<NodeId> vPeerRotation;
+    size_t nQueued;
+};
+
+#endif // PRCY_PEERQUEUE_H
@@ -57,6 +57,9 @@ const char *BUDGETVOTESYNC="mnvs";
 const char *FINALBUDGET="fbs";
 const char *FINALBUDGETVOTE="fbvote";
 const char *SYNCSTATUSCOUNT="ssc";
+const char *CMPCTBLOCK="cmpctblock";
+const char *GETBLOCKTXN="getblocktxn";
+const char *BLOCKTXN="blocktxn";
 };
 
 static const char* ppszTypeName[] =
@@ -131,7 +134,10 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::BUDGETVOTESYNC,
     NetMsgType::FINALBUDGET,
     NetMsgType::FINALBUDGETVOTE,
-    NetMsgType::SYNCSTATUSCOUNT
+    NetMsgType::SYNCSTATUSCOUNT,
+    NetMsgType::CMPCTBLOCK,
+    NetMsgType::GETBLOCKTXN,
+    NetMsgType::BLOCKTXN
 };
 const static std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes+ARRAYLEN(allNetMessageTypes));
 
@@ -287,6 +287,23 @@ extern const char *FINALBUDGETVOTE;
  * The syncstatuscount message is used to track the layer 2 syncing process
  */
 extern const char *SYNCSTATUSCOUNT;
+/**
+ * Contains a block header, short IDs of its transactions and the transactions
+ * peers can't have yet. Sent in reply to a getdata for MSG_CMPCT_BLOCK.
+ * @since protocol version COMPACT_BLOCKS_VERSION.
+ */
+extern const char *CMPCTBLOCK;
+/**
+ * Requests the transactions of a compact block that could not be found in
+ * the mempool, by their index in the block.
+ * @since protocol version COMPACT_BLOCKS_VERSION.
+ */
+extern const char *GETBLOCKTXN;
+/**
+ * Contains the transactions requested by a getblocktxn message.
+ * @since protocol version COMPACT_BLOCKS_VERSION.
+ */
+extern const char *BLOCKTXN;
 };
 
 /* Get a vector of all valid message types (see above) */
@@ -401,7 +418,9 @@ enum {
     MSG_MASTERNODE_QUORUM,
     MSG_MASTERNODE_ANNOUNCE,
     MSG_MASTERNODE_PING,
-    MSG_DSTX
+    MSG_DSTX,
+    // Only valid in getdata, to peers with version >= COMPACT_BLOCKS_VERSION
+    MSG_CMPCT_BLOCK = 20,
 };
 
 #endif // BITCOIN_PROTOCOL_H
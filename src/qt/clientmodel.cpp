@@ -74,11 +74,11 @@ int ClientModel::getNumConnections(unsigned int flags) const
 
 QString ClientModel::getMasternodeCountString() const
 {
-    int ipv4 = 0, ipv6 = 0, onion = 0;
-    mnodeman.CountNetworks(ActiveProtocol(), ipv4, ipv6, onion);
-    int nUnknown = mnodeman.size() - ipv4 - ipv6 - onion;
+    std::shared_ptr<const CMasternodeListSnapshot> snapshot = mnodeman.GetSnapshot();
+    int nTotal = snapshot->vMasternodes.size();
+    int nUnknown = nTotal - snapshot->nIPv4 - snapshot->nIPv6 - snapshot->nOnion;
     if(nUnknown < 0) nUnknown = 0;
-    return tr("Total: %1 (IPv4: %2 / IPv6: %3 / Tor: %4 / Unknown: %5)").arg(QString::number((int)mnodeman.size())).arg(QString::number((int)ipv4)).arg(QString::number((int)ipv6)).arg(QString::number((int)onion)).arg(QString::number((int)nUnknown));
+    return tr("Total: %1 (IPv4: %2 / IPv6: %3 / Tor: %4 / Unknown: %5)").arg(QString::number(nTotal)).arg(QString::number(snapshot->nIPv4)).arg(QString::number(snapshot->nIPv6)).arg(QString::number(snapshot->nOnion)).arg(QString::number(nUnknown));
 }
 
 int ClientModel::getNumBlocks()
@@ -9,6 +9,7 @@
 #include "checkpoints.h"
 #include "main.h"
 #include "rpc/server.h"
+#include "txdb.h"
 #include "sync.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -632,6 +633,47 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
     return ret;
 }
 
+static UniValue DBCacheStatsToJSON(const CDBCacheStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    const uint64_t nLookups = stats.nHits + stats.nMisses;
+    obj.push_back(Pair("cache_size", (int64_t)stats.nCacheSize));
+    obj.push_back(Pair("cache_usage", (int64_t)stats.nCacheUsage));
+    obj.push_back(Pair("hits", (int64_t)stats.nHits));
+    obj.push_back(Pair("misses", (int64_t)stats.nMisses));
+    obj.push_back(Pair("hit_rate", nLookups ? (double)stats.nHits / nLookups : 0.0));
+    return obj;
+}
+
+UniValue getdbcacheinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "getdbcacheinfo\n"
+            "\nReturns block cache statistics of the block index and key image databases.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blockindex\": {             (json object) block index, file info and transaction index database\n"
+            "    \"cache_size\": n,          (numeric) The block cache size in bytes\n"
+            "    \"cache_usage\": n,         (numeric) The bytes currently held by the block cache\n"
+            "    \"hits\": n,                (numeric) Block cache lookups served from memory\n"
+            "    \"misses\": n,              (numeric) Block cache lookups that had to read from disk\n"
+            "    \"hit_rate\": x.xxx         (numeric) hits / (hits + misses)\n"
+            "  },\n"
+            "  \"keyimages\": {              (json object) key image database, same fields as above\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getdbcacheinfo", "") + HelpExampleRpc("getdbcacheinfo", ""));
+
+    LOCK(cs_main);
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("blockindex", DBCacheStatsToJSON(pblocktree->GetCacheStats())));
+    ret.push_back(Pair("keyimages", DBCacheStatsToJSON(pblocktree->GetKeyImageCacheStats())));
+    return ret;
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -961,8 +1003,12 @@ UniValue mempoolInfoToJSON()
     UniValue ret(UniValue::VOBJ);
     ret.push_back(Pair("size", (int64_t) mempool.size()));
     ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalTxSize()));
-
-    //ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+    ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+    size_t maxmempool = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+    ret.push_back(Pair("maxmempool", (int64_t) maxmempool));
+    ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
+    ret.push_back(Pair("evicted", (int64_t) mempool.GetEvictedTx()));
+    ret.push_back(Pair("evictedbytes", (int64_t) mempool.GetEvictedBytes()));
     return ret;
 }
 
@@ -976,6 +1022,11 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "{\n"
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
+            "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"maxmempool\": xxxxx          (numeric) Maximum memory usage for the mempool\n"
+            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee for tx to be accepted\n"
+            "  \"evicted\": xxxxx             (numeric) Transactions evicted to keep the mempool below maxmempool\n"
+            "  \"evictedbytes\": xxxxx        (numeric) Sum of the sizes of the evicted transactions\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getmempoolinfo", "") + HelpExampleRpc("getmempoolinfo", ""));
@@ -184,51 +184,59 @@ UniValue listmasternodes(const UniValue& params, bool fHelp)
             HelpExampleCli("masternodelist", "") + HelpExampleRpc("masternodelist", ""));
 
     UniValue ret(UniValue::VARR);
-    int nHeight;
-    {
-        LOCK(cs_main);
-        CBlockIndex* pindex = chainActive.Tip();
-        if(!pindex) return 0;
-        nHeight = pindex->nHeight;
+
+    // The masternodes thread keeps the list copy current, lite mode has none
+    if (fLiteMode)
+        mnodeman.PublishSnapshot();
+
+    // Enabled masternodes by the ranks published with the list copy, then the others
+    std::shared_ptr<const CMasternodeListSnapshot> snapshot = mnodeman.GetSnapshot();
+    if (snapshot->hashRankBlock.IsNull()) return ret;
+    std::vector<std::pair<int, const CMasternode*> > vMasternodeRanks;
+    std::vector<const CMasternode*> vecDisabled;
+    for (size_t i = 0; i < snapshot->vMasternodes.size(); i++) {
+        if (snapshot->vRanks[i] > 0)
+            vMasternodeRanks.push_back(std::make_pair(snapshot->vRanks[i], &snapshot->vMasternodes[i]));
+        else
+            vecDisabled.push_back(&snapshot->vMasternodes[i]);
     }
-    std::vector<std::pair<int, CMasternode> > vMasternodeRanks = mnodeman.GetMasternodeRanks(nHeight);
-    for (PAIRTYPE(int, CMasternode) & s : vMasternodeRanks) {
+    std::sort(vMasternodeRanks.begin(), vMasternodeRanks.end());
+    for (const CMasternode* pmn : vecDisabled)
+        vMasternodeRanks.push_back(std::make_pair(0, pmn));
+
+    for (const std::pair<int, const CMasternode*>& s : vMasternodeRanks) {
         UniValue obj(UniValue::VOBJ);
-        std::string strVin = s.second.vin.prevout.ToStringShort();
-        std::string strTxHash = s.second.vin.prevout.hash.ToString();
-        uint32_t oIdx = s.second.vin.prevout.n;
-
-        CMasternode* mn = mnodeman.Find(s.second.vin);
-
-        if (mn != NULL) {
-            if (strFilter != "" && strTxHash.find(strFilter) == std::string::npos &&
-                mn->Status().find(strFilter) == std::string::npos &&
-                CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString().find(strFilter) == std::string::npos) continue;
-
-            std::string strStatus = mn->Status();
-            std::string strHost;
-            int port;
-            SplitHostPort(mn->addr.ToString(), port, strHost);
-            CNetAddr node;
-            LookupHost(strHost.c_str(), node, false);
-            std::string strNetwork = GetNetworkName(node.GetNetwork());
-
-            obj.push_back(Pair("rank", (strStatus == "ENABLED" ? s.first : 0)));
-            obj.push_back(Pair("network", strNetwork));
-            obj.push_back(Pair("txhash", strTxHash));
-            obj.push_back(Pair("outidx", (uint64_t)oIdx));
-            obj.push_back(Pair("pubkey", HexStr(mn->pubKeyMasternode)));
-            obj.push_back(Pair("status", strStatus));
-            obj.push_back(Pair("addr", CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString()));
-            std::string mnStealth(mn->vin.masternodeStealthAddress.begin(), mn->vin.masternodeStealthAddress.end());
-            obj.push_back(Pair("stealthaddress", mnStealth));
-            obj.push_back(Pair("version", mn->protocolVersion));
-            obj.push_back(Pair("lastseen", (int64_t)mn->lastPing.sigTime));
-            obj.push_back(Pair("activetime", (int64_t)(mn->lastPing.sigTime - mn->sigTime)));
-            obj.push_back(Pair("lastpaid", (int64_t)mn->GetLastPaid()));
+        const CMasternode* mn = s.second;
+        std::string strTxHash = mn->vin.prevout.hash.ToString();
+        uint32_t oIdx = mn->vin.prevout.n;
+
+        if (strFilter != "" && strTxHash.find(strFilter) == std::string::npos &&
+            mn->Status().find(strFilter) == std::string::npos &&
+            CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString().find(strFilter) == std::string::npos) continue;
+
+        std::string strStatus = mn->Status();
+        std::string strHost;
+        int port;
+        SplitHostPort(mn->addr.ToString(), port, strHost);
+        CNetAddr node;
+        LookupHost(strHost.c_str(), node, false);
+        std::string strNetwork = GetNetworkName(node.GetNetwork());
+
+        obj.push_back(Pair("rank", s.first));
+        obj.push_back(Pair("network", strNetwork));
+        obj.push_back(Pair("txhash", strTxHash));
+        obj.push_back(Pair("outidx", (uint64_t)oIdx));
+        obj.push_back(Pair("pubkey", HexStr(mn->pubKeyMasternode)));
+        obj.push_back(Pair("status", strStatus));
+        obj.push_back(Pair("addr", CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString()));
+        std::string mnStealth(mn->vin.masternodeStealthAddress.begin(), mn->vin.masternodeStealthAddress.end());
+        obj.push_back(Pair("stealthaddress", mnStealth));
+        obj.push_back(Pair("version", mn->protocolVersion));
+        obj.push_back(Pair("lastseen", (int64_t)mn->lastPing.sigTime));
+        obj.push_back(Pair("activetime", (int64_t)(mn->lastPing.sigTime - mn->sigTime)));
+        obj.push_back(Pair("lastpaid", (int64_t)mn->GetLastPaid(snapshot->nEnabled)));
 
-            ret.push_back(obj);
-        }
+        ret.push_back(obj);
     }
 
     return ret;
@@ -252,21 +260,15 @@ UniValue getmasternodecount (const UniValue& params, bool fHelp)
             HelpExampleCli("getmasternodecount", "") + HelpExampleRpc("getmasternodecount", ""));
 
     UniValue obj(UniValue::VOBJ);
-    int nCount = 0;
-    int ipv4 = 0, ipv6 = 0, onion = 0;
+    std::shared_ptr<const CMasternodeListSnapshot> snapshot = mnodeman.GetSnapshot();
 
-    if (chainActive.Tip())
-        mnodeman.GetNextMasternodeInQueueForPayment(chainActive.Tip()->nHeight, true, nCount);
-
-    mnodeman.CountNetworks(ActiveProtocol(), ipv4, ipv6, onion);
-
-    obj.push_back(Pair("total", mnodeman.size()));
-    obj.push_back(Pair("stable", mnodeman.stable_size()));
-    obj.push_back(Pair("enabled", mnodeman.CountEnabled()));
-    obj.push_back(Pair("inqueue", nCount));
-    obj.push_back(Pair("ipv4", ipv4));
-    obj.push_back(Pair("ipv6", ipv6));
-    obj.push_back(Pair("onion", onion));
+    obj.push_back(Pair("total", (int)snapshot->vMasternodes.size()));
+    obj.push_back(Pair("stable", snapshot->nStable));
+    obj.push_back(Pair("enabled", snapshot->nEnabled));
+    obj.push_back(Pair("inqueue", snapshot->nInQueue));
+    obj.push_back(Pair("ipv4", snapshot->nIPv4));
+    obj.push_back(Pair("ipv6", snapshot->nIPv6));
+    obj.push_back(Pair("onion", snapshot->nOnion));
 
     return obj;
 }
@@ -836,12 +838,15 @@ UniValue getmasternodescores (const UniValue& params, bool fHelp)
     }
     UniValue obj(UniValue::VOBJ);
 
-    std::vector<CMasternode> vMasternodes = mnodeman.GetFullMasternodeVector();
+    std::shared_ptr<const CMasternodeListSnapshot> snapshot = mnodeman.GetSnapshot();
     for (int nHeight = chainActive.Tip()->nHeight - nLast; nHeight < chainActive.Tip()->nHeight + 20; nHeight++) {
+        uint256 hash;
+        if (!GetBlockHash(hash, nHeight - 100)) continue;
+
         uint256 nHigh;
-        CMasternode* pBestMasternode = NULL;
-        for (CMasternode& mn : vMasternodes) {
-            uint256 n = mn.CalculateScore(1, nHeight - 100);
+        const CMasternode* pBestMasternode = NULL;
+        for (const CMasternode& mn : snapshot->vMasternodes) {
+            uint256 n = mn.CalculateScore(hash);
             if (n > nHigh) {
                 nHigh = n;
                 pBestMasternode = &mn;
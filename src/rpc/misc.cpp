@@ -11,10 +11,13 @@
 #include "httpserver.h"
 #include "init.h"
 #include "main.h"
+#include "masternode-budget.h"
 #include "masternode-sync.h"
+#include "masternodeman.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
+#include "swifttx.h"
 #include "timedata.h"
 #include "util.h"
 
@@ -147,6 +150,15 @@ UniValue getversion(const UniValue &params, bool fHelp) {
     return obj;
 }
 
+template <typename T>
+static UniValue SeenCacheToJSON(const CSeenCache<T>& cache)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("entries", (uint64_t)cache.size()));
+    obj.push_back(Pair("bytes", (uint64_t)cache.BytesUsed()));
+    return obj;
+}
+
 UniValue mnsync(const UniValue &params, bool fHelp) {
     std::string strMode;
     if (params.size() == 1)
@@ -178,6 +190,12 @@ UniValue mnsync(const UniValue &params, bool fHelp) {
                 "  \"countBudgetItemFin\": n,       (numeric) Number of MN budget finalization messages (local)\n"
                 "  \"RequestedMasternodeAssets\": n, (numeric) Status code of last sync phase\n"
                 "  \"RequestedMasternodeAttempt\": n, (numeric) Status code of last sync attempt\n"
+                "  \"seenCaches\": {               (json object) Relayed messages kept by hash\n"
+                "    \"name\": {                   (json object) One of masternodeBroadcasts, masternodePings, budgetVotes, finalizedBudgetVotes, txLockVotes\n"
+                "      \"entries\": n,             (numeric) Number of messages kept\n"
+                "      \"bytes\": n                (numeric) Estimated memory used\n"
+                "    }, ...\n"
+                "  }\n"
                 "}\n"
 
                 "\nResult ('reset' mode):\n"
@@ -206,6 +224,23 @@ UniValue mnsync(const UniValue &params, bool fHelp) {
         obj.push_back(Pair("RequestedMasternodeAssets", masternodeSync.RequestedMasternodeAssets));
         obj.push_back(Pair("RequestedMasternodeAttempt", masternodeSync.RequestedMasternodeAttempt));
 
+        UniValue seen(UniValue::VOBJ);
+        {
+            LOCK(mnodeman.cs_seen);
+            seen.push_back(Pair("masternodeBroadcasts", SeenCacheToJSON(mnodeman.mapSeenMasternodeBroadcast)));
+            seen.push_back(Pair("masternodePings", SeenCacheToJSON(mnodeman.mapSeenMasternodePing)));
+        }
+        {
+            LOCK(budget.cs);
+            seen.push_back(Pair("budgetVotes", SeenCacheToJSON(budget.mapSeenMasternodeBudgetVotes)));
+            seen.push_back(Pair("finalizedBudgetVotes", SeenCacheToJSON(budget.mapSeenFinalizedBudgetVotes)));
+        }
+        {
+            LOCK(cs_mapTxLockVote);
+            seen.push_back(Pair("txLockVotes", SeenCacheToJSON(mapTxLockVote)));
+        }
+        obj.push_back(Pair("seenCaches", seen));
+
         return obj;
     }
 
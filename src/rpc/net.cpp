@@ -100,7 +100,9 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"blockwindow\": n,          (numeric) The number of blocks we may ask from this peer at the same time\n"
+            "    \"blockrate\": n,            (numeric) The measured block download rate from this peer in bytes per second\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -148,6 +150,8 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
                 heights.push_back(height);
             }
             obj.push_back(Pair("inflight", heights));
+            obj.push_back(Pair("blockwindow", statestats.nBlockWindow));
+            obj.push_back(Pair("blockrate", statestats.nBlockBytesPerSec));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
 
@@ -0,0 +1,210 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRCY_SEENCACHE_H
+#define PRCY_SEENCACHE_H
+
+#include "memusage.h"
+#include "serialize.h"
+#include "uint256.h"
+#include "utiltime.h"
+#include "version.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+/** Number of time buckets an expiry period is split into */
+static const int SEEN_CACHE_BUCKETS = 16;
+
+/**
+ * Relayed objects by hash, kept for answering getdata and recognizing
+ * messages already processed.
+ *
+ * Entries are filed into time buckets as they are added, so expiring them
+ * only looks at the oldest bucket instead of walking the whole map. This is
+ * done as new entries come in, which also evicts the oldest entries once the
+ * estimated memory use goes over nMaxBytes. Touch moves an entry that is
+ * still in use to the newest bucket.
+ *
+ * Reads and writes like the std::map it replaces, on disk as well. Like that
+ * map it does no locking of its own.
+ */
+template <typename T>
+class CSeenCache
+{
+public:
+    typedef std::map<uint256, T> map_type;
+    typedef typename map_type::value_type value_type;
+    typedef typename map_type::iterator iterator;
+    typedef typename map_type::const_iterator const_iterator;
+
+    /** nExpireSecondsIn of 0 keeps entries until the memory cap is reached */
+    CSeenCache(int64_t nExpireSecondsIn, size_t nMaxBytesIn) : nExpireSeconds(nExpireSecondsIn),
+                                                               nBucketSeconds(std::max<int64_t>(1, (nExpireSecondsIn ? nExpireSecondsIn : 60 * 60) / SEEN_CACHE_BUCKETS)),
+                                                               nMaxBytes(nMaxBytesIn),
+                                                               nBytes(0) {}
+
+    size_t count(const uint256& hash) const { return mapSeen.count(hash); }
+    iterator find(const uint256& hash) { return mapSeen.find(hash); }
+    const_iterator find(const uint256& hash) const { return mapSeen.find(hash); }
+    iterator begin() { return mapSeen.begin(); }
+    iterator end() { return mapSeen.end(); }
+    const_iterator begin() const { return mapSeen.begin(); }
+    const_iterator end() const { return mapSeen.end(); }
+    size_t size() const { return mapSeen.size(); }
+    bool empty() const { return mapSeen.empty(); }
+
+    /** Estimated memory used by the entries */
+    size_t BytesUsed() const { return nBytes; }
+
+    std::pair<iterator, bool> insert(const value_type& entry)
+    {
+        iterator it = mapSeen.find(entry.first);
+        if (it != mapSeen.end())
+            return std::make_pair(it, false);
+        const int64_t nNow = GetTime();
+        const size_t nEntryBytes = ::GetSerializeSize(entry.second, SER_NETWORK, PROTOCOL_VERSION) + sizeof(uint256) +
+                                   memusage::MallocUsage(sizeof(memusage::stl_tree_node<value_type>)) +
+                                   memusage::MallocUsage(sizeof(memusage::stl_tree_node<std::pair<const uint256, CEntry> >));
+        // Make room first, so the new entry is never the one evicted
+        Expire(nNow, nEntryBytes);
+        it = mapSeen.insert(entry).first;
+        CEntry& tracked = mapEntries[entry.first];
+        tracked.nTime = nNow;
+        tracked.nBytes = nEntryBytes;
+        nBytes += nEntryBytes;
+        AddToBucket(entry.first, nNow);
+        return std::make_pair(it, true);
+    }
+
+    T& operator[](const uint256& hash)
+    {
+        iterator it = mapSeen.find(hash);
+        if (it != mapSeen.end())
+            return it->second;
+        return insert(value_type(hash, T())).first->second;
+    }
+
+    size_t erase(const uint256& hash)
+    {
+        Untrack(hash);
+        return mapSeen.erase(hash);
+    }
+
+    void erase(iterator it)
+    {
+        Untrack(it->first);
+        mapSeen.erase(it);
+    }
+
+    void clear()
+    {
+        mapSeen.clear();
+        mapEntries.clear();
+        vBuckets.clear();
+        nBytes = 0;
+    }
+
+    /** Restart the expiry period of an entry that is still in use */
+    void Touch(const uint256& hash)
+    {
+        typename std::map<uint256, CEntry>::iterator it = mapEntries.find(hash);
+        if (it == mapEntries.end())
+            return;
+        it->second.nTime = GetTime();
+        AddToBucket(hash, it->second.nTime);
+    }
+
+    /** Drop expired entries, and the oldest ones while over the memory cap */
+    void Expire()
+    {
+        Expire(GetTime(), 0);
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return ::GetSerializeSize(mapSeen, nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, mapSeen, nType, nVersion);
+    }
+
+    /** Entries read from disk start a new expiry period */
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        map_type mapRead;
+        ::Unserialize(s, mapRead, nType, nVersion);
+        clear();
+        for (const value_type& entry : mapRead)
+            insert(entry);
+    }
+
+private:
+    struct CEntry {
+        int64_t nTime;
+        size_t nBytes;
+    };
+
+    struct CBucket {
+        int64_t nStart;
+        //! Entries added or touched while the bucket was the newest, may name entries since erased or moved
+        std::deque<uint256> vHashes;
+    };
+
+    const int64_t nExpireSeconds;
+    const int64_t nBucketSeconds;
+    const size_t nMaxBytes;
+    size_t nBytes;
+    map_type mapSeen;
+    std::map<uint256, CEntry> mapEntries;
+    std::deque<CBucket> vBuckets;
+
+    void AddToBucket(const uint256& hash, int64_t nNow)
+    {
+        if (vBuckets.empty() || vBuckets.back().nStart + nBucketSeconds <= nNow) {
+            vBuckets.push_back(CBucket());
+            vBuckets.back().nStart = nNow;
+        }
+        vBuckets.back().vHashes.push_back(hash);
+    }
+
+    void Untrack(const uint256& hash)
+    {
+        typename std::map<uint256, CEntry>::iterator it = mapEntries.find(hash);
+        if (it == mapEntries.end())
+            return;
+        nBytes -= it->second.nBytes;
+        mapEntries.erase(it);
+    }
+
+    void Expire(int64_t nNow, size_t nRoom)
+    {
+        while (!vBuckets.empty()) {
+            CBucket& bucket = vBuckets.front();
+            bool fExpired = nExpireSeconds > 0 && bucket.nStart + nBucketSeconds + nExpireSeconds <= nNow;
+            if (!fExpired && nBytes + nRoom <= nMaxBytes)
+                return;
+            if (bucket.vHashes.empty()) {
+                vBuckets.pop_front();
+                continue;
+            }
+            const uint256 hash = bucket.vHashes.front();
+            bucket.vHashes.pop_front();
+            // Entries touched since then sit in a later bucket as well
+            typename std::map<uint256, CEntry>::iterator it = mapEntries.find(hash);
+            if (it != mapEntries.end() && it->second.nTime < bucket.nStart + nBucketSeconds) {
+                nBytes -= it->second.nBytes;
+                mapEntries.erase(it);
+                mapSeen.erase(hash);
+            }
+        }
+    }
+};
+
+#endif // PRCY_SEENCACHE_H
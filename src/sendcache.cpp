@@ -0,0 +1,51 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sendcache.h"
+
+CSendCache sendCache;
+
+CSerializeDataRef CSendCache::Get(const CInv& inv)
+{
+    LOCK(cs);
+    std::map<CInv, EntryList::iterator>::iterator it = mapEntries.find(inv);
+    if (it == mapEntries.end())
+        return CSerializeDataRef();
+    lruEntries.splice(lruEntries.begin(), lruEntries, it->second);
+    return it->second->second;
+}
+
+void CSendCache::Put(const CInv& inv, const CSerializeDataRef& msg)
+{
+    if (!msg || msg->size() > nMaxSize)
+        return;
+
+    LOCK(cs);
+    if (mapEntries.count(inv))
+        return;
+    lruEntries.push_front(std::make_pair(inv, msg));
+    mapEntries[inv] = lruEntries.begin();
+    nSize += msg->size();
+
+    while (nSize > nMaxSize) {
+        const std::pair<CInv, CSerializeDataRef>& entry = lruEntries.back();
+        nSize -= entry.second->size();
+        mapEntries.erase(entry.first);
+        lruEntries.pop_back();
+    }
+}
+
+void CSendCache::Clear()
+{
+    LOCK(cs);
+    mapEntries.clear();
+    lruEntries.clear();
+    nSize = 0;
+}
+
+size_t CSendCache::size()
+{
+    LOCK(cs);
+    return nSize;
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRCY_SENDCACHE_H
+#define PRCY_SENDCACHE_H
+
+#include "net.h"
+#include "protocol.h"
+#include "sync.h"
+
+#include <list>
+#include <map>
+#include <utility>
+
+//! Maximum total size of the serialized messages kept in the send cache
+static const size_t MAX_SEND_CACHE_SIZE = 16 * 1000 * 1000;
+
+/**
+ * Recently served getdata responses, kept as complete serialized network
+ * messages. A block or transaction requested by many peers is read and
+ * serialized once, and the cached message is shared by reference between
+ * the send queues of all peers it is sent to.
+ *
+ * Entries are evicted least recently used first once the total size
+ * exceeds the limit. Messages larger than the limit are not cached.
+ */
+class CSendCache
+{
+private:
+    typedef std::list<std::pair<CInv, CSerializeDataRef> > EntryList;
+
+    Mutex cs;
+    const size_t nMaxSize;
+    size_t nSize;
+    //! Most recently used entry first
+    EntryList lruEntries;
+    std::map<CInv, EntryList::iterator> mapEntries;
+
+public:
+    explicit CSendCache(size_t nMaxSizeIn = MAX_SEND_CACHE_SIZE) : nMaxSize(nMaxSizeIn), nSize(0) {}
+
+    /** The cached message for inv, or an empty reference */
+    CSerializeDataRef Get(const CInv& inv);
+
+    void Put(const CInv& inv, const CSerializeDataRef& msg);
+
+    void Clear();
+
+    /** Total size of the cached messages */
+    size_t size();
+};
+
+extern CSendCache sendCache;
+
+#endif // PRCY_SENDCACHE_H
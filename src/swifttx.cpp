@@ -18,17 +18,113 @@
 #include "util.h"
 #include "validationinterface.h"
 
+#include <algorithm>
+#include <set>
+
 #include <boost/foreach.hpp>
 
 
 std::map<uint256, CTransaction> mapTxLockReq;
 std::map<uint256, CTransaction> mapTxLockReqRejected;
-std::map<uint256, CConsensusVote> mapTxLockVote;
+CSeenCache<CConsensusVote> mapTxLockVote(SWIFTTX_SEEN_VOTES_EXPIRE_SECONDS, SWIFTTX_SEEN_VOTES_MAX_BYTES);
+RecursiveMutex cs_mapTxLockVote;
 std::map<uint256, CTransactionLock> mapTxLocks;
-std::map<COutPoint, uint256> mapLockedInputs;
+std::map<CKeyImage, uint256> mapLockedKeyImages;
 std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
 int nCompleteTXLocks;
 
+// expiration time and hash of every lock in mapTxLocks, oldest first
+static std::set<std::pair<int64_t, uint256> > setTxLockExpirations;
+
+// masternodes allowed to sign locks by the block hash they are scored with, ranked once per masternode list version
+struct CSwiftTXSigners {
+    uint64_t nListVersion;
+    int64_t nTime;
+    std::vector<COutPoint> vecSigners;
+};
+static std::map<uint256, CSwiftTXSigners> mapSwiftTXSigners;
+
+static void AddTxLock(const uint256& txHash, int nBlockHeight)
+{
+    CTransactionLock& lock = mapTxLocks[txHash];
+    lock.nBlockHeight = nBlockHeight;
+    lock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
+    lock.nTimeout = GetTime() + (60 * 5);
+    lock.txHash = txHash;
+    setTxLockExpirations.insert(std::make_pair(lock.nExpiration, txHash));
+}
+
+static void ExpireTxLock(CTransactionLock& lock)
+{
+    setTxLockExpirations.erase(std::make_pair(lock.nExpiration, lock.txHash));
+    lock.nExpiration = GetTime();
+    setTxLockExpirations.insert(std::make_pair(lock.nExpiration, lock.txHash));
+}
+
+// ring inputs are identified by their key image, the outpoint only names one of the ring members
+static void LockKeyImages(const CTransaction& tx)
+{
+    for (const CTxIn& in : tx.vin) {
+        if (in.keyImage.IsValid())
+            mapLockedKeyImages.insert(std::make_pair(in.keyImage, tx.GetHash()));
+    }
+}
+
+// Signers up to vin, or all of them if vin is not one, that are no longer enabled. Going disabled
+// does not change the list version, and moves every signer ranked below it up.
+static bool HasDisabledSigner(const std::vector<COutPoint>& vecSigners, const CTxIn& vin)
+{
+    LOCK(mnodeman.cs);
+    for (const COutPoint& outpoint : vecSigners) {
+        CMasternode* pmn = mnodeman.Find(CTxIn(outpoint));
+        if (!pmn)
+            return true;
+        pmn->Check();
+        if (!pmn->IsEnabled())
+            return true;
+        if (outpoint == vin.prevout)
+            break;
+    }
+    return false;
+}
+
+// Rank of vin among the masternodes signing locks at nBlockHeight. Ranks outside
+// the top SWIFTTX_SIGNATURES_TOTAL and unknown masternodes are left to mnodeman.
+static int GetSignerRank(const CTxIn& vin, int nBlockHeight)
+{
+    uint256 hashBlock;
+    if (!GetBlockHash(hashBlock, nBlockHeight))
+        return -1;
+
+    std::map<uint256, CSwiftTXSigners>::iterator it = mapSwiftTXSigners.find(hashBlock);
+    if (it == mapSwiftTXSigners.end() || it->second.nListVersion != mnodeman.GetListVersion() ||
+        it->second.nTime + SWIFTTX_SIGNERS_CACHE_SECONDS < GetTime() || HasDisabledSigner(it->second.vecSigners, vin)) {
+        std::vector<COutPoint> vecSigners = mnodeman.GetTopMasternodes(SWIFTTX_SIGNATURES_TOTAL, nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+        if (vecSigners.empty())
+            return mnodeman.GetMasternodeRank(vin, nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+        if (it == mapSwiftTXSigners.end() && mapSwiftTXSigners.size() >= SWIFTTX_SIGNERS_CACHE_SIZE) {
+            std::map<uint256, CSwiftTXSigners>::iterator itOldest = mapSwiftTXSigners.begin();
+            for (std::map<uint256, CSwiftTXSigners>::iterator itSigners = mapSwiftTXSigners.begin(); itSigners != mapSwiftTXSigners.end(); ++itSigners) {
+                if (itSigners->second.nTime < itOldest->second.nTime)
+                    itOldest = itSigners;
+            }
+            mapSwiftTXSigners.erase(itOldest);
+        }
+        CSwiftTXSigners& signers = mapSwiftTXSigners[hashBlock];
+        signers.nListVersion = mnodeman.GetListVersion();
+        signers.nTime = GetTime();
+        signers.vecSigners.swap(vecSigners);
+        it = mapSwiftTXSigners.find(hashBlock);
+    }
+
+    const std::vector<COutPoint>& vecSigners = it->second.vecSigners;
+    std::vector<COutPoint>::const_iterator itSigner = std::find(vecSigners.begin(), vecSigners.end(), vin.prevout);
+    if (itSigner != vecSigners.end())
+        return itSigner - vecSigners.begin() + 1;
+
+    return mnodeman.GetMasternodeRank(vin, nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+}
+
 //txlock - Locks transaction
 //
 //step 1.) Broadcast intention to lock transaction inputs, "txlreg", CTransaction
@@ -75,7 +171,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         bool fAccepted = false;
         {
             LOCK(cs_main);
-            fAccepted = AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs);
+            fAccepted = AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, false, HaveVerifiedProofs(tx.GetHash()));
         }
         if (fAccepted) {
             RelayInv(inv);
@@ -103,11 +199,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
                 tx.GetHash().ToString().c_str());
 
-            for (const CTxIn& in : tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(std::make_pair(in.prevout, tx.GetHash()));
-                }
-            }
+            LockKeyImages(tx);
 
             // resolve conflicts
             std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
@@ -133,11 +225,14 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash())) {
-            return;
-        }
+        {
+            LOCK(cs_mapTxLockVote);
+            if (mapTxLockVote.count(ctx.GetHash())) {
+                return;
+            }
 
-        mapTxLockVote.insert(std::make_pair(ctx.GetHash(), ctx));
+            mapTxLockVote.insert(std::make_pair(ctx.GetHash(), ctx));
+        }
 
         if (ProcessConsensusVote(pfrom, ctx)) {
             //Spam/Dos protection
@@ -236,12 +331,7 @@ int64_t CreateNewLock(CTransaction tx)
     if (!mapTxLocks.count(tx.GetHash())) {
         LogPrintf("CreateNewLock - New Transaction Lock %s !\n", tx.GetHash().ToString().c_str());
 
-        CTransactionLock newLock;
-        newLock.nBlockHeight = nBlockHeight;
-        newLock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = tx.GetHash();
-        mapTxLocks.insert(std::make_pair(tx.GetHash(), newLock));
+        AddTxLock(tx.GetHash(), nBlockHeight);
     } else {
         mapTxLocks[tx.GetHash()].nBlockHeight = nBlockHeight;
         LogPrint(BCLog::MASTERNODE, "CreateNewLock - Transaction Lock Exists %s !\n", tx.GetHash().ToString().c_str());
@@ -256,7 +346,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
 {
     if (!fMasterNode) return;
 
-    int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+    int n = GetSignerRank(activeMasternode.vin, nBlockHeight);
 
     if (n == -1) {
         LogPrint(BCLog::MASTERNODE, "SwiftX::DoConsensusVote - Unknown Masternode\n");
@@ -286,7 +376,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    WITH_LOCK(cs_mapTxLockVote, mapTxLockVote.insert(std::make_pair(ctx.GetHash(), ctx)));
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
     RelayInv(inv);
@@ -295,7 +385,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
 //received a consensus vote
 bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
 {
-    int n = mnodeman.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+    int n = GetSignerRank(ctx.vinMasternode, ctx.nBlockHeight);
 
     CMasternode* pmn = mnodeman.Find(ctx.vinMasternode);
     if (pmn != NULL)
@@ -323,12 +413,7 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
     if (!mapTxLocks.count(ctx.txHash)) {
         LogPrintf("SwiftX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString().c_str());
 
-        CTransactionLock newLock;
-        newLock.nBlockHeight = 0;
-        newLock.nExpiration = GetTime() + (60 * 60);
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(std::make_pair(ctx.txHash, newLock));
+        AddTxLock(ctx.txHash, 0);
     } else
         LogPrint(BCLog::MASTERNODE, "SwiftX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
 
@@ -361,11 +446,7 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
 #endif
 
                 if (mapTxLockReq.count(ctx.txHash)) {
-                    for (const CTxIn& in : tx.vin) {
-                        if (!mapLockedInputs.count(in.prevout)) {
-                            mapLockedInputs.insert(std::make_pair(in.prevout, ctx.txHash));
-                        }
-                    }
+                    LockKeyImages(tx);
                 }
 
                 // resolve conflicts
@@ -393,13 +474,12 @@ bool CheckForConflictingLocks(CTransaction& tx)
         rescan the blocks and find they're acceptable and then take the chain with the most work.
     */
     for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                LogPrintf("SwiftX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), mapLockedInputs[in.prevout].ToString().c_str());
-                if (mapTxLocks.count(tx.GetHash())) mapTxLocks[tx.GetHash()].nExpiration = GetTime();
-                if (mapTxLocks.count(mapLockedInputs[in.prevout])) mapTxLocks[mapLockedInputs[in.prevout]].nExpiration = GetTime();
-                return true;
-            }
+        std::map<CKeyImage, uint256>::iterator it = mapLockedKeyImages.find(in.keyImage);
+        if (it != mapLockedKeyImages.end() && it->second != tx.GetHash()) {
+            LogPrintf("SwiftX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), it->second.ToString().c_str());
+            if (mapTxLocks.count(tx.GetHash())) ExpireTxLock(mapTxLocks[tx.GetHash()]);
+            if (mapTxLocks.count(it->second)) ExpireTxLock(mapTxLocks[it->second]);
+            return true;
         }
     }
 
@@ -425,29 +505,36 @@ void CleanTransactionLocksList()
 {
     if (chainActive.Tip() == NULL) return;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
+    //keep them for an hour
+    const int64_t nNow = GetTime();
+    while (!setTxLockExpirations.empty() && setTxLockExpirations.begin()->first < nNow) {
+        const uint256 txHash = setTxLockExpirations.begin()->second;
+        setTxLockExpirations.erase(setTxLockExpirations.begin());
 
-    while (it != mapTxLocks.end()) {
-        if (GetTime() > it->second.nExpiration) { //keep them for an hour
-            LogPrintf("Removing old transaction lock %s\n", it->second.txHash.ToString().c_str());
+        std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.find(txHash);
+        if (it == mapTxLocks.end())
+            continue;
 
-            if (mapTxLockReq.count(it->second.txHash)) {
-                CTransaction& tx = mapTxLockReq[it->second.txHash];
+        LogPrintf("Removing old transaction lock %s\n", txHash.ToString().c_str());
 
-                for (const CTxIn& in : tx.vin)
-                    mapLockedInputs.erase(in.prevout);
+        if (mapTxLockReq.count(txHash)) {
+            CTransaction& tx = mapTxLockReq[txHash];
 
-                mapTxLockReq.erase(it->second.txHash);
-                mapTxLockReqRejected.erase(it->second.txHash);
-
-                for (CConsensusVote& v : it->second.vecConsensusVotes)
-                    mapTxLockVote.erase(v.GetHash());
+            for (const CTxIn& in : tx.vin) {
+                std::map<CKeyImage, uint256>::iterator itLocked = mapLockedKeyImages.find(in.keyImage);
+                if (itLocked != mapLockedKeyImages.end() && itLocked->second == txHash)
+                    mapLockedKeyImages.erase(itLocked);
             }
 
-            mapTxLocks.erase(it++);
-        } else {
-            it++;
+            mapTxLockReq.erase(txHash);
+            mapTxLockReqRejected.erase(txHash);
+
+            LOCK(cs_mapTxLockVote);
+            for (CConsensusVote& v : it->second.vecConsensusVotes)
+                mapTxLockVote.erase(v.GetHash());
         }
+
+        mapTxLocks.erase(it);
     }
 }
 
@@ -467,10 +554,15 @@ uint256 CConsensusVote::GetHash() const
 }
 
 
+std::string CConsensusVote::GetStrMessage() const
+{
+    return Hash(txHash.begin(), txHash.end(), BEGIN(nBlockHeight), END(nBlockHeight)).ToString();
+}
+
 bool CConsensusVote::SignatureValid()
 {
     std::string strError = "";
-    std::string strMessage = Hash(txHash.begin(), txHash.end(), BEGIN(nBlockHeight), END(nBlockHeight)).ToString();
+    std::string strMessage = GetStrMessage();
 
     CMasternode* pmn = mnodeman.Find(vinMasternode);
 
@@ -493,7 +585,7 @@ bool CConsensusVote::Sign()
 
     CKey key2;
     CPubKey pubkey2;
-    std::string strMessage = Hash(txHash.begin(), txHash.end(), BEGIN(nBlockHeight), END(nBlockHeight)).GetHex();
+    std::string strMessage = GetStrMessage();
 
     if (!CMessageSigner::GetKeysFromSecret(strMasterNodePrivKey, key2, pubkey2)) {
         return error("%s : Invalid masternodeprivkey", __func__);
@@ -514,7 +606,7 @@ bool CConsensusVote::Sign()
 bool CTransactionLock::SignaturesValid()
 {
     for (CConsensusVote vote : vecConsensusVotes) {
-        int n = mnodeman.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+        int n = GetSignerRank(vote.vinMasternode, vote.nBlockHeight);
 
         if (n == -1) {
             LogPrintf("CTransactionLock::SignaturesValid() - Unknown Masternode\n");
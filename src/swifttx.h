@@ -11,6 +11,7 @@
 #include "key.h"
 #include "main.h"
 #include "net.h"
+#include "seencache.h"
 #include "sync.h"
 #include "util.h"
 
@@ -25,6 +26,10 @@
 */
 #define SWIFTTX_SIGNATURES_REQUIRED 6
 #define SWIFTTX_SIGNATURES_TOTAL 10
+#define SWIFTTX_SEEN_VOTES_EXPIRE_SECONDS (2 * 60 * 60)
+#define SWIFTTX_SEEN_VOTES_MAX_BYTES (16 * 1024 * 1024)
+#define SWIFTTX_SIGNERS_CACHE_SECONDS 60
+#define SWIFTTX_SIGNERS_CACHE_SIZE 16
 
 
 class CConsensusVote;
@@ -35,9 +40,11 @@ static const int MIN_SWIFTTX_PROTO_VERSION = 70103;
 
 extern std::map<uint256, CTransaction> mapTxLockReq;
 extern std::map<uint256, CTransaction> mapTxLockReqRejected;
-extern std::map<uint256, CConsensusVote> mapTxLockVote;
+extern CSeenCache<CConsensusVote> mapTxLockVote;
+// guards mapTxLockVote, which the message verification threads read too
+extern RecursiveMutex cs_mapTxLockVote;
 extern std::map<uint256, CTransactionLock> mapTxLocks;
-extern std::map<COutPoint, uint256> mapLockedInputs;
+extern std::map<CKeyImage, uint256> mapLockedKeyImages;
 extern int nCompleteTXLocks;
 
 
@@ -76,6 +83,7 @@ public:
 
     bool SignatureValid();
     bool Sign();
+    std::string GetStrMessage() const;
 
     ADD_SERIALIZE_METHODS;
 
@@ -95,8 +103,8 @@ public:
     int nBlockHeight;
     uint256 txHash;
     std::vector<CConsensusVote> vecConsensusVotes;
-    int nExpiration;
-    int nTimeout;
+    int64_t nExpiration;
+    int64_t nTimeout;
 
     bool SignaturesValid();
     int CountSignatures();
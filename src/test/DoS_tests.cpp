@@ -32,6 +32,8 @@ extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
+    int64_t nTimeExpire;
+    std::set<uint256> setMissing;
 };
 extern std::map<uint256, COrphanTx> mapOrphanTransactions;
 extern std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
@@ -119,6 +121,7 @@ CTransaction RandomOrphan()
 
 BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
 {
+    LOCK(cs_main);
     CKey key;
     key.MakeNewKey(true);
     CBasicKeyStore keystore;
@@ -198,4 +201,41 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
 }
 
+BOOST_AUTO_TEST_CASE(DoS_mapOrphansRingMembers)
+{
+    LOCK(cs_main);
+    CMutableTransaction tx;
+    tx.vin.resize(2);
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        tx.vin[i].prevout = COutPoint(InsecureRand256(), 0);
+        tx.vin[i].decoys.push_back(COutPoint(InsecureRand256(), 1));
+    }
+    // Ring members shared by several inputs are only waited for once
+    tx.vin[1].decoys.push_back(COutPoint(tx.vin[0].prevout.hash, 2));
+    tx.vin[0].decoys.push_back(COutPoint(tx.vin[1].prevout.hash, 2));
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1*CENT;
+
+    // The orphan waits for every missing ring member, decoys included
+    BOOST_CHECK(AddOrphanTx(tx, 0));
+    BOOST_CHECK(!AddOrphanTx(tx, 1));
+    const uint256 hash = tx.GetHash();
+    BOOST_CHECK_EQUAL(mapOrphanTransactions[hash].setMissing.size(), 4U);
+    BOOST_CHECK_EQUAL(mapOrphanTransactionsByPrev.size(), 4U);
+    for (const CTxIn& txin : tx.vin) {
+        BOOST_CHECK(mapOrphanTransactionsByPrev.count(txin.prevout.hash));
+        for (const COutPoint& decoy : txin.decoys)
+            BOOST_CHECK(mapOrphanTransactionsByPrev[decoy.hash].count(hash));
+    }
+
+    // Orphans that keep waiting expire
+    LimitOrphanTxSize(DEFAULT_MAX_ORPHAN_TRANSACTIONS);
+    BOOST_CHECK_EQUAL(mapOrphanTransactions.size(), 1U);
+    SetMockTime(GetTime() + ORPHAN_TX_EXPIRE_TIME + ORPHAN_TX_EXPIRE_INTERVAL + 1);
+    LimitOrphanTxSize(DEFAULT_MAX_ORPHAN_TRANSACTIONS);
+    BOOST_CHECK(mapOrphanTransactions.empty());
+    BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,117 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+#include "consensus/merkle.h"
+#include "txmempool.h"
+#include "version.h"
+
+#include "test/test_prcycoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockencodings_tests, BasicTestingSetup)
+
+/** Exposes the prefilled transactions, to corrupt them */
+class TestHeaderAndShortTxIDs : public CBlockHeaderAndShortTxIDs
+{
+public:
+    explicit TestHeaderAndShortTxIDs(const CBlock& block) : CBlockHeaderAndShortTxIDs(block) {}
+    using CBlockHeaderAndShortTxIDs::prefilledtxn;
+};
+
+static CBlock BuildBlock()
+{
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_11;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[0].nValue = 42;
+
+    // Coinbase first, then transactions a peer can have in its mempool
+    block.vtx.push_back(tx);
+    for (int i = 0; i < 3; i++) {
+        tx.vin[0].prevout.hash = GetRandHash();
+        tx.vin[0].prevout.n = i;
+        block.vtx.push_back(tx);
+    }
+    block.nVersion = 1;
+    block.hashPrevBlock = GetRandHash();
+    block.nBits = 0x207fffff;
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(cmpctblock_reconstruction)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildBlock());
+    pool.addUnchecked(block.vtx[2].GetHash(), CTxMemPoolEntry(block.vtx[2], 0, 0, 0.0, 1));
+
+    // Send the compact block over the wire
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CBlockHeaderAndShortTxIDs(block);
+    CBlockHeaderAndShortTxIDs cmpctblock;
+    stream >> cmpctblock;
+    BOOST_CHECK_EQUAL(cmpctblock.BlockTxCount(), block.vtx.size());
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(cmpctblock) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(partialBlock.IsTxAvailable(2));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(3));
+    BOOST_CHECK_EQUAL(partialBlock.GetMempoolCount(), 1);
+
+    CBlock reconstructed;
+    std::vector<CTransaction> vtx_missing;
+    vtx_missing.push_back(block.vtx[1]);
+    BOOST_CHECK(partialBlock.FillBlock(reconstructed, vtx_missing) == READ_STATUS_INVALID);
+
+    // Transactions in the wrong order give the wrong merkle root
+    vtx_missing.insert(vtx_missing.begin(), block.vtx[3]);
+    BOOST_CHECK(partialBlock.FillBlock(reconstructed, vtx_missing) == READ_STATUS_FAILED);
+
+    std::swap(vtx_missing[0], vtx_missing[1]);
+    BOOST_CHECK(partialBlock.FillBlock(reconstructed, vtx_missing) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(reconstructed.GetHash().ToString(), block.GetHash().ToString());
+    BOOST_CHECK_EQUAL(reconstructed.vtx.size(), block.vtx.size());
+    BOOST_CHECK_EQUAL(BlockMerkleRoot(reconstructed).ToString(), block.hashMerkleRoot.ToString());
+}
+
+BOOST_AUTO_TEST_CASE(cmpctblock_invalid)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestHeaderAndShortTxIDs cmpctblock(BuildBlock());
+
+    // A prefilled transaction past the end of the block
+    cmpctblock.prefilledtxn[0].index = 10;
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(cmpctblock) == READ_STATUS_INVALID);
+}
+
+BOOST_AUTO_TEST_CASE(getblocktxn_serialization)
+{
+    BlockTransactionsRequest req;
+    req.blockhash = GetRandHash();
+    req.indexes.push_back(0);
+    req.indexes.push_back(1);
+    req.indexes.push_back(3);
+    req.indexes.push_back(500);
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << req;
+    BlockTransactionsRequest req2;
+    stream >> req2;
+    BOOST_CHECK_EQUAL(req2.blockhash.ToString(), req.blockhash.ToString());
+    BOOST_CHECK(req2.indexes == req.indexes);
+
+    BlockTransactions resp(req2);
+    BOOST_CHECK_EQUAL(resp.txn.size(), req.indexes.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
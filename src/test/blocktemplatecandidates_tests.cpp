@@ -0,0 +1,70 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "main.h"
+#include "miner.h"
+#include "txmempool.h"
+
+#include "test/test_prcycoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blocktemplatecandidates_tests, TestingSetup)
+
+class CTestBlockTemplateCandidates : public CBlockTemplateCandidates
+{
+public:
+    void Add(const CTransaction& tx, CAmount nFee)
+    {
+        LOCK(cs);
+        const unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        AddCandidate(tx.GetHash(), nTxSize, nFee, CFeeRate(nFee, nTxSize));
+    }
+};
+
+BOOST_AUTO_TEST_CASE(blocktemplatecandidates_evicted)
+{
+    CTestBlockTemplateCandidates candidates;
+    std::vector<CTransaction> vtx;
+    for (int i = 0; i < 4; i++) {
+        CMutableTransaction tx;
+        tx.nLockTime = i;
+        vtx.push_back(tx);
+        candidates.Add(vtx.back(), (i + 1) * COIN);
+    }
+
+    // The second best and the worst left the pool after they were checked
+    mempool.addUnchecked(vtx[0].GetHash(), CTxMemPoolEntry(vtx[0], COIN, GetTime(), 0, 0));
+    mempool.addUnchecked(vtx[1].GetHash(), CTxMemPoolEntry(vtx[1], 2 * COIN, GetTime(), 0, 0));
+    mempool.addUnchecked(vtx[3].GetHash(), CTxMemPoolEntry(vtx[3], 4 * COIN, GetTime(), 0, 0));
+    std::list<CTransaction> removed;
+    mempool.remove(vtx[0], removed);
+
+    CBlockTemplate blocktemplate;
+    uint64_t nBlockSize = 0, nBlockTx = 0;
+    CAmount nFees = 0;
+    {
+        LOCK(mempool.cs);
+        candidates.Select(1, 1000000, 0, 0, &blocktemplate, nBlockSize, nBlockTx, nFees);
+    }
+    BOOST_REQUIRE_EQUAL(blocktemplate.block.vtx.size(), 2U);
+    BOOST_CHECK(blocktemplate.block.vtx[0].GetHash() == vtx[3].GetHash());
+    BOOST_CHECK(blocktemplate.block.vtx[1].GetHash() == vtx[1].GetHash());
+    BOOST_CHECK_EQUAL(nBlockTx, 2U);
+    BOOST_CHECK_EQUAL(nFees, 6 * COIN);
+    BOOST_CHECK_EQUAL(candidates.size(), 2U);
+
+    // The evicted ones are gone for the next template
+    blocktemplate = CBlockTemplate();
+    nBlockSize = nBlockTx = 0;
+    nFees = 0;
+    {
+        LOCK(mempool.cs);
+        candidates.Select(1, 1000000, 0, 0, &blocktemplate, nBlockSize, nBlockTx, nFees);
+    }
+    BOOST_CHECK_EQUAL(blocktemplate.block.vtx.size(), 2U);
+    mempool.clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,106 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cachejournal.h"
+#include "util.h"
+
+#include "test/test_prcycoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(cachejournal_tests, TestingSetup)
+
+static std::vector<std::pair<unsigned char, std::string> > Replay(CCacheJournal& journal)
+{
+    std::vector<std::pair<unsigned char, std::string> > vRecords;
+    BOOST_CHECK(journal.Open([&vRecords](unsigned char nType, CDataStream& ssRecord) {
+        std::string str;
+        ssRecord >> str;
+        vRecords.push_back(std::make_pair(nType, str));
+    }));
+    return vRecords;
+}
+
+BOOST_AUTO_TEST_CASE(cachejournal_replay)
+{
+    CCacheJournal journal("test.journal", "TestCache");
+    BOOST_CHECK(!journal.IsOpen());
+    journal.Append(1, std::string("dropped"));
+    BOOST_CHECK(Replay(journal).empty());
+    BOOST_CHECK_EQUAL(journal.GetSize(), 0);
+
+    journal.Append(1, std::string("one"));
+    journal.Append(2, std::string("two"));
+    BOOST_CHECK(journal.GetSize() > 0);
+    journal.Close();
+
+    std::vector<std::pair<unsigned char, std::string> > vRecords = Replay(journal);
+    BOOST_REQUIRE_EQUAL(vRecords.size(), 2);
+    BOOST_CHECK_EQUAL(vRecords[0].first, 1);
+    BOOST_CHECK_EQUAL(vRecords[0].second, "one");
+    BOOST_CHECK_EQUAL(vRecords[1].first, 2);
+    BOOST_CHECK_EQUAL(vRecords[1].second, "two");
+
+    // Appending goes on after what was replayed
+    journal.Append(3, std::string("three"));
+    journal.Close();
+    BOOST_CHECK_EQUAL(Replay(journal).size(), 3);
+
+    // Records rotated by a checkpoint are replayed until its file is in place
+    BOOST_CHECK(journal.Rotate());
+    BOOST_CHECK_EQUAL(journal.GetSize(), 0);
+    journal.Append(4, std::string("four"));
+    journal.Close();
+    vRecords = Replay(journal);
+    BOOST_REQUIRE_EQUAL(vRecords.size(), 4);
+    BOOST_CHECK_EQUAL(vRecords[3].second, "four");
+
+    // A failed checkpoint leaves them for the next one
+    BOOST_CHECK(journal.Rotate());
+    journal.Append(5, std::string("five"));
+    journal.Close();
+    BOOST_CHECK_EQUAL(Replay(journal).size(), 5);
+
+    // Only the records after the last rotation are left once it completes
+    journal.RemoveRotated();
+    journal.Close();
+    vRecords = Replay(journal);
+    BOOST_REQUIRE_EQUAL(vRecords.size(), 2);
+    BOOST_CHECK_EQUAL(vRecords[0].second, "four");
+    BOOST_CHECK_EQUAL(vRecords[1].second, "five");
+    BOOST_CHECK(journal.Rotate());
+    journal.RemoveRotated();
+    journal.Close();
+    BOOST_CHECK(Replay(journal).empty());
+}
+
+BOOST_AUTO_TEST_CASE(cachejournal_torn_record)
+{
+    const fs::path path = GetDataDir() / "torn.journal";
+    CCacheJournal journal("torn.journal", "TestCache");
+    Replay(journal);
+    journal.Append(1, std::string("kept"));
+    const size_t nKeptSize = fs::file_size(path);
+    journal.Append(2, std::string("torn by a crash"));
+    journal.Close();
+
+    // The record cut short is dropped, and written over by the next one
+    fs::resize_file(path, fs::file_size(path) - 3);
+    std::vector<std::pair<unsigned char, std::string> > vRecords = Replay(journal);
+    BOOST_REQUIRE_EQUAL(vRecords.size(), 1);
+    BOOST_CHECK_EQUAL(vRecords[0].second, "kept");
+    BOOST_CHECK_EQUAL(fs::file_size(path), nKeptSize);
+    journal.Append(3, std::string("after"));
+    journal.Close();
+    vRecords = Replay(journal);
+    BOOST_REQUIRE_EQUAL(vRecords.size(), 2);
+    BOOST_CHECK_EQUAL(vRecords[1].second, "after");
+
+    // A journal of another cache is started over
+    journal.Close();
+    CCacheJournal other("torn.journal", "OtherCache");
+    BOOST_CHECK(Replay(other).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -75,6 +75,28 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_point_reads)
+{
+    {
+        fs::path ph = fs::temp_directory_path() / fs::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, DB_PROFILE_POINT_READS);
+
+        BOOST_CHECK_EQUAL(dbw.GetCacheStats().nCacheSize, (size_t)(1 << 20) / 4 * 3);
+
+        uint256 in = GetRandHash();
+        uint256 res;
+        BOOST_CHECK(dbw.Write(std::make_pair('k', std::string("a")), in));
+
+        // After compaction the value is served from a table file through the block cache
+        dbw.CompactRange(std::make_pair('k', std::string()), std::make_pair('l', std::string()));
+        BOOST_CHECK(dbw.Read(std::make_pair('k', std::string("a")), res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+
+        CDBCacheStats stats = dbw.GetCacheStats();
+        BOOST_CHECK(stats.nHits + stats.nMisses > 0);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 {
     {
@@ -0,0 +1,82 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-budget.h"
+
+#include "test/test_prcycoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternodebudget_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(masternodebudget_vote_tallies)
+{
+    CBudgetProposal proposal;
+    std::vector<CTxIn> vins;
+    for (int i = 0; i < 3; i++)
+        vins.push_back(CTxIn(COutPoint(GetRandHash(), i)));
+
+    std::string strError;
+    CBudgetVote vote1(vins[0], proposal.GetHash(), VOTE_YES);
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote1, strError));
+    CBudgetVote vote2(vins[1], proposal.GetHash(), VOTE_YES);
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote2, strError));
+    CBudgetVote vote3(vins[2], proposal.GetHash(), VOTE_NO);
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote3, strError));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 2);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 1);
+
+    // A masternode changing its vote moves it to the other tally
+    CBudgetVote vote4(vins[0], proposal.GetHash(), VOTE_NO);
+    vote4.nTime = vote1.nTime + BUDGET_VOTE_UPDATE_MIN;
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote4, strError));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 1);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 2);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << proposal;
+    CBudgetProposal proposal2;
+    ss >> proposal2;
+    BOOST_CHECK_EQUAL(proposal2.GetYeas(), 1);
+    BOOST_CHECK_EQUAL(proposal2.GetNays(), 2);
+
+    // None of these masternodes is listed, so none of the votes counts
+    proposal.CleanAndRemove(false);
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 0);
+    BOOST_CHECK_CLOSE(proposal.GetRatio(), 1.0 / 3, 0.0001);
+}
+
+BOOST_AUTO_TEST_CASE(masternodebudget_vote_lookup)
+{
+    CBudgetManager manager;
+    CBudgetProposal proposal;
+    uint256 nProposalHash = proposal.GetHash();
+    manager.mapProposals.insert(std::make_pair(nProposalHash, proposal));
+    CTxIn vin(COutPoint(GetRandHash(), 0));
+
+    std::string strError;
+    CBudgetVote vote1(vin, nProposalHash, VOTE_YES);
+    BOOST_REQUIRE(manager.UpdateProposal(vote1, NULL, strError));
+    CBudgetVote vote2(vin, nProposalHash, VOTE_NO);
+    vote2.nTime = vote1.nTime + BUDGET_VOTE_UPDATE_MIN;
+    BOOST_REQUIRE(manager.UpdateProposal(vote2, NULL, strError));
+
+    // Votes that left the seen cache are served from the proposal, replaced ones are gone
+    CBudgetVote vote;
+    BOOST_CHECK(manager.mapSeenMasternodeBudgetVotes.empty());
+    BOOST_CHECK(manager.GetProposalVote(vote2.GetHash(), vote));
+    BOOST_CHECK(vote.GetHash() == vote2.GetHash());
+    BOOST_CHECK(!manager.GetProposalVote(vote1.GetHash(), vote));
+
+    // The lookup survives a round trip through budget.dat
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << manager;
+    CBudgetManager manager2;
+    ss >> manager2;
+    BOOST_CHECK(manager2.GetProposalVote(vote2.GetHash(), vote));
+    BOOST_CHECK(!manager2.GetProposalVote(vote1.GetHash(), vote));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
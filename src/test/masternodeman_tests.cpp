@@ -0,0 +1,179 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternodeman.h"
+#include "random.h"
+
+#include "test/test_prcycoin.h"
+
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternodeman_tests, TestingSetup)
+
+static CMasternode MakeMasternode()
+{
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(GetRandHash(), 1));
+    mn.vin.masternodeStealthAddress.assign(10, (unsigned char)GetRandInt(256));
+    CKey key;
+    key.MakeNewKey(true);
+    mn.pubKeyCollateralAddress = key.GetPubKey();
+    key.MakeNewKey(true);
+    mn.pubKeyMasternode = key.GetPubKey();
+    return mn;
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_mncache_format)
+{
+    // mncache.dat as written when the masternodes were kept in a vector
+    std::vector<CMasternode> vMasternodes;
+    for (int i = 0; i < 3; i++)
+        vMasternodes.push_back(MakeMasternode());
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << vMasternodes;
+    ss << std::map<CNetAddr, int64_t>() << std::map<CNetAddr, int64_t>() << std::map<COutPoint, int64_t>();
+    ss << (int64_t)42;
+    ss << std::map<uint256, CMasternodeBroadcast>() << std::map<uint256, CMasternodePing>();
+    const std::string strOld = ss.str();
+
+    CMasternodeMan man;
+    ss >> man;
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK_EQUAL(man.size(), 3);
+    BOOST_CHECK_EQUAL(man.nDsqCount, 42);
+
+    CDataStream ss2(SER_DISK, CLIENT_VERSION);
+    ss2 << man;
+    BOOST_CHECK(ss2.str() == strOld);
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_find)
+{
+    CMasternodeMan man;
+    std::vector<CMasternode> vMasternodes;
+    for (int i = 0; i < 3; i++) {
+        vMasternodes.push_back(MakeMasternode());
+        BOOST_CHECK(man.Add(vMasternodes.back()));
+    }
+    BOOST_CHECK(!man.Add(vMasternodes[0]));
+
+    for (const CMasternode& mn : vMasternodes) {
+        CMasternode* pmn = man.Find(mn.vin);
+        BOOST_REQUIRE(pmn != NULL);
+        BOOST_CHECK(pmn->vin.prevout == mn.vin.prevout);
+        BOOST_CHECK(man.Find(mn.pubKeyMasternode) == pmn);
+        BOOST_CHECK(man.Find(GetScriptForDestination(mn.pubKeyCollateralAddress)) == pmn);
+        BOOST_CHECK(man.Find(mn.vin.masternodeStealthAddress) == pmn);
+    }
+
+    // Entries stay where they are when others go
+    CMasternode* pmn = man.Find(vMasternodes[2].vin);
+    man.Remove(vMasternodes[0].vin);
+    BOOST_CHECK(man.Find(vMasternodes[0].vin) == NULL);
+    BOOST_CHECK(man.Find(vMasternodes[0].pubKeyMasternode) == NULL);
+    BOOST_CHECK(man.Find(vMasternodes[2].vin) == pmn);
+    BOOST_CHECK_EQUAL(man.size(), 2);
+
+    // A newer broadcast with a new masternode key is found under that key only
+    CMasternodeBroadcast mnb(*pmn);
+    CKey key;
+    key.MakeNewKey(true);
+    mnb.pubKeyMasternode = key.GetPubKey();
+    mnb.sigTime = pmn->sigTime + 1;
+    BOOST_CHECK(man.UpdateFromNewBroadcast(*pmn, mnb));
+    BOOST_CHECK(man.Find(mnb.pubKeyMasternode) == pmn);
+    BOOST_CHECK(man.Find(vMasternodes[2].pubKeyMasternode) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_ranks)
+{
+    CMasternodeMan man;
+    std::vector<CMasternode> vMasternodes;
+    for (int i = 0; i < 5; i++) {
+        // Pinged and without a collateral to look up, so Check() keeps them enabled
+        CMasternode mn = MakeMasternode();
+        mn.unitTest = true;
+        mn.lastPing.vin = mn.vin;
+        mn.lastPing.sigTime = GetAdjustedTime();
+        vMasternodes.push_back(mn);
+        BOOST_CHECK(man.Add(vMasternodes.back()));
+    }
+
+    uint256 hash;
+    BOOST_REQUIRE(GetBlockHash(hash, 0));
+    int64_t nLastScore = std::numeric_limits<int64_t>::max();
+    for (int nRank = 1; nRank <= 5; nRank++) {
+        CMasternode* pmn = man.GetMasternodeByRank(nRank, 0, 0, false);
+        BOOST_REQUIRE(pmn != NULL);
+        BOOST_CHECK_EQUAL(man.GetMasternodeRank(pmn->vin, 0, 0, false), nRank);
+        int64_t nScore = pmn->CalculateScore(hash).GetCompact(false);
+        BOOST_CHECK(nScore <= nLastScore);
+        nLastScore = nScore;
+    }
+    BOOST_CHECK(man.GetMasternodeByRank(6, 0, 0, false) == NULL);
+
+    // The top list agrees with the ranks of enabled masternodes
+    std::vector<COutPoint> vecTop = man.GetTopMasternodes(3, 0);
+    BOOST_REQUIRE_EQUAL(vecTop.size(), 3U);
+    for (size_t i = 0; i < vecTop.size(); i++) {
+        BOOST_CHECK_EQUAL(man.GetMasternodeRank(CTxIn(vecTop[i]), 0), (int)i + 1);
+        CMasternode* pmn = man.GetMasternodeByRank(i + 1, 0);
+        BOOST_REQUIRE(pmn != NULL);
+        BOOST_CHECK(pmn->vin.prevout == vecTop[i]);
+    }
+
+    // One going disabled leaves its place to the next
+    CMasternode* pmnFirst = man.Find(CTxIn(vecTop[0]));
+    BOOST_REQUIRE(pmnFirst != NULL);
+    pmnFirst->lastPing.sigTime = GetAdjustedTime() - MASTERNODE_EXPIRATION_SECONDS;
+    pmnFirst->Check(true);
+    BOOST_CHECK(!pmnFirst->IsEnabled());
+    std::vector<COutPoint> vecTopAfter = man.GetTopMasternodes(3, 0);
+    BOOST_REQUIRE_EQUAL(vecTopAfter.size(), 3U);
+    BOOST_CHECK(vecTopAfter[0] == vecTop[1]);
+    BOOST_CHECK(vecTopAfter[1] == vecTop[2]);
+
+    // Ranks follow list changes
+    vMasternodes.push_back(MakeMasternode());
+    BOOST_CHECK(man.Add(vMasternodes.back()));
+    BOOST_CHECK(man.GetMasternodeRank(vMasternodes.back().vin, 0, 0, false) > 0);
+    BOOST_CHECK(man.GetMasternodeByRank(6, 0, 0, false) != NULL);
+    man.Remove(vMasternodes.back().vin);
+    BOOST_CHECK_EQUAL(man.GetMasternodeRank(vMasternodes.back().vin, 0, 0, false), -1);
+    BOOST_CHECK(man.GetMasternodeByRank(6, 0, 0, false) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_snapshot)
+{
+    CMasternodeMan man;
+    BOOST_CHECK(man.GetSnapshot()->vMasternodes.empty());
+
+    CMasternode mn = MakeMasternode();
+    BOOST_CHECK(man.Add(mn));
+    std::shared_ptr<const CMasternodeListSnapshot> snapshot = man.GetSnapshot();
+    BOOST_CHECK(snapshot->vMasternodes.empty());
+    man.PublishSnapshot();
+    snapshot = man.GetSnapshot();
+    BOOST_REQUIRE_EQUAL(snapshot->vMasternodes.size(), 1);
+    BOOST_CHECK(snapshot->vMasternodes[0].vin.prevout == mn.vin.prevout);
+
+    // Ranked like GetMasternodeRank, 0 when not enabled
+    BOOST_REQUIRE_EQUAL(snapshot->vRanks.size(), 1);
+    int nRank = man.GetMasternodeRank(mn.vin, 0);
+    BOOST_CHECK_EQUAL(snapshot->vRanks[0], nRank > 0 ? nRank : 0);
+
+    // Unchanged and recent, nothing to publish
+    man.PublishSnapshot();
+    BOOST_CHECK(man.GetSnapshot() == snapshot);
+
+    // Readers keep the copy they hold while newer ones get published
+    man.Remove(mn.vin);
+    man.PublishSnapshot();
+    BOOST_CHECK(man.GetSnapshot()->vMasternodes.empty());
+    BOOST_CHECK_EQUAL(snapshot->vMasternodes.size(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
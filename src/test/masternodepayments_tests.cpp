@@ -0,0 +1,91 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-payments.h"
+
+#include "test/test_prcycoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternodepayments_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(masternodepayments_last_paid)
+{
+    CMasternodePayments payments;
+    std::vector<unsigned char> payeeA(10, 'a'), payeeB(10, 'b');
+
+    // One vote is not enough
+    payments.AddPayeeVote(100, payeeA);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 200, 150), 0);
+    payments.AddPayeeVote(100, payeeA);
+    payments.AddPayeeVote(150, payeeA);
+    payments.AddPayeeVote(150, payeeA);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 200, 150), 150);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 149, 150), 100);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 200, 100), 150);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 200, 50), 0);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeB, 200, 150), 0);
+
+    // Survives a round trip through mnpayments.dat
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << payments;
+    CMasternodePayments payments2;
+    ss >> payments2;
+    BOOST_CHECK_EQUAL(payments2.GetLastPaidHeight(payeeA, 149, 150), 100);
+}
+
+BOOST_AUTO_TEST_CASE(masternodepayments_scheduled)
+{
+    CMasternodePayments payments;
+    CMasternode mnA, mnB;
+    mnA.vin.masternodeStealthAddress.assign(10, 'a');
+    mnB.vin.masternodeStealthAddress.assign(10, 'b');
+
+    // The chain tip is the genesis block, the next 8 blocks are looked at
+    payments.AddPayeeVote(5, mnA.vin.masternodeStealthAddress);
+    BOOST_CHECK(payments.IsScheduled(mnA, 1));
+    BOOST_CHECK(!payments.IsScheduled(mnA, 5));
+    BOOST_CHECK(!payments.IsScheduled(mnB, 1));
+
+    // B takes over block 5 with more votes
+    payments.AddPayeeVote(5, mnB.vin.masternodeStealthAddress);
+    payments.AddPayeeVote(5, mnB.vin.masternodeStealthAddress);
+    BOOST_CHECK(!payments.IsScheduled(mnA, 1));
+    BOOST_CHECK(payments.IsScheduled(mnB, 1));
+
+    payments.AddPayeeVote(9, mnA.vin.masternodeStealthAddress);
+    payments.AddPayeeVote(20, mnA.vin.masternodeStealthAddress);
+    BOOST_CHECK(!payments.IsScheduled(mnA, 8));
+    payments.AddPayeeVote(8, mnA.vin.masternodeStealthAddress);
+    BOOST_CHECK(payments.IsScheduled(mnA, 5));
+}
+
+BOOST_AUTO_TEST_CASE(masternodepayments_required_payees)
+{
+    CMasternodePayments payments;
+    std::vector<unsigned char> payeeA(10, 'a'), payeeB(10, 'b');
+    CMutableTransaction txPaysA, txPaysB;
+    txPaysA.vout.resize(1);
+    txPaysA.vout[0].nValue = MAX_MONEY_OUT;
+    txPaysA.vout[0].masternodeStealthAddress = payeeA;
+    txPaysB = txPaysA;
+    txPaysB.vout[0].masternodeStealthAddress = payeeB;
+
+    // Without enough votes on a payee any payment goes
+    for (int i = 1; i < MNPAYMENTS_SIGNATURES_REQUIRED; i++)
+        payments.AddPayeeVote(10, payeeA);
+    BOOST_CHECK(payments.IsTransactionValid(txPaysB, 10));
+    BOOST_CHECK_EQUAL(payments.GetRequiredPaymentsString(10), std::string(payeeA.begin(), payeeA.end()) + ":" + std::to_string(MNPAYMENTS_SIGNATURES_REQUIRED - 1));
+
+    // The next vote makes the payee required, checked results follow it
+    payments.AddPayeeVote(10, payeeA);
+    BOOST_CHECK(payments.IsTransactionValid(txPaysA, 10));
+    BOOST_CHECK(!payments.IsTransactionValid(txPaysB, 10));
+    for (int i = 0; i < MNPAYMENTS_SIGNATURES_REQUIRED; i++)
+        payments.AddPayeeVote(10, payeeB);
+    BOOST_CHECK(payments.IsTransactionValid(txPaysB, 10));
+    BOOST_CHECK(payments.IsTransactionValid(txPaysB, 11));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
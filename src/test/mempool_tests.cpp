@@ -99,4 +99,94 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+BOOST_AUTO_TEST_CASE(MempoolKeyImageTest)
+{
+    // Test the key image index of CTxMemPool
+
+    std::vector<unsigned char> vchKeyImage(33, 0x11);
+    vchKeyImage[0] = 0x02;
+    CKeyImage keyImage(vchKeyImage);
+    BOOST_CHECK(keyImage.IsValid());
+
+    // Two transactions spending the same key image through different rings:
+    CMutableTransaction txSpend[2];
+    for (int i = 0; i < 2; i++)
+    {
+        txSpend[i].vin.resize(1);
+        txSpend[i].vin[0].prevout.hash = uint256S(i == 0 ? "01" : "02");
+        txSpend[i].vin[0].prevout.n = 0;
+        txSpend[i].vin[0].keyImage = keyImage;
+        txSpend[i].vout.resize(1);
+        txSpend[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txSpend[i].vout[0].nValue = 11000LL;
+    }
+
+    CTxMemPool testPool(CFeeRate(0));
+    std::list<CTransaction> removed;
+
+    // Empty pool, no conflict:
+    BOOST_CHECK(!testPool.HasKeyImageConflict(txSpend[0]));
+
+    testPool.addUnchecked(txSpend[0].GetHash(), CTxMemPoolEntry(txSpend[0], 0, 0, 0.0, 1));
+    uint256 hashConflict;
+    BOOST_CHECK(!testPool.HasKeyImageConflict(txSpend[0]));
+    BOOST_CHECK(testPool.HasKeyImageConflict(txSpend[1], &hashConflict));
+    BOOST_CHECK(hashConflict == txSpend[0].GetHash());
+
+    // A block confirming the other spend evicts the pool transaction:
+    std::vector<CTransaction> vtx;
+    vtx.push_back(txSpend[1]);
+    testPool.removeForBlock(vtx, 2, removed);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    BOOST_CHECK_EQUAL(testPool.size(), 0);
+    BOOST_CHECK_EQUAL(testPool.mapKeyImages.size(), 0);
+    removed.clear();
+
+    // Removal releases the key image:
+    testPool.addUnchecked(txSpend[0].GetHash(), CTxMemPoolEntry(txSpend[0], 0, 0, 0.0, 1));
+    testPool.remove(txSpend[0], removed, false);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    BOOST_CHECK(!testPool.HasKeyImageConflict(txSpend[1]));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+
+    // Three unrelated transactions paying increasing fees
+    CMutableTransaction tx[3];
+    for (int i = 0; i < 3; i++)
+    {
+        tx[i].vin.resize(1);
+        tx[i].vin[0].scriptSig = CScript() << OP_11;
+        tx[i].vin[0].prevout.hash = uint256S(strprintf("%02x", i + 1));
+        tx[i].vout.resize(1);
+        tx[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx[i].vout[0].nValue = 10 * COIN;
+        pool.addUnchecked(tx[i].GetHash(), CTxMemPoolEntry(tx[i], 10000LL * (i + 1), 0, 10.0, 1));
+    }
+    BOOST_CHECK_EQUAL(pool.size(), 3);
+    BOOST_CHECK(pool.GetMinFee(1).GetFeePerK() == 0);
+
+    // Nothing is evicted while under the limit
+    pool.TrimToSize(pool.DynamicMemoryUsage());
+    BOOST_CHECK_EQUAL(pool.size(), 3);
+
+    // The lowest fee rate transaction goes first
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK_EQUAL(pool.size(), 2);
+    BOOST_CHECK(!pool.exists(tx[0].GetHash()));
+    BOOST_CHECK(pool.exists(tx[1].GetHash()));
+    BOOST_CHECK_EQUAL(pool.GetEvictedTx(), 1);
+    BOOST_CHECK(pool.GetEvictedBytes() > 0);
+
+    // ... and the rolling minimum fee is bumped above its fee rate
+    CFeeRate evictedRate(10000LL, ::GetSerializeSize(CTransaction(tx[0]), SER_NETWORK, PROTOCOL_VERSION));
+    BOOST_CHECK(pool.GetMinFee(1) > evictedRate);
+
+    pool.TrimToSize(0);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+    BOOST_CHECK_EQUAL(pool.GetEvictedTx(), 3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,36 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "key.h"
+#include "messagesigner.h"
+
+#include "test/test_prcycoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(messagesigner_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(messagesigner_precompute)
+{
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    const std::string strMessage = "masternode ping";
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(CMessageSigner::SignMessage(strMessage, vchSig, key));
+
+    // Recovering ahead of time does not change the outcome of the verification
+    CMessageSigner::PrecomputeMessage(vchSig, strMessage);
+    std::string strError;
+    BOOST_CHECK(CMessageSigner::VerifyMessage(key.GetPubKey(), vchSig, strMessage, strError));
+    BOOST_CHECK(!CMessageSigner::VerifyMessage(keyOther.GetPubKey(), vchSig, strMessage, strError));
+    BOOST_CHECK(!CMessageSigner::VerifyMessage(key.GetPubKey(), vchSig, strMessage + " altered", strError));
+
+    // Garbage signatures are not cached as recovered
+    std::vector<unsigned char> vchBadSig(65, 0);
+    CMessageSigner::PrecomputeMessage(vchBadSig, strMessage);
+    BOOST_CHECK(!CMessageSigner::VerifyMessage(key.GetPubKey(), vchBadSig, strMessage, strError));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,37 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "msgverifyqueue.h"
+#include "protocol.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(msgverifyqueue_tests)
+
+static CQueuedMessage MakeMessage(const std::string& strCommand, int n)
+{
+    CDataStream vRecv(SER_NETWORK, PROTOCOL_VERSION);
+    vRecv << n;
+    return CQueuedMessage(strCommand, vRecv);
+}
+
+BOOST_AUTO_TEST_CASE(msgverifyqueue_duplicates)
+{
+    CMessageVerifyQueue queue;
+
+    BOOST_CHECK(queue.Push(1, MakeMessage(NetMsgType::MNBROADCAST, 1)));
+    // The same broadcast relayed by another peer
+    BOOST_CHECK(!queue.Push(2, MakeMessage(NetMsgType::MNBROADCAST, 1)));
+    BOOST_CHECK(queue.Push(2, MakeMessage(NetMsgType::MNBROADCAST, 2)));
+    // Same payload, other command
+    BOOST_CHECK(queue.Push(2, MakeMessage(NetMsgType::MNPING, 1)));
+    BOOST_CHECK_EQUAL(queue.size(), 3);
+
+    // Queued again once the peer is gone
+    queue.RemovePeer(1);
+    BOOST_CHECK(queue.Push(2, MakeMessage(NetMsgType::MNBROADCAST, 1)));
+    BOOST_CHECK_EQUAL(queue.size(), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
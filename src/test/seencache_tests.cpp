@@ -0,0 +1,91 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "seencache.h"
+#include "streams.h"
+#include "utiltime.h"
+
+#include "test/test_prcycoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(seencache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(seencache_expiry)
+{
+    SetMockTime(1000000);
+    CSeenCache<std::string> cache(160, 1024 * 1024);
+    BOOST_CHECK(cache.insert(std::make_pair(uint256S("01"), std::string("one"))).second);
+    BOOST_CHECK(!cache.insert(std::make_pair(uint256S("01"), std::string("uno"))).second);
+    BOOST_CHECK_EQUAL(cache[uint256S("01")], "one");
+    size_t nBytes = cache.BytesUsed();
+    BOOST_CHECK(nBytes > 0);
+
+    SetMockTime(1000100);
+    cache.insert(std::make_pair(uint256S("02"), std::string("two")));
+    cache.insert(std::make_pair(uint256S("03"), std::string("three")));
+    BOOST_CHECK(cache.BytesUsed() > nBytes);
+
+    // The first entry goes, the touched one stays
+    SetMockTime(1000150);
+    cache.Touch(uint256S("02"));
+    SetMockTime(1000200);
+    cache.Expire();
+    BOOST_CHECK_EQUAL(cache.size(), 2U);
+    BOOST_CHECK(!cache.count(uint256S("01")));
+
+    SetMockTime(1000300);
+    cache.Expire();
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+    BOOST_CHECK(cache.count(uint256S("02")));
+
+    // Erased and re-added entries only expire when their new period does
+    cache.erase(uint256S("02"));
+    BOOST_CHECK_EQUAL(cache.BytesUsed(), 0U);
+    cache.insert(std::make_pair(uint256S("02"), std::string("two")));
+    SetMockTime(1000350);
+    cache.Expire();
+    BOOST_CHECK(cache.count(uint256S("02")));
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(seencache_memory_cap)
+{
+    CSeenCache<std::string> probe(0, 1024 * 1024);
+    probe.insert(std::make_pair(uint256S("01"), std::string(100, 'x')));
+    const size_t nEntryBytes = probe.BytesUsed();
+
+    // Room for three entries, the oldest ones make way
+    CSeenCache<std::string> cache(0, nEntryBytes * 3);
+    for (int i = 1; i <= 5; i++)
+        cache.insert(std::make_pair(ArithToUint256(arith_uint256(i)), std::string(100, 'x')));
+    BOOST_CHECK_EQUAL(cache.size(), 3U);
+    BOOST_CHECK(cache.BytesUsed() <= nEntryBytes * 3);
+    BOOST_CHECK(!cache.count(ArithToUint256(arith_uint256(2))));
+    BOOST_CHECK(cache.count(ArithToUint256(arith_uint256(5))));
+}
+
+BOOST_AUTO_TEST_CASE(seencache_serialization)
+{
+    // Same on disk as the std::map it replaced
+    std::map<uint256, std::string> mapOld;
+    mapOld[uint256S("01")] = "one";
+    mapOld[uint256S("02")] = "two";
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << mapOld;
+    const std::string strOld = ss.str();
+
+    CSeenCache<std::string> cache(60, 1024 * 1024);
+    ss >> cache;
+    BOOST_CHECK_EQUAL(cache.size(), 2U);
+    BOOST_CHECK(cache.BytesUsed() > 0);
+    BOOST_CHECK_EQUAL(cache[uint256S("02")], "two");
+
+    CDataStream ss2(SER_DISK, CLIENT_VERSION);
+    ss2 << cache;
+    BOOST_CHECK(ss2.str() == strOld);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,59 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "hash.h"
+#include "sendcache.h"
+
+#include "test/test_prcycoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sendcache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(sendcache_message_header)
+{
+    CDataStream ssPayload(SER_NETWORK, PROTOCOL_VERSION);
+    ssPayload << std::string("payload");
+    CSerializeDataRef msg = CreateSerializedMessage(NetMsgType::TX, ssPayload);
+    BOOST_CHECK_EQUAL(msg->size(), CMessageHeader::HEADER_SIZE + ssPayload.size());
+
+    CDataStream ssMsg(msg->begin(), msg->end(), SER_NETWORK, PROTOCOL_VERSION);
+    CMessageHeader hdr;
+    ssMsg >> hdr;
+    BOOST_CHECK(hdr.IsValid());
+    BOOST_CHECK_EQUAL(hdr.GetCommand(), NetMsgType::TX);
+    BOOST_CHECK_EQUAL(hdr.nMessageSize, ssPayload.size());
+    uint256 hash = Hash(ssPayload.begin(), ssPayload.end());
+    BOOST_CHECK_EQUAL(memcmp(&hdr.nChecksum, hash.begin(), sizeof(hdr.nChecksum)), 0);
+    BOOST_CHECK(std::equal(ssMsg.begin(), ssMsg.end(), ssPayload.begin()));
+}
+
+BOOST_AUTO_TEST_CASE(sendcache_eviction)
+{
+    CSerializeDataRef msg = std::make_shared<CSerializeData>(100);
+    CSendCache cache(250);
+
+    CInv inv1(MSG_TX, uint256S("01")), inv2(MSG_TX, uint256S("02")), inv3(MSG_BLOCK, uint256S("01"));
+    cache.Put(inv1, msg);
+    cache.Put(inv2, msg);
+    BOOST_CHECK_EQUAL(cache.size(), 200);
+
+    // Using inv1 makes inv2 the least recently used entry
+    BOOST_CHECK(cache.Get(inv1) == msg);
+    cache.Put(inv3, msg);
+    BOOST_CHECK_EQUAL(cache.size(), 200);
+    BOOST_CHECK(cache.Get(inv1));
+    BOOST_CHECK(!cache.Get(inv2));
+    BOOST_CHECK(cache.Get(inv3));
+
+    // Messages larger than the cache are not kept
+    cache.Put(inv2, std::make_shared<CSerializeData>(300));
+    BOOST_CHECK(!cache.Get(inv2));
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.size(), 0);
+    BOOST_CHECK(!cache.Get(inv1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
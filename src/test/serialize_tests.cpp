@@ -275,4 +275,31 @@ BOOST_AUTO_TEST_CASE(insert_delete)
     BOOST_CHECK_EQUAL(ss.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(span_reader)
+{
+    CDataStream ss(SER_DISK, 0);
+    ss << (uint32_t)0x01020304 << std::string("span") << (uint8_t)7;
+    std::vector<char> vch(ss.begin(), ss.end());
+
+    CSpanReader reader(vch.data(), vch.size(), SER_DISK, 0);
+    uint32_t n;
+    std::string str;
+    uint8_t c;
+    reader >> n;
+    BOOST_CHECK_EQUAL(n, 0x01020304U);
+    BOOST_CHECK_EQUAL(reader.GetPos(), 4U);
+    reader >> str;
+    BOOST_CHECK_EQUAL(str, "span");
+    reader >> c;
+    BOOST_CHECK_EQUAL(c, 7);
+    BOOST_CHECK(reader.empty());
+
+    // Reading or skipping past the end of the span throws
+    BOOST_CHECK_THROW(reader >> c, std::ios_base::failure);
+    CSpanReader skipper(vch.data(), vch.size(), SER_DISK, 0);
+    skipper.ignore(4);
+    BOOST_CHECK_EQUAL(skipper.size(), vch.size() - 4);
+    BOOST_CHECK_THROW(skipper.ignore(vch.size()), std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
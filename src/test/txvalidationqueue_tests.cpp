@@ -0,0 +1,74 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txvalidationqueue.h"
+
+#include <vector>
+
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(txvalidationqueue_tests)
+
+static CTransaction MakeTx(int n)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.n = n;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(txvalidationqueue_fairness)
+{
+    CTxValidationQueue queue;
+
+    // Peer 1 floods the queue before peer 2 sends a single transaction
+    for (int i = 0; i < 3; i++)
+        BOOST_CHECK(queue.Push(1, MakeTx(i)));
+    BOOST_CHECK(queue.Push(2, MakeTx(10)));
+    // Duplicates are not queued twice
+    BOOST_CHECK(!queue.Push(2, MakeTx(0)));
+    BOOST_CHECK_EQUAL(queue.size(), 4);
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::vector<NodeId> vServed;
+    boost::thread worker([&]() {
+        queue.Thread([&](NodeId nodeid, const CTransaction& tx) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            vServed.push_back(nodeid);
+            cond.notify_one();
+        });
+    });
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (vServed.size() < 4)
+            cond.wait(lock);
+    }
+    worker.interrupt();
+    worker.join();
+
+    // Peer 2 is served right after the first transaction of peer 1
+    BOOST_CHECK_EQUAL(vServed.size(), 4);
+    BOOST_CHECK_EQUAL(vServed[0], 1);
+    BOOST_CHECK_EQUAL(vServed[1], 2);
+    BOOST_CHECK_EQUAL(vServed[2], 1);
+    BOOST_CHECK_EQUAL(vServed[3], 1);
+}
+
+BOOST_AUTO_TEST_CASE(txvalidationqueue_limits)
+{
+    CTxValidationQueue queue;
+    for (unsigned int i = 0; i < MAX_TXVERIFY_QUEUE_PER_PEER; i++)
+        BOOST_CHECK(queue.Push(1, MakeTx(i)));
+    BOOST_CHECK(!queue.Push(1, MakeTx(MAX_TXVERIFY_QUEUE_PER_PEER)));
+    BOOST_CHECK(queue.Push(2, MakeTx(MAX_TXVERIFY_QUEUE_PER_PEER)));
+
+    // A disconnected peer's transactions are dropped
+    queue.RemovePeer(1);
+    BOOST_CHECK_EQUAL(queue.size(), 1);
+    BOOST_CHECK(queue.Push(1, MakeTx(0)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -13,6 +13,7 @@
 
 #include <stdint.h>
 
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 static const char DB_COINS = 'c';
@@ -26,6 +27,8 @@ static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 static const char DB_INT = 'I';
 static const char DB_KEYIMAGE = 'k';
+static const char DB_SUPPLY_DELTA = 's';
+static const char DB_BLOCK_TX_OFFSETS = 'o';
 
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
@@ -74,8 +77,48 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
     return db.WriteBatch(batch);
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, size_t nKeyImageCacheSize) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, DB_PROFILE_POINT_READS),
+                                                                                                      dbKeyImages(GetDataDir() / "blocks" / "keyimages", nKeyImageCacheSize, fMemory, fWipe, DB_PROFILE_POINT_READS)
 {
+    MoveKeyImages();
+}
+
+/** Move key images stored in the block index database by older versions into their own database */
+void CBlockTreeDB::MoveKeyImages()
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_KEYIMAGE, std::string()));
+
+    size_t nMoved = 0;
+    bool fDone = false;
+    while (!fDone) {
+        CDBBatch batchAdd;
+        CDBBatch batchErase;
+        size_t nBatch = 0;
+        while (nBatch < 10000) {
+            std::pair<char, std::string> key;
+            uint256 bh;
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_KEYIMAGE) {
+                fDone = true;
+                break;
+            }
+            if (pcursor->GetValue(bh)) {
+                batchAdd.Write(key, bh);
+                batchErase.Erase(key);
+                nBatch++;
+            }
+            pcursor->Next();
+        }
+        // the new copy is synced before the old entries are dropped
+        dbKeyImages.WriteBatch(batchAdd, true);
+        WriteBatch(batchErase);
+        nMoved += nBatch;
+    }
+    if (nMoved == 0)
+        return;
+    LogPrintf("%s: moved %u key images to their own database\n", __func__, nMoved);
+    // reclaim the space of the erased range right away
+    CompactRange(std::make_pair(DB_KEYIMAGE, std::string()), std::make_pair((char)(DB_KEYIMAGE + 1), std::string()));
 }
 
 bool CBlockTreeDB::WriteBlockIndex(const CDiskBlockIndex& blockindex)
@@ -182,13 +225,13 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
 
 bool CBlockTreeDB::ReadKeyImage(const std::string& keyImage, uint256& bh)
 {
-    return Read(std::make_pair(DB_KEYIMAGE, keyImage), bh);
+    return dbKeyImages.Read(std::make_pair(DB_KEYIMAGE, keyImage), bh);
 }
 
 bool CBlockTreeDB::ReadKeyImages(const std::string& keyImage, std::vector<uint256>& bhs)
 {
     uint256 bh;
-    if (!Read(std::make_pair(DB_KEYIMAGE, keyImage), bh)) return false;
+    if (!ReadKeyImage(keyImage, bh)) return false;
     bhs.push_back(bh);
     int i = 1;
     while(ReadKeyImage(keyImage + std::to_string(i), bh)) {
@@ -200,15 +243,53 @@ bool CBlockTreeDB::ReadKeyImages(const std::string& keyImage, std::vector<uint25
 
 bool CBlockTreeDB::WriteKeyImage(const std::string& keyImage, const uint256& bh)
 {
-    uint256 blockHash;
-    if (!ReadKeyImage(keyImage, blockHash)) {
-        return Write(std::make_pair(DB_KEYIMAGE, keyImage), bh);
+    return dbKeyImages.Write(std::make_pair(DB_KEYIMAGE, keyImage), bh);
+}
+
+bool CBlockTreeDB::WriteKeyImages(const std::vector<std::string>& keyImages, const uint256& bh)
+{
+    CDBBatch batch;
+    for (const std::string& keyImage : keyImages) {
+        batch.Write(std::make_pair(DB_KEYIMAGE, keyImage), bh);
     }
-    int i = 1;
-    while (ReadKeyImage(keyImage + std::to_string(i), blockHash)) {
-        i++;
+    return dbKeyImages.WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseKeyImages(const std::vector<std::string>& keyImages, const uint256& bh)
+{
+    CDBBatch batch;
+    for (const std::string& keyImage : keyImages) {
+        // only drop the entry if it still belongs to the block being disconnected
+        uint256 blockHash;
+        if (ReadKeyImage(keyImage, blockHash) && blockHash == bh)
+            batch.Erase(std::make_pair(DB_KEYIMAGE, keyImage));
     }
-    return Write(std::make_pair(DB_KEYIMAGE, keyImage + std::to_string(i)), bh);
+    return dbKeyImages.WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadBlockTxOffsets(const uint256& blockHash, CBlockTxOffsets& offsets)
+{
+    return Read(std::make_pair(DB_BLOCK_TX_OFFSETS, blockHash), offsets);
+}
+
+bool CBlockTreeDB::WriteBlockTxOffsets(const uint256& blockHash, const CBlockTxOffsets& offsets)
+{
+    return Write(std::make_pair(DB_BLOCK_TX_OFFSETS, blockHash), offsets);
+}
+
+bool CBlockTreeDB::ReadSupplyDelta(const uint256& blockHash, CBlockSupplyDelta& delta)
+{
+    return Read(std::make_pair(DB_SUPPLY_DELTA, blockHash), delta);
+}
+
+bool CBlockTreeDB::WriteSupplyDelta(const uint256& blockHash, const CBlockSupplyDelta& delta)
+{
+    return Write(std::make_pair(DB_SUPPLY_DELTA, blockHash), delta);
+}
+
+bool CBlockTreeDB::EraseSupplyDelta(const uint256& blockHash)
+{
+    return Erase(std::make_pair(DB_SUPPLY_DELTA, blockHash));
 }
 
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
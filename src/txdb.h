@@ -54,6 +54,70 @@ struct CDiskTxPos : public CDiskBlockPos {
     }
 };
 
+/** Position of every transaction inside a stored block, so one of them can be read without the rest */
+struct CBlockTxOffsets {
+    std::vector<uint256> vTxHash;
+    std::vector<unsigned int> vTxOffset; // after header, as in CDiskTxPos
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(vTxHash);
+        READWRITE(vTxOffset);
+    }
+
+    bool Find(const uint256& txid, unsigned int& nTxOffset) const
+    {
+        for (unsigned int i = 0; i < vTxHash.size() && i < vTxOffset.size(); i++) {
+            if (vTxHash[i] == txid) {
+                nTxOffset = vTxOffset[i];
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/** Per-block money supply change, stored in the block tree so supply can be rebuilt without reading blocks */
+struct CBlockSupplyDelta {
+    CAmount nValueIn;  // value of the coinstake inputs
+    CAmount nValueOut; // value of all outputs created by the block
+    CAmount nFees;     // fees destroyed by the block
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nValueIn);
+        READWRITE(nValueOut);
+        READWRITE(nFees);
+    }
+
+    CBlockSupplyDelta(CAmount nValueInIn, CAmount nValueOutIn, CAmount nFeesIn) : nValueIn(nValueInIn), nValueOut(nValueOutIn), nFees(nFeesIn)
+    {
+    }
+
+    CBlockSupplyDelta()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nValueIn = 0;
+        nValueOut = 0;
+        nFees = 0;
+    }
+
+    CAmount GetDelta() const
+    {
+        return nValueOut - nValueIn - nFees;
+    }
+};
+
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
@@ -70,16 +134,21 @@ public:
     bool GetStats(CCoinsStats& stats) const;
 };
 
-/** Access to the block database (blocks/index/) */
+/** Access to the block database (blocks/index/) and the key image table (blocks/keyimages/) */
 class CBlockTreeDB : public CDBWrapper
 {
 public:
-    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, size_t nKeyImageCacheSize = 1 << 20);
 
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
 
+    //! Key images are only ever looked up one at a time, so they live in their own database tuned for that
+    CDBWrapper dbKeyImages;
+
+    void MoveKeyImages();
+
 public:
     bool WriteBlockIndex(const CDiskBlockIndex& blockindex);
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
@@ -99,5 +168,15 @@ public:
     bool ReadKeyImages(const std::string& keyImage, std::vector<uint256>& bhs);
 
     bool WriteKeyImage(const std::string& keyImage, const uint256& height);
+    CDBCacheStats GetKeyImageCacheStats() const { return dbKeyImages.GetCacheStats(); }
+    bool WriteKeyImages(const std::vector<std::string>& keyImages, const uint256& bh);
+    bool EraseKeyImages(const std::vector<std::string>& keyImages, const uint256& bh);
+
+    bool ReadBlockTxOffsets(const uint256& blockHash, CBlockTxOffsets& offsets);
+    bool WriteBlockTxOffsets(const uint256& blockHash, const CBlockTxOffsets& offsets);
+
+    bool ReadSupplyDelta(const uint256& blockHash, CBlockSupplyDelta& delta);
+    bool WriteSupplyDelta(const uint256& blockHash, const CBlockSupplyDelta& delta);
+    bool EraseSupplyDelta(const uint256& blockHash);
 };
 #endif // BITCOIN_TXDB_H
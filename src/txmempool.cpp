@@ -8,6 +8,7 @@
 #include "txmempool.h"
 
 #include "clientversion.h"
+#include "core_memusage.h"
 #include "main.h"
 #include "streams.h"
 #include "util.h"
@@ -17,7 +18,7 @@
 #include <boost/circular_buffer.hpp>
 
 
-CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nTime(0), dPriority(0.0)
+CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0)
 {
     nHeight = MEMPOOL_HEIGHT;
 }
@@ -27,6 +28,7 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
 
     nModSize = tx.CalculateModifiedSize(nTxSize);
+    nUsageSize = RecursiveDynamicUsage(tx);
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
@@ -353,7 +355,14 @@ public:
 
 
 CTxMemPool::CTxMemPool(const CFeeRate& _minRelayFee) : nTransactionsUpdated(0),
-                                                       minRelayFee(_minRelayFee)
+                                                       minRelayFee(_minRelayFee),
+                                                       totalTxSize(0),
+                                                       cachedInnerUsage(0),
+                                                       lastRollingFeeUpdate(GetTime()),
+                                                       blockSinceLastRollingFeeBump(false),
+                                                       rollingMinimumFeeRate(0),
+                                                       nEvictedTx(0),
+                                                       nEvictedBytes(0)
 {
     // Sanity checks off by default for performance, because otherwise
     // accepting transactions becomes O(N^2) where N is the number
@@ -413,9 +422,17 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry& entry)
                 for (unsigned int i = 0; i < tx.vin.size(); i++)
                     mapNextTx[tx.vin[i].prevout] = CInPoint(&tx, i);
             }
+            if (!tx.IsCoinBase()) {
+                for (const CTxIn& txin : tx.vin) {
+                    if (txin.keyImage.IsValid())
+                        mapKeyImages[txin.keyImage] = hash;
+                }
+            }
         }
         nTransactionsUpdated++;
         totalTxSize += entry.GetTxSize();
+        cachedInnerUsage += entry.DynamicMemoryUsage();
+        setEntriesByFeeRate.insert(std::make_pair(entry.GetFeeRate(), hash));
     }
     return true;
 }
@@ -454,11 +471,18 @@ void CTxMemPool::remove(const CTransaction& origTx, std::list<CTransaction>& rem
                     txToRemove.push_back(it->second.ptx->GetHash());
                 }
             }
-            for (const CTxIn& txin : tx.vin)
+            for (const CTxIn& txin : tx.vin) {
                 mapNextTx.erase(txin.prevout);
+                std::map<CKeyImage, uint256>::iterator itKeyImage = mapKeyImages.find(txin.keyImage);
+                if (itKeyImage != mapKeyImages.end() && itKeyImage->second == hash)
+                    mapKeyImages.erase(itKeyImage);
+            }
 
             removed.push_back(tx);
-            totalTxSize -= mapTx[hash].GetTxSize();
+            const CTxMemPoolEntry& entry = mapTx[hash];
+            totalTxSize -= entry.GetTxSize();
+            cachedInnerUsage -= entry.DynamicMemoryUsage();
+            setEntriesByFeeRate.erase(std::make_pair(entry.GetFeeRate(), hash));
             mapTx.erase(hash);
             nTransactionsUpdated++;
         }
@@ -504,6 +528,20 @@ void CTxMemPool::removeConflicts(const CTransaction& tx, std::list<CTransaction>
             }
         }
     }
+    // Ring transactions conflict through their key images rather than their prevouts
+    if (tx.IsCoinBase())
+        return;
+    const uint256 hash = tx.GetHash();
+    for (const CTxIn& txin : tx.vin) {
+        std::map<CKeyImage, uint256>::iterator it = mapKeyImages.find(txin.keyImage);
+        if (it == mapKeyImages.end() || it->second == hash)
+            continue;
+        std::map<uint256, CTxMemPoolEntry>::iterator itConflict = mapTx.find(it->second);
+        if (itConflict != mapTx.end()) {
+            const CTransaction txConflict = itConflict->second.GetTx();
+            remove(txConflict, removed, true);
+        }
+    }
 }
 
 /**
@@ -525,6 +563,8 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
         removeConflicts(tx, conflicts);
         ClearPrioritisation(tx.GetHash());
     }
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = true;
 }
 
 
@@ -533,7 +573,13 @@ void CTxMemPool::clear()
     LOCK(cs);
     mapTx.clear();
     mapNextTx.clear();
+    mapKeyImages.clear();
+    setEntriesByFeeRate.clear();
     totalTxSize = 0;
+    cachedInnerUsage = 0;
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = false;
+    rollingMinimumFeeRate = 0;
     ++nTransactionsUpdated;
 }
 
@@ -545,6 +591,7 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     LogPrint(BCLog::MEMPOOL, "Checking mempool with %u transactions and %u inputs\n", (unsigned int)mapTx.size(), (unsigned int)mapNextTx.size());
 
     uint64_t checkTotal = 0;
+    uint64_t innerUsage = 0;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
 
@@ -553,6 +600,8 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
         checkTotal += it->second.GetTxSize();
+        innerUsage += it->second.DynamicMemoryUsage();
+        assert(setEntriesByFeeRate.count(std::make_pair(it->second.GetFeeRate(), it->first)));
         const CTransaction& tx = it->second.GetTx();
         bool fDependsWait = false;
         for (const CTxIn& txin : tx.vin) {
@@ -607,8 +656,18 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
         assert(tx.vin.size() > it->second.n);
         assert(it->first == it->second.ptx->vin[it->second.n].prevout);
     }
+    for (std::map<CKeyImage, uint256>::const_iterator it = mapKeyImages.begin(); it != mapKeyImages.end(); it++) {
+        std::map<uint256, CTxMemPoolEntry>::const_iterator it2 = mapTx.find(it->second);
+        assert(it2 != mapTx.end());
+        bool fFound = false;
+        for (const CTxIn& txin : it2->second.GetTx().vin)
+            fFound |= (txin.keyImage == it->first);
+        assert(fFound);
+    }
 
     assert(totalTxSize == checkTotal);
+    assert(innerUsage == cachedInnerUsage);
+    assert(setEntriesByFeeRate.size() == mapTx.size());
 }
 
 void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
@@ -630,6 +689,92 @@ bool CTxMemPool::lookup(uint256 hash, CTransaction& result) const
     return true;
 }
 
+size_t CTxMemPool::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return memusage::DynamicUsage(mapTx) + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapKeyImages) +
+           memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(setEntriesByFeeRate) + cachedInnerUsage;
+}
+
+CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const
+{
+    LOCK(cs);
+    if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
+        return CFeeRate(rollingMinimumFeeRate);
+
+    int64_t time = GetTime();
+    if (time > lastRollingFeeUpdate + 10) {
+        double halflife = ROLLING_FEE_HALFLIFE;
+        if (DynamicMemoryUsage() < sizelimit / 4)
+            halflife /= 4;
+        else if (DynamicMemoryUsage() < sizelimit / 2)
+            halflife /= 2;
+
+        rollingMinimumFeeRate = rollingMinimumFeeRate / pow(2.0, (time - lastRollingFeeUpdate) / halflife);
+        lastRollingFeeUpdate = time;
+
+        if (rollingMinimumFeeRate < (double)minRelayFee.GetFeePerK() / 2) {
+            rollingMinimumFeeRate = 0;
+            return CFeeRate(0);
+        }
+    }
+    return std::max(CFeeRate(rollingMinimumFeeRate), minRelayFee);
+}
+
+void CTxMemPool::trackPackageRemoved(const CFeeRate& rate)
+{
+    AssertLockHeld(cs);
+    if (rate.GetFeePerK() > rollingMinimumFeeRate) {
+        rollingMinimumFeeRate = rate.GetFeePerK();
+        blockSinceLastRollingFeeBump = false;
+    }
+}
+
+void CTxMemPool::TrimToSize(size_t sizelimit)
+{
+    LOCK(cs);
+
+    unsigned int nTxnRemoved = 0;
+    CFeeRate maxFeeRateRemoved(0);
+    while (!setEntriesByFeeRate.empty() && DynamicMemoryUsage() > sizelimit) {
+        const std::pair<CFeeRate, uint256> lowest = *setEntriesByFeeRate.begin();
+        // Require the next transaction to pay at least the evicted rate plus the relay fee
+        CFeeRate removed(lowest.first.GetFeePerK() + minRelayFee.GetFeePerK());
+        trackPackageRemoved(removed);
+        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
+        std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.find(lowest.second);
+        assert(it != mapTx.end());
+        const CTransaction tx = it->second.GetTx();
+        std::list<CTransaction> removedTxs;
+        remove(tx, removedTxs, true);
+        for (const CTransaction& txRemoved : removedTxs) {
+            nEvictedBytes += ::GetSerializeSize(txRemoved, SER_NETWORK, PROTOCOL_VERSION);
+            ClearPrioritisation(txRemoved.GetHash());
+        }
+        nEvictedTx += removedTxs.size();
+        nTxnRemoved += removedTxs.size();
+    }
+
+    if (maxFeeRateRemoved > CFeeRate(0))
+        LogPrint(BCLog::MEMPOOL, "Removed %u txn, rolling minimum fee bumped to %s\n", nTxnRemoved, maxFeeRateRemoved.ToString());
+}
+
+bool CTxMemPool::HasKeyImageConflict(const CTransaction& tx, uint256* pConflictHash) const
+{
+    LOCK(cs);
+    const uint256 hash = tx.GetHash();
+    for (const CTxIn& txin : tx.vin) {
+        std::map<CKeyImage, uint256>::const_iterator it = mapKeyImages.find(txin.keyImage);
+        if (it != mapKeyImages.end() && it->second != hash) {
+            if (pConflictHash)
+                *pConflictHash = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
 CFeeRate CTxMemPool::estimateFee(int nBlocks) const
 {
     LOCK(cs);
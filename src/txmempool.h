@@ -9,10 +9,12 @@
 #define BITCOIN_TXMEMPOOL_H
 
 #include <list>
+#include <set>
 
 #include "amount.h"
 #include "coins.h"
 #include "primitives/transaction.h"
+#include "pubkey.h"
 #include "sync.h"
 #include "random.h"
 
@@ -33,6 +35,8 @@ inline bool AllowFree(double dPriority)
 
 /** Fake height value used in CCoins to signify they are only in the memory pool (since 0.8) */
 static const unsigned int MEMPOOL_HEIGHT = 0x7FFFFFFF;
+/** Default for -maxmempool, maximum megabytes of mempool memory usage */
+static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
 
 /**
  * CTxMemPool stores these:
@@ -44,6 +48,7 @@ private:
     CAmount nFee;         //! Cached to avoid expensive parent-transaction lookups
     size_t nTxSize;       //! ... and avoid recomputing tx size
     size_t nModSize;      //! ... and modified size for priority
+    size_t nUsageSize;    //! ... and total memory usage
     int64_t nTime;        //! Local time when entering the mempool
     double dPriority;     //! Priority when entering the mempool
     unsigned int nHeight; //! Chain height when entering the mempool
@@ -57,6 +62,8 @@ public:
     double GetPriority(unsigned int currentHeight) const;
     CAmount GetFee() const { return nFee; }
     size_t GetTxSize() const { return nTxSize; }
+    size_t DynamicMemoryUsage() const { return nUsageSize; }
+    CFeeRate GetFeeRate() const { return CFeeRate(nFee, nTxSize); }
     int64_t GetTime() const { return nTime; }
     unsigned int GetHeight() const { return nHeight; }
 };
@@ -96,6 +103,9 @@ public:
  */
 class CTxMemPool
 {
+public:
+    static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // public only for testing
+
 private:
     bool fSanityCheck; //! Normally false, true if -checkmempool or -regtest
     unsigned int nTransactionsUpdated;
@@ -103,6 +113,19 @@ private:
 
     CFeeRate minRelayFee; //! Passed to constructor to avoid dependency on main
     uint64_t totalTxSize; //! sum of all mempool tx' byte sizes
+    uint64_t cachedInnerUsage; //! sum of dynamic memory usage of all the map elements (NOT the maps themselves)
+
+    //! Pool entries ordered by fee rate, lowest first, for eviction
+    std::set<std::pair<CFeeRate, uint256> > setEntriesByFeeRate;
+
+    mutable int64_t lastRollingFeeUpdate;
+    mutable bool blockSinceLastRollingFeeBump;
+    mutable double rollingMinimumFeeRate; //! minimum fee to get into the pool, decreases exponentially
+
+    uint64_t nEvictedTx;    //! transactions evicted by TrimToSize
+    uint64_t nEvictedBytes; //! ... and their total size
+
+    void trackPackageRemoved(const CFeeRate& rate);
 
 public:
     /**
@@ -135,6 +158,8 @@ public:
     mutable RecursiveMutex cs;
     std::map<uint256, CTxMemPoolEntry> mapTx;
     std::map<COutPoint, CInPoint> mapNextTx;
+    //! Key images spent by pool transactions, mapped to the txid spending them
+    std::map<CKeyImage, uint256> mapKeyImages;
     std::map<uint256, std::pair<double, CAmount> > mapDeltas;
 
     CTxMemPool(const CFeeRate& _minRelayFee);
@@ -184,6 +209,33 @@ public:
 
     bool lookup(uint256 hash, CTransaction& result) const;
 
+    /**
+     * The minimum fee to get into the mempool, which may itself not be enough
+     * for larger-sized transactions. The rolling fee is raised whenever
+     * TrimToSize evicts transactions and decays back towards zero over
+     * ROLLING_FEE_HALFLIFE once blocks confirm again.
+     */
+    CFeeRate GetMinFee(size_t sizelimit) const;
+
+    /** Remove transactions from the mempool, lowest fee rate first, until its dynamic size is <= sizelimit */
+    void TrimToSize(size_t sizelimit);
+
+    size_t DynamicMemoryUsage() const;
+
+    uint64_t GetEvictedTx() const
+    {
+        LOCK(cs);
+        return nEvictedTx;
+    }
+    uint64_t GetEvictedBytes() const
+    {
+        LOCK(cs);
+        return nEvictedBytes;
+    }
+
+    /** Return true if a pool transaction other than tx spends one of tx's key images */
+    bool HasKeyImageConflict(const CTransaction& tx, uint256* pConflictHash = NULL) const;
+
     /** Estimate fee rate needed to get into the next nBlocks */
     CFeeRate estimateFee(int nBlocks) const;
 
@@ -0,0 +1,45 @@
+// Copyright (c) 2020-2022 The PRivaCY Coin Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PRCY_TXVALIDATIONQUEUE_H
+#define PRCY_TXVALIDATIONQUEUE_H
+
+#include "peerqueue.h"
+#include "primitives/transaction.h"
+
+#include <set>
+
+/** -txverifythreads default (number of relayed transaction verification threads, 0 = verify inline) */
+static const int DEFAULT_TXVERIFY_THREADS = 2;
+/** Maximum number of transaction verification threads allowed */
+static const int MAX_TXVERIFY_THREADS = 16;
+/** Maximum number of relayed transactions waiting for verification per peer */
+static const unsigned int MAX_TXVERIFY_QUEUE_PER_PEER = 100;
+
+/**
+ * Queue of relayed transactions waiting for their proofs to be verified.
+ *
+ * Peers are served round robin, so a peer relaying many large ring
+ * transactions only delays its own transactions. Workers run without
+ * cs_main; the validation function only takes it to insert the verified
+ * transaction into the mempool. The same transaction is never queued twice.
+ */
+class CTxValidationQueue : public CPeerQueue<CTransaction>
+{
+public:
+    CTxValidationQueue() : CPeerQueue<CTransaction>(MAX_TXVERIFY_QUEUE_PER_PEER) {}
+
+protected:
+    bool IsQueued(const CTransaction& tx) const override { return setQueued.count(tx.GetHash()); }
+    void Queued(const CTransaction& tx) override { setQueued.insert(tx.GetHash()); }
+    void Dequeued(const CTransaction& tx) override { setQueued.erase(tx.GetHash()); }
+
+private:
+    //! Transactions queued or being verified
+    std::set<uint256> setQueued;
+};
+
+extern CTxValidationQueue txValidationQueue;
+
+#endif // PRCY_TXVALIDATIONQUEUE_H
@@ -1175,7 +1175,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
     uint256 hash = wtxIn.GetHash();
     const uint256& hashBlock = wtxIn.hashBlock;
     CBlockIndex* p = mapBlockIndex[hashBlock];
-    if (p) {
+    if (p && chainActive.Contains(p)) {
         for (CTxIn in : wtxIn.vin) {
             pblocktree->WriteKeyImage(in.keyImage.GetHex(), hashBlock);
         }